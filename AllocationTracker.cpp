@@ -0,0 +1,155 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <opencv2/core.hpp>
+
+namespace
+{
+std::atomic<bool> countingEnabled{false};
+std::atomic<uint64_t> processAllocations{0};
+std::atomic<uint64_t> processBytes{0};
+
+// Plain integers so the first access needs no TLS constructor inside operator new
+thread_local uint64_t threadAllocations = 0;
+thread_local uint64_t threadBytes = 0;
+
+inline void countAllocation(size_t size)
+{
+    if (!countingEnabled.load(std::memory_order_relaxed))
+        return;
+    threadAllocations++;
+    threadBytes += size;
+    processAllocations.fetch_add(1, std::memory_order_relaxed);
+    processBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+// Counts Mat buffers and hands the real work to OpenCV's standard allocator,
+// which stays the owner of every buffer and frees it directly
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    explicit CountingMatAllocator(cv::MatAllocator *inner)
+        : inner(inner)
+    {
+    }
+
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        cv::UMatData *result = inner->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (result && !data)
+            countAllocation(result->size);
+        return result;
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return inner->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *data) const override
+    {
+        inner->deallocate(data);
+    }
+
+private:
+    cv::MatAllocator *inner;
+};
+}
+
+void *operator new(std::size_t size)
+{
+    countAllocation(size);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Over-aligned types (alignas beyond the default, e.g. SIMD members) come here instead
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    countAllocation(size);
+    // aligned_alloc takes whole multiples of the alignment
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = ((size ? size : 1) + align - 1) / align * align;
+    if (void *p = std::aligned_alloc(align, rounded))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void AllocationTracker::install()
+{
+    static CountingMatAllocator allocator(cv::Mat::getStdAllocator());
+    cv::Mat::setDefaultAllocator(&allocator);
+}
+
+void AllocationTracker::setEnabled(bool enable)
+{
+    countingEnabled.store(enable, std::memory_order_relaxed);
+}
+
+bool AllocationTracker::enabled()
+{
+    return countingEnabled.load(std::memory_order_relaxed);
+}
+
+AllocationTracker::Counts AllocationTracker::threadCounts()
+{
+    return {threadAllocations, threadBytes};
+}
+
+AllocationTracker::Counts AllocationTracker::processCounts()
+{
+    return {processAllocations.load(std::memory_order_relaxed), processBytes.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation accounting for the frame loop.
+// The global operator new and OpenCV's default Mat allocator both feed a
+// process-wide counter and a per-thread counter, so a scope on one thread can
+// attribute the allocations it causes. cv::Mat buffers come from fastMalloc
+// rather than operator new, which is why the Mat allocator is wrapped too.
+// While counting is off every allocation pays one relaxed atomic load.
+class AllocationTracker
+{
+public:
+    struct Counts
+    {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+
+        Counts operator-(const Counts &other) const
+        {
+            return {allocations - other.allocations, bytes - other.bytes};
+        }
+    };
+
+    // Route cv::Mat buffers through the counters; call once before frames flow
+    static void install();
+
+    static void setEnabled(bool enable);
+    static bool enabled();
+
+    // Running totals for the calling thread; OpenCV worker threads are not included
+    static Counts threadCounts();
+
+    // Running totals for the whole process
+    static Counts processCounts();
+};
@@ -0,0 +1,271 @@
+#include "CaptureMode.h"
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+int xioctl(int fd, unsigned long request, void *arg)
+{
+    int result;
+    do
+    {
+        result = ioctl(fd, request, arg);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+bool isNative(uint32_t pixelFormat)
+{
+    return pixelFormat == V4L2_PIX_FMT_GREY || pixelFormat == V4L2_PIX_FMT_Y10 ||
+           pixelFormat == V4L2_PIX_FMT_Y12 || pixelFormat == V4L2_PIX_FMT_Y16;
+}
+
+// Formats convertRawFrame() understands
+bool isConvertible(uint32_t pixelFormat)
+{
+    return pixelFormat == V4L2_PIX_FMT_YUYV || pixelFormat == V4L2_PIX_FMT_MJPEG || isNative(pixelFormat);
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> frameSizes(int fd, uint32_t pixelFormat)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> sizes;
+    v4l2_frmsizeenum size = {};
+    size.pixel_format = pixelFormat;
+    for (size.index = 0; xioctl(fd, VIDIOC_ENUM_FRAMESIZES, &size) == 0; size.index++)
+    {
+        if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE)
+        {
+            sizes.emplace_back(size.discrete.width, size.discrete.height);
+            continue;
+        }
+        // Stepwise and continuous ranges are offered by their extremes; UVC cameras are always discrete
+        sizes.emplace_back(size.stepwise.max_width, size.stepwise.max_height);
+        sizes.emplace_back(size.stepwise.min_width, size.stepwise.min_height);
+        break;
+    }
+    return sizes;
+}
+
+std::vector<v4l2_fract> frameIntervals(int fd, uint32_t pixelFormat, uint32_t width, uint32_t height)
+{
+    std::vector<v4l2_fract> intervals;
+    v4l2_frmivalenum interval = {};
+    interval.pixel_format = pixelFormat;
+    interval.width = width;
+    interval.height = height;
+    for (interval.index = 0; xioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &interval) == 0; interval.index++)
+    {
+        if (interval.type == V4L2_FRMIVAL_TYPE_DISCRETE)
+        {
+            intervals.push_back(interval.discrete);
+            continue;
+        }
+        intervals.push_back(interval.stepwise.min);
+        intervals.push_back(interval.stepwise.max);
+        break;
+    }
+    return intervals;
+}
+
+// Negative when a streams faster than b; modes without a known interval sort last
+int compareInterval(const CaptureMode &a, const CaptureMode &b)
+{
+    bool aKnown = a.intervalNumerator > 0 && a.intervalDenominator > 0;
+    bool bKnown = b.intervalNumerator > 0 && b.intervalDenominator > 0;
+    if (aKnown != bKnown)
+        return aKnown ? -1 : 1;
+    if (!aKnown)
+        return 0;
+    uint64_t aPeriod = static_cast<uint64_t>(a.intervalNumerator) * b.intervalDenominator;
+    uint64_t bPeriod = static_cast<uint64_t>(b.intervalNumerator) * a.intervalDenominator;
+    return aPeriod < bPeriod ? -1 : (aPeriod > bPeriod ? 1 : 0);
+}
+
+// How far a mode's size is from the preferred one; 0 is an exact match
+int64_t sizeDistance(const CaptureMode &mode, const CaptureConfig &config)
+{
+    int64_t area = static_cast<int64_t>(mode.width) * mode.height;
+    if (config.width <= 0 || config.height <= 0)
+        return -area; // No preference: the largest
+    if (mode.width == config.width && mode.height == config.height)
+        return 0;
+    return 1 + std::llabs(area - static_cast<int64_t>(config.width) * config.height);
+}
+
+// Among equally fast modes of one size, fewer bytes per pixel reach us sooner;
+// NIR keeps as much of the sensor's depth as it offers
+int formatRank(uint32_t pixelFormat, CapturePolicy policy)
+{
+    bool nir = policy == CapturePolicy::NativeNir;
+    switch (pixelFormat)
+    {
+    case V4L2_PIX_FMT_GREY:
+        return nir ? 3 : 0;
+    case V4L2_PIX_FMT_Y16:
+        return nir ? 0 : 1;
+    case V4L2_PIX_FMT_Y12:
+        return 1;
+    case V4L2_PIX_FMT_Y10:
+        return nir ? 2 : 1;
+    case V4L2_PIX_FMT_YUYV:
+        return 4;
+    default:
+        return 5;
+    }
+}
+
+bool isBetter(const CaptureMode &a, const CaptureMode &b, const CaptureConfig &config)
+{
+    // A frame interval outweighs decoding, so a slower uncompressed mode never wins.
+    // At the same rate a compressed frame is only usable once the whole JPEG has
+    // arrived and been decoded, which only the frame rate policy does not mind
+    int interval = compareInterval(a, b);
+    if (interval != 0)
+        return interval < 0;
+    if (config.policy != CapturePolicy::MaxFps && a.isCompressed() != b.isCompressed())
+        return !a.isCompressed();
+
+    int64_t aDistance = sizeDistance(a, config);
+    int64_t bDistance = sizeDistance(b, config);
+    if (aDistance != bDistance)
+        return aDistance < bDistance;
+    return formatRank(a.pixelFormat, config.policy) < formatRank(b.pixelFormat, config.policy);
+}
+}
+
+double CaptureMode::fps() const
+{
+    if (intervalNumerator == 0 || intervalDenominator == 0)
+        return 0.0;
+    return static_cast<double>(intervalDenominator) / intervalNumerator;
+}
+
+bool CaptureMode::isCompressed() const
+{
+    return pixelFormat == V4L2_PIX_FMT_MJPEG;
+}
+
+QString CaptureMode::describe() const
+{
+    QString text = QString("%1x%2 %3").arg(width).arg(height).arg(fourccName(pixelFormat));
+    if (fps() > 0.0)
+        text += QString(" @ %1 fps").arg(fps(), 0, 'f', 1);
+    return text;
+}
+
+QString fourccName(uint32_t pixelFormat)
+{
+    char fourcc[5] = {static_cast<char>(pixelFormat & 0xff), static_cast<char>((pixelFormat >> 8) & 0xff),
+                      static_cast<char>((pixelFormat >> 16) & 0xff), static_cast<char>((pixelFormat >> 24) & 0xff), 0};
+    return QString::fromLatin1(fourcc).trimmed();
+}
+
+const char *capturePolicyName(CapturePolicy policy)
+{
+    switch (policy)
+    {
+    case CapturePolicy::Current:
+        return "current";
+    case CapturePolicy::LowestLatency:
+        return "latency";
+    case CapturePolicy::MaxFps:
+        return "fps";
+    case CapturePolicy::NativeNir:
+        return "nir";
+    }
+    return "unknown";
+}
+
+bool parseCapturePolicy(const QString &name, CapturePolicy &policy)
+{
+    for (CapturePolicy candidate : {CapturePolicy::Current, CapturePolicy::LowestLatency,
+                                    CapturePolicy::MaxFps, CapturePolicy::NativeNir})
+    {
+        if (name == capturePolicyName(candidate))
+        {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<CaptureMode> enumerateCaptureModes(int fd)
+{
+    std::vector<CaptureMode> modes;
+    v4l2_fmtdesc format = {};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    for (format.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &format) == 0; format.index++)
+    {
+        if (!isConvertible(format.pixelformat))
+            continue;
+
+        for (const auto &[width, height] : frameSizes(fd, format.pixelformat))
+        {
+            CaptureMode mode;
+            mode.pixelFormat = format.pixelformat;
+            mode.width = static_cast<int>(width);
+            mode.height = static_cast<int>(height);
+
+            // Drivers that cannot enumerate intervals still stream at some rate
+            std::vector<v4l2_fract> intervals = frameIntervals(fd, format.pixelformat, width, height);
+            if (intervals.empty())
+                modes.push_back(mode);
+            for (const v4l2_fract &interval : intervals)
+            {
+                mode.intervalNumerator = interval.numerator;
+                mode.intervalDenominator = interval.denominator;
+                modes.push_back(mode);
+            }
+        }
+    }
+    return modes;
+}
+
+bool selectCaptureMode(const std::vector<CaptureMode> &modes, const CaptureConfig &config, CaptureMode &chosen)
+{
+    if (config.policy == CapturePolicy::Current || modes.empty())
+        return false;
+
+    // NIR takes any native mode over a colour one, whatever its rate
+    std::vector<CaptureMode> candidates;
+    if (config.policy == CapturePolicy::NativeNir)
+    {
+        std::copy_if(modes.begin(), modes.end(), std::back_inserter(candidates),
+                     [](const CaptureMode &mode)
+                     { return isNative(mode.pixelFormat); });
+    }
+    if (candidates.empty())
+        candidates = modes;
+
+    // The preferred size is a requirement when the camera offers it, a hint otherwise
+    std::vector<CaptureMode> sized;
+    std::copy_if(candidates.begin(), candidates.end(), std::back_inserter(sized),
+                 [&config](const CaptureMode &mode)
+                 { return mode.width == config.width && mode.height == config.height; });
+    if (!sized.empty())
+        candidates.swap(sized);
+
+    chosen = *std::min_element(candidates.begin(), candidates.end(),
+                               [&config](const CaptureMode &a, const CaptureMode &b)
+                               { return isBetter(a, b, config); });
+    return true;
+}
+
+int minimumBufferCount(const CaptureMode &mode)
+{
+    // read() drains the queue and the load controller keeps processing within a
+    // frame interval, so the driver needs one buffer to fill and one completed
+    // frame waiting for us
+    int count = 2;
+    // A JPEG is decoded while its buffer is held, and above 60 fps scheduling
+    // jitter is a large share of the interval; one more buffer covers either
+    if (mode.isCompressed() || mode.fps() > 60.0)
+        count++;
+    return count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+// How a V4L2 camera's streaming mode is chosen from the modes it offers
+enum class CapturePolicy
+{
+    Current,       // Keep whatever mode the driver is set to
+    LowestLatency, // Shortest frame interval, uncompressed formats among equally fast modes
+    MaxFps,        // Shortest frame interval in any format we can convert
+    NativeNir,     // Gray formats straight off the sensor, the deepest among equally fast modes
+};
+
+struct CaptureConfig
+{
+    CapturePolicy policy = CapturePolicy::Current;
+    int width = 0; // Preferred frame size, 0 to keep the camera's current size
+    int height = 0;
+    int bufferCount = 0; // 0 for the fewest buffers that sustain the frame rate
+};
+
+// One pixel format, frame size and frame interval a camera can stream
+struct CaptureMode
+{
+    uint32_t pixelFormat = 0; // V4L2_PIX_FMT_*
+    int width = 0;
+    int height = 0;
+    uint32_t intervalNumerator = 0; // Frame interval in seconds; 0/0 when the driver does not say
+    uint32_t intervalDenominator = 0;
+
+    double fps() const;
+    bool isCompressed() const;
+    // e.g. "1280x720 YUYV @ 30.0 fps"
+    QString describe() const;
+};
+
+// Four character code of a V4L2 pixel format, e.g. "YUYV"
+QString fourccName(uint32_t pixelFormat);
+
+const char *capturePolicyName(CapturePolicy policy);
+// Accepts current, latency, fps or nir
+bool parseCapturePolicy(const QString &name, CapturePolicy &policy);
+
+// Every format, size and interval the device offers in a format convertRawFrame() handles
+std::vector<CaptureMode> enumerateCaptureModes(int fd);
+
+// Best of modes under config; false when there is nothing to choose from
+bool selectCaptureMode(const std::vector<CaptureMode> &modes, const CaptureConfig &config, CaptureMode &chosen);
+
+// Fewest mmap buffers that keep the driver from running dry at mode's frame rate
+int minimumBufferCount(const CaptureMode &mode);
@@ -0,0 +1,204 @@
+#include "ComponentLabeller.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+using namespace cv;
+
+// Rows per strip below which splitting the mask further costs more seams than it saves
+constexpr int MIN_STRIP_ROWS = 32;
+
+inline int findRoot(int *parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// The earlier run stays the root, so roots are met before the rest of their component
+inline void unite(int *parent, int a, int b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b)
+        parent[b] = a;
+    else if (b < a)
+        parent[a] = b;
+}
+
+// Sum of x and of x * x over [0, n)
+inline double sumTo(double n)
+{
+    return n * (n - 1.0) * 0.5;
+}
+
+inline double sumSqTo(double n)
+{
+    return n * (n - 1.0) * (2.0 * n - 1.0) / 6.0;
+}
+}
+
+void ComponentLabeller::labelStrip(const cv::Mat &mask, Strip &strip)
+{
+    strip.runs.clear();
+    strip.parents.clear();
+    strip.rowStart.clear();
+    const int width = mask.cols;
+#if CV_SIMD
+    const v_uint8 zero = vx_setzero_u8();
+#endif
+    for (int y = strip.y0; y < strip.y1; y++)
+    {
+        const uchar *row = mask.ptr<uchar>(y);
+        const int first = static_cast<int>(strip.runs.size());
+        strip.rowStart.push_back(first);
+
+        // Skip background and cross foreground a vector at a time where possible
+        int x = 0;
+        while (x < width)
+        {
+#if CV_SIMD
+            while (x <= width - v_uint8::nlanes && v_check_all(vx_load(row + x) == zero))
+                x += v_uint8::nlanes;
+#endif
+            while (x < width && row[x] == 0)
+                x++;
+            if (x == width)
+                break;
+            const int start = x;
+#if CV_SIMD
+            while (x <= width - v_uint8::nlanes && v_check_all(vx_load(row + x) != zero))
+                x += v_uint8::nlanes;
+#endif
+            while (x < width && row[x] != 0)
+                x++;
+            strip.parents.push_back(static_cast<int>(strip.runs.size()));
+            strip.runs.push_back({y, start, x});
+        }
+
+        // Join with the runs of the row above that touch, diagonals included
+        if (y > strip.y0)
+        {
+            const int above = strip.rowStart[y - strip.y0 - 1];
+            const int end = static_cast<int>(strip.runs.size());
+            int a = above;
+            for (int b = first; b < end; b++)
+            {
+                while (a < first && strip.runs[a].end < strip.runs[b].start)
+                    a++;
+                for (int i = a; i < first && strip.runs[i].start <= strip.runs[b].end; i++)
+                    unite(strip.parents.data(), i, b);
+            }
+        }
+    }
+    strip.rowStart.push_back(static_cast<int>(strip.runs.size()));
+#if CV_SIMD
+    vx_cleanup();
+#endif
+}
+
+const std::vector<Component> &ComponentLabeller::label(const cv::Mat &mask, int minArea)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+    components.clear();
+    if (mask.empty())
+        return components;
+
+    const int stripCount = std::clamp(mask.rows / MIN_STRIP_ROWS, 1, std::max(1, cv::getNumThreads() * 4));
+    strips.resize(stripCount);
+    cv::parallel_for_(cv::Range(0, stripCount), [&](const cv::Range &range)
+                      {
+        for (int i = range.start; i < range.end; i++)
+        {
+            strips[i].y0 = mask.rows * i / stripCount;
+            strips[i].y1 = mask.rows * (i + 1) / stripCount;
+            labelStrip(mask, strips[i]);
+        } });
+
+    // Gather the strips' union-find into one, then join each strip's first row to
+    // the last row of the strip above
+    parents.clear();
+    std::vector<int> offsets(stripCount);
+    for (int i = 0; i < stripCount; i++)
+    {
+        offsets[i] = static_cast<int>(parents.size());
+        for (int parent : strips[i].parents)
+            parents.push_back(offsets[i] + parent);
+    }
+    for (int i = 1; i < stripCount; i++)
+    {
+        const Strip &upper = strips[i - 1];
+        const Strip &lower = strips[i];
+        const int aboveEnd = upper.rowStart.back();
+        const int belowEnd = lower.rowStart[1];
+        int a = upper.rowStart[upper.rowStart.size() - 2];
+        for (int b = 0; b < belowEnd; b++)
+        {
+            while (a < aboveEnd && upper.runs[a].end < lower.runs[b].start)
+                a++;
+            for (int j = a; j < aboveEnd && upper.runs[j].start <= lower.runs[b].end; j++)
+                unite(parents.data(), offsets[i - 1] + j, offsets[i] + b);
+        }
+    }
+
+    // Accumulate each run into its component's moments
+    componentIds.assign(parents.size(), -1);
+    moments.clear();
+    for (int i = 0; i < stripCount; i++)
+    {
+        for (size_t r = 0; r < strips[i].runs.size(); r++)
+        {
+            const Run &run = strips[i].runs[r];
+            int root = findRoot(parents.data(), offsets[i] + static_cast<int>(r));
+            if (componentIds[root] < 0)
+            {
+                componentIds[root] = static_cast<int>(moments.size());
+                Moments m;
+                m.minX = run.start;
+                m.maxX = run.end;
+                m.minY = run.y;
+                m.maxY = run.y + 1;
+                moments.push_back(m);
+            }
+            Moments &m = moments[componentIds[root]];
+            double length = run.end - run.start;
+            double sumX = sumTo(run.end) - sumTo(run.start);
+            m.area += length;
+            m.sumX += sumX;
+            m.sumY += length * run.y;
+            m.sumXX += sumSqTo(run.end) - sumSqTo(run.start);
+            m.sumYY += length * run.y * run.y;
+            m.sumXY += sumX * run.y;
+            m.minX = std::min(m.minX, run.start);
+            m.maxX = std::max(m.maxX, run.end);
+            m.maxY = run.y + 1; // Runs arrive in row order
+        }
+    }
+
+    for (const Moments &m : moments)
+    {
+        if (m.area < minArea)
+            continue;
+        Component component;
+        component.area = static_cast<int>(m.area);
+        component.bounds = cv::Rect(m.minX, m.minY, m.maxX - m.minX, m.maxY - m.minY);
+        component.centroid = cv::Point2d(m.sumX / m.area, m.sumY / m.area);
+
+        // Axes of the covariance ellipse; a pixel's own 1/12 variance keeps one-pixel
+        // lines finite
+        double xx = m.sumXX / m.area - component.centroid.x * component.centroid.x + 1.0 / 12.0;
+        double yy = m.sumYY / m.area - component.centroid.y * component.centroid.y + 1.0 / 12.0;
+        double xy = m.sumXY / m.area - component.centroid.x * component.centroid.y;
+        double spread = std::sqrt(0.25 * (xx - yy) * (xx - yy) + xy * xy);
+        double major = 0.5 * (xx + yy) + spread;
+        double minor = std::max(0.5 * (xx + yy) - spread, 1.0 / 12.0);
+        component.elongation = std::sqrt(major / minor);
+        components.push_back(component);
+    }
+    return components;
+}
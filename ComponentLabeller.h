@@ -0,0 +1,66 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// One 8-connected foreground blob of a binary mask
+struct Component
+{
+    int area = 0; // Pixels
+    cv::Rect bounds;
+    cv::Point2d centroid;
+    double elongation = 1.0; // Major over minor axis of the blob's second moments
+};
+
+// Connected component labelling of CV_8UC1 masks that measures each blob as it
+// labels it. The mask is cut into strips of rows labelled in parallel as runs of
+// foreground with union-find, and the strips are joined at their seams. Neither a
+// label image nor per-blob point lists are built, and buffers are kept between frames.
+class ComponentLabeller
+{
+public:
+    // Components of mask with at least minArea pixels, in no particular order;
+    // valid until the next call
+    const std::vector<Component> &label(const cv::Mat &mask, int minArea = 1);
+
+private:
+    // Foreground pixels [start, end) of row y
+    struct Run
+    {
+        int y;
+        int start;
+        int end;
+    };
+
+    struct Strip
+    {
+        int y0 = 0;
+        int y1 = 0;
+        std::vector<Run> runs;
+        std::vector<int> parents;  // Union-find over runs, local indices
+        std::vector<int> rowStart; // First run of each row, plus one past the last
+    };
+
+    // Sums a component accumulates from its runs
+    struct Moments
+    {
+        double area = 0.0;
+        double sumX = 0.0;
+        double sumY = 0.0;
+        double sumXX = 0.0;
+        double sumYY = 0.0;
+        double sumXY = 0.0;
+        int minX = 0;
+        int minY = 0;
+        int maxX = 0; // Exclusive
+        int maxY = 0;
+    };
+
+    static void labelStrip(const cv::Mat &mask, Strip &strip);
+
+    std::vector<Strip> strips;
+    std::vector<int> parents;      // Union-find over every run, global indices
+    std::vector<int> componentIds; // Per root run
+    std::vector<Moments> moments;
+    std::vector<Component> components;
+};
@@ -0,0 +1,212 @@
+#include "ControlBatcher.h"
+#include <QDebug>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+namespace
+{
+constexpr int DEFAULT_FLUSH_INTERVAL_MS = 33;
+
+int xioctl(int fd, unsigned long request, void *arg)
+{
+    int result;
+    do
+    {
+        result = ioctl(fd, request, arg);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+uint64_t elapsedNs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+}
+
+ControlBatcher::ControlBatcher(AppliedFunction applied, QObject *parent)
+    : QObject(parent), applied(std::move(applied)), fd(-1)
+{
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setTimerType(Qt::PreciseTimer);
+    flushTimer->setInterval(DEFAULT_FLUSH_INTERVAL_MS);
+    connect(flushTimer, &QTimer::timeout, this, &ControlBatcher::flush);
+}
+
+void ControlBatcher::setDevice(int deviceFd)
+{
+    flushTimer->stop();
+    pending.clear();
+    controlLatency.clear();
+    fd = deviceFd;
+}
+
+void ControlBatcher::setFlushInterval(int milliseconds)
+{
+    flushTimer->setInterval(std::max(1, milliseconds));
+}
+
+void ControlBatcher::set(uint32_t id, int32_t value)
+{
+    if (fd < 0)
+        return;
+
+    // Latency counts from the first change of a burst, so the timestamp is kept
+    auto existing = pending.find(id);
+    if (existing != pending.end())
+        existing->second.value = value;
+    else
+        pending[id] = {value, std::chrono::steady_clock::now()};
+
+    if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+bool ControlBatcher::apply(const std::map<uint32_t, int32_t> &values)
+{
+    if (fd < 0)
+        return false;
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &[id, value] : values)
+    {
+        auto existing = pending.find(id);
+        if (existing != pending.end())
+            existing->second.value = value;
+        else
+            pending[id] = {value, now};
+    }
+    return flush();
+}
+
+bool ControlBatcher::flush()
+{
+    flushTimer->stop();
+    if (fd < 0 || pending.empty())
+        return fd >= 0;
+
+    // Taken out first: the applied callback may queue further changes
+    std::map<uint32_t, PendingControl> batch;
+    batch.swap(pending);
+
+    std::vector<v4l2_ext_control> controls;
+    controls.reserve(batch.size());
+    for (const auto &[id, control] : batch)
+    {
+        v4l2_ext_control extControl = {};
+        extControl.id = id;
+        extControl.value = control.value;
+        controls.push_back(extControl);
+    }
+
+    v4l2_ext_controls request = {};
+    request.which = V4L2_CTRL_WHICH_CUR_VAL; // Lets one call span control classes
+    request.count = static_cast<__u32>(controls.size());
+    request.controls = controls.data();
+
+    auto start = std::chrono::steady_clock::now();
+    bool allAccepted = xioctl(fd, VIDIOC_S_EXT_CTRLS, &request) == 0;
+    std::vector<bool> accepted(controls.size(), allAccepted);
+    if (!allAccepted)
+    {
+        // Drivers stop at the first bad control and UVC has no rollback, so the
+        // batch is retried one control at a time to land every valid value
+        for (size_t i = 0; i < controls.size(); i++)
+        {
+            v4l2_control single = {};
+            single.id = controls[i].id;
+            single.value = controls[i].value;
+            accepted[i] = xioctl(fd, VIDIOC_S_CTRL, &single) == 0;
+            if (!accepted[i])
+                qWarning() << "Failed to set control" << single.id << "to value" << single.value;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    batchLatency.record(elapsedNs(start, end));
+
+    size_t index = 0;
+    bool success = true;
+    for (const auto &[id, control] : batch)
+    {
+        if (accepted[index++])
+        {
+            latencyFor(id).histogram.record(elapsedNs(control.queuedAt, end));
+            if (applied)
+                applied(id, control.value);
+        }
+        else
+        {
+            success = false;
+        }
+    }
+    return success;
+}
+
+bool ControlBatcher::hasPending(uint32_t id) const
+{
+    return pending.count(id) > 0;
+}
+
+ControlBatcher::ControlLatency &ControlBatcher::latencyFor(uint32_t id)
+{
+    std::unique_ptr<ControlLatency> &entry = controlLatency[id];
+    if (!entry)
+    {
+        // The driver's name is looked up once, the first time a control is written
+        entry = std::make_unique<ControlLatency>();
+        v4l2_queryctrl query = {};
+        query.id = id;
+        if (xioctl(fd, VIDIOC_QUERYCTRL, &query) == 0)
+            entry->name = QString::fromUtf8(reinterpret_cast<const char *>(query.name)).left(12);
+        else
+            entry->name = QString("0x%1").arg(id, 8, 16, QChar('0'));
+    }
+    return *entry;
+}
+
+QString ControlBatcher::formatTable() const
+{
+    LatencyHistogram::Summary batch = batchLatency.summary();
+    if (batch.count == 0)
+        return QString();
+
+    auto row = [](const QString &name, const LatencyHistogram::Summary &s)
+    {
+        return QString("%1 %2 %3 %4 %5 %6 %7\n")
+            .arg(name, -12)
+            .arg(static_cast<qulonglong>(s.count), 8)
+            .arg(s.meanMs, 8, 'f', 2)
+            .arg(s.p50Ms, 8, 'f', 2)
+            .arg(s.p95Ms, 8, 'f', 2)
+            .arg(s.p99Ms, 8, 'f', 2)
+            .arg(s.maxMs, 8, 'f', 2);
+    };
+
+    QString table = QString("%1 %2 %3 %4 %5 %6 %7\n")
+                        .arg("control", -12)
+                        .arg("count", 8)
+                        .arg("mean", 8)
+                        .arg("p50", 8)
+                        .arg("p95", 8)
+                        .arg("p99", 8)
+                        .arg("max", 8);
+    table += row("ext ioctl", batch);
+    for (const auto &[id, entry] : controlLatency)
+    {
+        LatencyHistogram::Summary s = entry->histogram.summary();
+        if (s.count > 0)
+            table += row(entry->name, s);
+    }
+    return table;
+}
+
+void ControlBatcher::reset()
+{
+    batchLatency.reset();
+    for (auto &[id, entry] : controlLatency)
+    {
+        entry->histogram.reset();
+    }
+}
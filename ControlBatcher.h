@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include "PipelineMetrics.h"
+
+// Coalesces V4L2 control changes and writes them together with VIDIOC_S_EXT_CTRLS.
+// A slider drag sets the same control dozens of times per frame; only the latest
+// value of each control is kept, and everything pending is written in one ioctl
+// per flush interval, so the camera's control endpoint sees one transfer per frame
+// instead of one per tick. Used from the UI thread only.
+class ControlBatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    using AppliedFunction = std::function<void(uint32_t id, int32_t value)>;
+
+    // applied is called for every control value the driver accepted
+    explicit ControlBatcher(AppliedFunction applied, QObject *parent = nullptr);
+
+    // Device the controls are written to, -1 to detach; pending changes are dropped
+    void setDevice(int deviceFd);
+
+    // Longest a change waits before it is written, normally one frame interval
+    void setFlushInterval(int milliseconds);
+
+    // Queue a change; a later value for the same control replaces it
+    void set(uint32_t id, int32_t value);
+
+    // Write a whole profile now in a single call, together with anything pending
+    bool apply(const std::map<uint32_t, int32_t> &values);
+
+    // Write everything pending now
+    bool flush();
+
+    // True while a change to id is queued and not yet written
+    bool hasPending(uint32_t id) const;
+
+    // Latency from the first queued change to the driver accepting it, per control,
+    // and the time spent in the ioctl per batch
+    QString formatTable() const;
+    void reset();
+
+private:
+    struct PendingControl
+    {
+        int32_t value;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    struct ControlLatency
+    {
+        QString name;
+        LatencyHistogram histogram;
+    };
+
+    ControlLatency &latencyFor(uint32_t id);
+
+    AppliedFunction applied;
+    int fd;
+    QTimer *flushTimer;
+    std::map<uint32_t, PendingControl> pending;
+    std::map<uint32_t, std::unique_ptr<ControlLatency>> controlLatency;
+    LatencyHistogram batchLatency;
+};
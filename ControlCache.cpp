@@ -0,0 +1,300 @@
+#include "ControlCache.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+
+namespace
+{
+int xioctl(int fd, unsigned long request, void *arg)
+{
+    int result;
+    do
+    {
+        result = ioctl(fd, request, arg);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+// Controls whose current value can be read as a plain number
+bool hasReadableValue(const CachedControl &control)
+{
+    return control.type != V4L2_CTRL_TYPE_BUTTON && control.type != V4L2_CTRL_TYPE_CTRL_CLASS &&
+           !(control.flags & (V4L2_CTRL_FLAG_WRITE_ONLY | V4L2_CTRL_FLAG_HAS_PAYLOAD));
+}
+}
+
+bool CachedControl::isActive() const
+{
+    return !(flags & (V4L2_CTRL_FLAG_INACTIVE | V4L2_CTRL_FLAG_DISABLED));
+}
+
+ControlCache::ControlCache(QObject *parent)
+    : QObject(parent), fd(-1), eventsSubscribed(false), eventNotifier(nullptr)
+{
+}
+
+ControlCache::~ControlCache()
+{
+    detach();
+}
+
+bool ControlCache::attach(int deviceFd)
+{
+    detach();
+    if (deviceFd < 0)
+        return false;
+    fd = deviceFd;
+
+    enumerate();
+    readValues();
+    subscribe();
+    qInfo() << "Cached" << controls.size() << "controls" << (eventsSubscribed ? "with" : "without") << "change events";
+    return !controls.empty();
+}
+
+void ControlCache::detach()
+{
+    delete eventNotifier;
+    eventNotifier = nullptr;
+    if (fd >= 0 && eventsSubscribed)
+    {
+        v4l2_event_subscription subscription = {};
+        subscription.type = V4L2_EVENT_ALL;
+        xioctl(fd, VIDIOC_UNSUBSCRIBE_EVENT, &subscription);
+    }
+    eventsSubscribed = false;
+    fd = -1;
+
+    QMutexLocker lock(&mutex);
+    controls.clear();
+}
+
+void ControlCache::enumerate()
+{
+    std::map<uint32_t, CachedControl> found;
+
+    v4l2_query_ext_ctrl query = {};
+    query.id = V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    while (xioctl(fd, VIDIOC_QUERY_EXT_CTRL, &query) == 0)
+    {
+        if (query.type != V4L2_CTRL_TYPE_CTRL_CLASS && !(query.flags & V4L2_CTRL_FLAG_DISABLED))
+        {
+            CachedControl control;
+            control.id = query.id;
+            control.type = query.type;
+            control.name = QString::fromUtf8(query.name);
+            control.minimum = query.minimum;
+            control.maximum = query.maximum;
+            control.step = query.step;
+            control.defaultValue = query.default_value;
+            control.flags = query.flags;
+
+            if (query.type == V4L2_CTRL_TYPE_MENU || query.type == V4L2_CTRL_TYPE_INTEGER_MENU)
+            {
+                // Menus may have holes; only indices the driver answers for are valid
+                for (int64_t index = query.minimum; index <= query.maximum; index++)
+                {
+                    v4l2_querymenu item = {};
+                    item.id = query.id;
+                    item.index = static_cast<__u32>(index);
+                    if (xioctl(fd, VIDIOC_QUERYMENU, &item) != 0)
+                        continue;
+                    QString label = query.type == V4L2_CTRL_TYPE_MENU
+                                        ? QString::fromUtf8(reinterpret_cast<const char *>(item.name))
+                                        : QString::number(item.value);
+                    control.menu.emplace_back(index, label);
+                }
+            }
+            found[control.id] = control;
+        }
+        query.id |= V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    }
+
+    QMutexLocker lock(&mutex);
+    controls.swap(found);
+}
+
+void ControlCache::readValues()
+{
+    std::vector<v4l2_ext_control> values;
+    {
+        QMutexLocker lock(&mutex);
+        for (const auto &[id, control] : controls)
+        {
+            if (!hasReadableValue(control))
+                continue;
+            v4l2_ext_control value = {};
+            value.id = id;
+            values.push_back(value);
+        }
+    }
+    if (values.empty())
+        return;
+
+    // One call for everything; a driver that rejects the batch is asked per control
+    v4l2_ext_controls request = {};
+    request.which = V4L2_CTRL_WHICH_CUR_VAL;
+    request.count = static_cast<__u32>(values.size());
+    request.controls = values.data();
+    bool batchRead = xioctl(fd, VIDIOC_G_EXT_CTRLS, &request) == 0;
+    std::vector<bool> valid(values.size(), batchRead);
+    if (!batchRead)
+    {
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            v4l2_ext_controls single = {};
+            single.which = V4L2_CTRL_WHICH_CUR_VAL;
+            single.count = 1;
+            single.controls = &values[i];
+            valid[i] = xioctl(fd, VIDIOC_G_EXT_CTRLS, &single) == 0;
+        }
+    }
+
+    QMutexLocker lock(&mutex);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (!valid[i])
+            continue;
+        CachedControl &control = controls[values[i].id];
+        control.value = control.type == V4L2_CTRL_TYPE_INTEGER64 ? values[i].value64 : values[i].value;
+    }
+}
+
+void ControlCache::subscribe()
+{
+    // Feedback is on so flag changes caused by our own writes (e.g. exposure
+    // mode making manual exposure inactive) arrive too
+    for (uint32_t id : ids())
+    {
+        v4l2_event_subscription subscription = {};
+        subscription.type = V4L2_EVENT_CTRL;
+        subscription.id = id;
+        subscription.flags = V4L2_EVENT_SUB_FL_ALLOW_FEEDBACK;
+        if (xioctl(fd, VIDIOC_SUBSCRIBE_EVENT, &subscription) == 0)
+            eventsSubscribed = true;
+    }
+    if (!eventsSubscribed)
+        return;
+
+    // Pending events make the fd report POLLPRI, which Qt calls an exception
+    eventNotifier = new QSocketNotifier(fd, QSocketNotifier::Exception, this);
+    connect(eventNotifier, &QSocketNotifier::activated, this, &ControlCache::onEvent);
+}
+
+void ControlCache::onEvent()
+{
+    // Drain what the driver has queued; the fd is non-blocking, so an empty queue is EAGAIN
+    for (;;)
+    {
+        v4l2_event event = {};
+        if (xioctl(fd, VIDIOC_DQEVENT, &event) != 0)
+        {
+            if (errno != EAGAIN)
+                qWarning() << "VIDIOC_DQEVENT failed";
+            return;
+        }
+
+        if (event.type == V4L2_EVENT_CTRL)
+        {
+            const v4l2_event_ctrl &change = event.u.ctrl;
+            {
+                QMutexLocker lock(&mutex);
+                auto entry = controls.find(event.id);
+                if (entry != controls.end())
+                {
+                    CachedControl &control = entry->second;
+                    if (change.changes & V4L2_EVENT_CTRL_CH_VALUE)
+                        control.value = change.type == V4L2_CTRL_TYPE_INTEGER64 ? change.value64 : change.value;
+                    if (change.changes & V4L2_EVENT_CTRL_CH_FLAGS)
+                        control.flags = change.flags;
+                    if (change.changes & V4L2_EVENT_CTRL_CH_RANGE)
+                    {
+                        control.minimum = change.minimum;
+                        control.maximum = change.maximum;
+                        control.step = change.step;
+                        control.defaultValue = change.default_value;
+                    }
+                }
+            }
+            emit controlChanged(event.id, change.changes);
+        }
+
+        if (event.pending == 0)
+            return;
+    }
+}
+
+bool ControlCache::contains(uint32_t id) const
+{
+    QMutexLocker lock(&mutex);
+    return controls.count(id) > 0;
+}
+
+bool ControlCache::control(uint32_t id, CachedControl &result) const
+{
+    QMutexLocker lock(&mutex);
+    auto entry = controls.find(id);
+    if (entry == controls.end())
+        return false;
+    result = entry->second;
+    return true;
+}
+
+int64_t ControlCache::value(uint32_t id, int64_t fallback) const
+{
+    QMutexLocker lock(&mutex);
+    auto entry = controls.find(id);
+    return entry != controls.end() ? entry->second.value : fallback;
+}
+
+std::vector<uint32_t> ControlCache::ids() const
+{
+    QMutexLocker lock(&mutex);
+    std::vector<uint32_t> result;
+    result.reserve(controls.size());
+    for (const auto &[id, control] : controls)
+        result.push_back(id);
+    return result;
+}
+
+void ControlCache::setValue(uint32_t id, int64_t value)
+{
+    QMutexLocker lock(&mutex);
+    auto entry = controls.find(id);
+    if (entry != controls.end())
+        entry->second.value = value;
+}
+
+void ControlCache::refreshFlags()
+{
+    if (fd < 0)
+        return;
+
+    std::vector<uint32_t> changed;
+    for (uint32_t id : ids())
+    {
+        v4l2_query_ext_ctrl query = {};
+        query.id = id;
+        if (xioctl(fd, VIDIOC_QUERY_EXT_CTRL, &query) != 0)
+            continue;
+
+        QMutexLocker lock(&mutex);
+        CachedControl &control = controls[id];
+        if (control.flags != query.flags)
+            changed.push_back(id);
+        control.flags = query.flags;
+        control.minimum = query.minimum;
+        control.maximum = query.maximum;
+        control.step = query.step;
+        control.defaultValue = query.default_value;
+    }
+    for (uint32_t id : changed)
+        emit controlChanged(id, V4L2_EVENT_CTRL_CH_FLAGS);
+}
+
+bool ControlCache::hasEvents() const
+{
+    return eventsSubscribed;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QMutex>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// One V4L2 control as the driver last reported it
+struct CachedControl
+{
+    uint32_t id = 0;
+    uint32_t type = 0; // V4L2_CTRL_TYPE_*
+    QString name;
+    int64_t minimum = 0;
+    int64_t maximum = 0;
+    uint64_t step = 1;
+    int64_t defaultValue = 0;
+    int64_t value = 0;
+    uint32_t flags = 0;                             // V4L2_CTRL_FLAG_*
+    std::vector<std::pair<int64_t, QString>> menu; // Valid menu indices and their names
+
+    bool isActive() const;
+};
+
+// In-memory copy of every control of a device.
+// Controls are enumerated once when the device is attached, including menus and
+// extended ids, and kept current through V4L2_EVENT_CTRL: the driver queues an
+// event whenever a value, flag or range changes, from this process or any other,
+// and a socket notifier on the UI thread applies it. Readers never issue ioctls,
+// and lookups are safe from any thread.
+class ControlCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ControlCache(QObject *parent = nullptr);
+    ~ControlCache() override;
+
+    // Enumerate and subscribe on deviceFd; the fd must stay open until detach()
+    bool attach(int deviceFd);
+    void detach();
+
+    bool contains(uint32_t id) const;
+    bool control(uint32_t id, CachedControl &result) const;
+    int64_t value(uint32_t id, int64_t fallback = -1) const;
+    std::vector<uint32_t> ids() const;
+
+    // Record a value this process wrote, for drivers that do not send events
+    void setValue(uint32_t id, int64_t value);
+
+    // Re-read flags and ranges; only needed when the driver has no control events
+    void refreshFlags();
+    bool hasEvents() const;
+
+signals:
+    // Emitted on the UI thread; changes is a mask of V4L2_EVENT_CTRL_CH_*
+    void controlChanged(uint32_t id, uint32_t changes);
+
+private:
+    void enumerate();
+    void readValues();
+    void subscribe();
+    void onEvent();
+
+    int fd;
+    bool eventsSubscribed;
+    QSocketNotifier *eventNotifier;
+    mutable QMutex mutex;
+    std::map<uint32_t, CachedControl> controls;
+};
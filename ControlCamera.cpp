@@ -7,21 +7,89 @@
 #include <QSettings>
 #include <QFile>
 #include <QScrollArea>
-
-// Initialize static member
+#include <QScreen>
+#include <QPushButton>
+#include <QFontDatabase>
+#include <QMutexLocker>
+#include <QFileDialog>
+#include <QDateTime>
+#include <QDir>
+#include <QSignalBlocker>
+#include <QSpinBox>
+#include "ReplayFrameSource.h"
+#include "AllocationTracker.h"
+#include <chrono>
+
+// Initialize static members
 bool ControlCamera::python_initialized = false;
+pybind11::gil_scoped_release *ControlCamera::python_gil_release = nullptr;
 
 ControlCamera::ControlCamera(int deviceIndex, QWidget *parent)
-    : QWidget(parent), fd(-1), deviceIndex(deviceIndex), modelLoaded(false), veinDetectionEnabled(true)
+    : ControlCamera(deviceIndex, std::make_unique<V4L2FrameSource>(deviceIndex), parent)
+{
+}
+
+ControlCamera::ControlCamera(int deviceIndex, std::unique_ptr<FrameSource> frameSource, QWidget *parent)
+    : QWidget(parent), fd(-1), deviceIndex(deviceIndex), source(std::move(frameSource)), captureThread(nullptr), captureRunning(false),
+      autoRegionRequested(false), flatFieldEnabled(false), calibrationRequest(0), idleSkippedFrames(0), statisticsExposure(false), veinGraphEnabled(false), detectionThreshold(0.5f), capturedFrames(0), modelLoaded(false), veinDetectionEnabled(true), bestTrackId(-1)
 {
     // Initialize Python interpreter if not already done
     if (!python_initialized)
     {
         pybind11::initialize_interpreter();
+        python_gil_release = new pybind11::gil_scoped_release();
         python_initialized = true;
     }
 
+    veinProcessor.setMetrics(&metrics);
+    source->setRecorder(&recorder);
+    source->setMetrics(&metrics);
+
+    controlCache = new ControlCache(this);
+    connect(controlCache, &ControlCache::controlChanged, this, &ControlCamera::onControlChanged);
+    controlBatcher = new ControlBatcher([this](uint32_t id, int32_t value)
+                                        {
+        controlCache->setValue(id, value);
+        recorder.appendControl(id, value);
+        // Exposure mode decides which other controls are active; drivers with
+        // control events report that themselves
+        if (id == V4L2_CID_EXPOSURE_AUTO && !controlCache->hasEvents())
+            controlCache->refreshFlags(); }, this);
+
     setupUI();
+
+    FrameTracer::setThreadName("ui");
+    presenter = new FramePresenter([this](const FrameResult &result)
+                                   {
+        FrameTracer::setFrameId(result.frameId);
+        {
+            StageTimer timer(&metrics, PipelineStage::Presentation);
+            presentedRegion = result.tag.region;
+            drawDetections(previewWidget->overlay(), result.detections, result.graph, presentedRegion.tl());
+            previewWidget->setFrame(result.frame);
+        }
+        recordFrameAge(result.tag, FrameMilestone::Presented); }, this);
+    connect(presenter, &FramePresenter::fpsUpdated, this, [this](double processed, double displayed)
+            {
+        QString status = QString("Delivered: %1 fps | Processed: %2 fps | Displayed: %3 fps | Load: %4")
+                             .arg(source->deliveredFps(), 0, 'f', 1)
+                             .arg(processed, 0, 'f', 1)
+                             .arg(displayed, 0, 'f', 1)
+                             .arg(LoadController::levelName(loadController.level()));
+        QString mode = source->modeDescription();
+        if (!mode.isEmpty())
+            status.prepend(mode + " | ");
+        if (!presentedRegion.empty())
+            status += QString(" | Region: %1x%2 at %3,%4")
+                          .arg(presentedRegion.width)
+                          .arg(presentedRegion.height)
+                          .arg(presentedRegion.x)
+                          .arg(presentedRegion.y);
+        if (recorder.isRecording())
+            status += QString(" | Recorded: %1").arg(recorder.framesWritten());
+        fpsLabel->setText(status);
+        if (metricsLabel->isVisible())
+            metricsLabel->setText(metrics.formatTable() + "\n" + controlBatcher->formatTable()); });
 }
 
 ControlCamera::~ControlCamera()
@@ -29,57 +97,101 @@ ControlCamera::~ControlCamera()
     saveConfiguration();
     closeCamera();
 
+    // Drop Python references while holding the GIL
+    {
+        pybind11::gil_scoped_acquire gil;
+        yolo_module = pybind11::module_();
+    }
+
     // Note: Python interpreter cleanup is handled by pybind11 automatically
     // Don't call pybind11::finalize_interpreter() here as other instances might still need it
 }
 
 bool ControlCamera::openCamera()
 {
-    QString devName = QString("/dev/video%1").arg(deviceIndex);
-    fd = open(devName.toStdString().c_str(), O_RDWR);
-
-    if (fd < 0)
+    // Sources without a device node (virtual cameras) run without V4L2 controls
+    QString devName = source->devicePath();
+    if (!devName.isEmpty())
     {
-        qWarning() << "Failed to open camera at" << devName;
-        return false;
+        // Non-blocking so draining driver events never stalls the UI thread
+        fd = open(devName.toStdString().c_str(), O_RDWR | O_NONBLOCK);
+        if (fd < 0)
+        {
+            qWarning() << "Failed to open camera at" << devName;
+            return false;
+        }
+
+        // Controls are read once here and then follow driver events
+        controlCache->attach(fd);
+
+        controlBatcher->setDevice(fd);
     }
 
-    cap.open(deviceIndex);
-    if (!cap.isOpened())
+    if (!source->open())
     {
-        qWarning() << "OpenCV failed to open camera at index" << deviceIndex;
-        ::close(fd);
-        fd = -1;
+        qWarning() << "Failed to open frame source" << source->name();
+        if (fd >= 0)
+        {
+            // Nothing may keep watching or writing a descriptor that is about to be reused
+            controlBatcher->setDevice(-1);
+            controlCache->detach();
+            ::close(fd);
+            fd = -1;
+        }
         return false;
     }
 
-    frameTimer = new QTimer(this);
-    frameTimer->setInterval(30); // ~33 FPS
-    connect(frameTimer, &QTimer::timeout, this, &ControlCamera::grabFrame);
-    frameTimer->start();
+    // Control changes are flushed once per frame interval, as negotiated by the source
+    if (fd >= 0)
+    {
+        v4l2_streamparm streamParm = {};
+        streamParm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (ioctl(fd, VIDIOC_G_PARM, &streamParm) == 0 && streamParm.parm.capture.timeperframe.denominator > 0)
+        {
+            const v4l2_fract &interval = streamParm.parm.capture.timeperframe;
+            controlBatcher->setFlushInterval(static_cast<int>(1000 * interval.numerator / interval.denominator));
+        }
+    }
 
     setupControlsFromV4L2();
     loadInitialControlValues();
     loadConfiguration(); // Load saved user config
     updateControlStates();
 
+    // Capture paces itself on the driver; the presenter paces itself on the display
+    exposureController.reset();
+    idleSkippedFrames = 0;
+    captureRunning = true;
+    captureThread = QThread::create([this]()
+                                    {
+        FrameTracer::setThreadName(QString("capture %1").arg(source->name()));
+        while (captureRunning.load(std::memory_order_relaxed))
+            grabFrame(); });
+    captureThread->start();
+
+    QScreen *display = screen();
+    presenter->start(display ? display->refreshRate() : 60.0);
+
     return true;
 }
 
 void ControlCamera::closeCamera()
 {
-    if (frameTimer)
-    {
-        frameTimer->stop();
-        frameTimer->deleteLater();
-        frameTimer = nullptr;
-    }
-    if (cap.isOpened())
+    if (captureThread)
     {
-        cap.release();
+        captureRunning = false;
+        source->interrupt();
+        captureThread->wait();
+        delete captureThread;
+        captureThread = nullptr;
     }
+    presenter->stop();
+    source->close();
     if (fd >= 0)
     {
+        controlBatcher->flush();
+        controlBatcher->setDevice(-1);
+        controlCache->detach();
         ::close(fd);
         fd = -1;
     }
@@ -87,66 +199,255 @@ void ControlCamera::closeCamera()
 
 bool ControlCamera::isOpen() const
 {
-    return fd >= 0 && cap.isOpened();
+    return source->isOpened() && (fd >= 0 || source->devicePath().isEmpty());
 }
 
-bool ControlCamera::ioctlQueryControl(__u32 id, v4l2_queryctrl &ctrl)
+bool ControlCamera::setControl(__u32 id, int value)
 {
-    memset(&ctrl, 0, sizeof(v4l2_queryctrl));
-    ctrl.id = id;
-    return ioctl(fd, VIDIOC_QUERYCTRL, &ctrl) == 0;
+    // Written with the rest of this frame's changes; recorded once the driver accepts it
+    if (fd < 0)
+        return false;
+    controlBatcher->set(id, value);
+    return true;
 }
 
-bool ControlCamera::ioctlSetControl(__u32 id, int value)
+int ControlCamera::getControl(__u32 id)
 {
-    v4l2_control control = {};
-    control.id = id;
-    control.value = value;
-    if (ioctl(fd, VIDIOC_S_CTRL, &control) != 0)
+    return static_cast<int>(controlCache->value(id, -1));
+}
+
+void ControlCamera::grabFrame()
+{
+    if (!source->isOpened())
+        return;
+    FrameTracer::setFrameId(capturedFrames + 1);
+    TraceScope frameScope("grabFrame");
+
+    // Sleeps until the source has the next frame, or returns false on a timeout or interrupt
+    if (!source->read(workingFrame.frame))
     {
-        qWarning() << "Failed to set control" << id << "to value" << value;
-        return false;
+        QThread::msleep(10);
+        return;
     }
-    return true;
+    workingFrame.tag = source->tag();
+    metrics.recordDrops(workingFrame.tag.sensorDropped, workingFrame.tag.skipped);
+    cv::Point origin = workingFrame.tag.region.tl();
+    if (autoRegionRequested.exchange(false))
+    {
+        // Takes effect from the next read; this frame is processed as it is
+        cv::Rect arm = veinProcessor.findArmRegion(workingFrame.frame);
+        if (arm.empty())
+            qInfo() << "No arm found in" << source->name() << "to crop to";
+        else
+            source->setRegion(arm + origin);
+    }
+    ingestFlatField(workingFrame);
+    auto frameStart = std::chrono::steady_clock::now();
+    bool countAllocations = AllocationTracker::enabled();
+    AllocationTracker::Counts allocationsBefore;
+    if (countAllocations)
+        allocationsBefore = AllocationTracker::threadCounts();
+
+    // Snapshot the UI-owned settings for this frame
+    bool detectionEnabled;
+    VeinProcessingConfig frameVeinConfig;
+    TrackerConfig frameTrackerConfig;
+    {
+        QMutexLocker lock(&configMutex);
+        frameVeinConfig = veinConfig;
+        frameTrackerConfig = trackerConfig;
+        loadController.setConfig(loadSheddingConfig);
+        detectionEnabled = veinDetectionEnabled;
+        detectionThreshold = visualConfig.confidenceThreshold;
+    }
+
+    // Degrade this frame's settings as far as the load controller asks
+    double processingScale = 1.0;
+    loadController.apply(frameVeinConfig, frameTrackerConfig, processingScale);
+    veinProcessor.setConfig(frameVeinConfig);
+    veinTracker.setConfig(frameTrackerConfig);
+
+    // Process the frame with vein detection if enabled
+    double detectionMs = 0.0;
+    workingFrame.detections.clear();
+    if (!detectionEnabled)
+    {
+        veinTracker.reset();
+    }
+    else if (!frameTrackerConfig.enabled)
+    {
+        // Untracked, an idle scene is still only looked at every detection interval
+        if (loadController.idleScene() && ++idleSkippedFrames < frameTrackerConfig.detectionInterval)
+        {
+            denoiseSkippedFrame(frameVeinConfig, processingScale);
+        }
+        else
+        {
+            idleSkippedFrames = 0;
+            detectionMs = detectAtScale(workingFrame.frame, processingScale, origin, workingFrame.detections);
+            recordFrameAge(workingFrame.tag, FrameMilestone::Detected);
+        }
+    }
+    else if (veinTracker.needsDetection(loadController.idleScene()))
+    {
+        // Detector frame: associate fresh detections with existing tracks
+        rawDetections.clear();
+        detectionMs = detectAtScale(workingFrame.frame, processingScale, origin, rawDetections);
+        recordFrameAge(workingFrame.tag, FrameMilestone::Detected);
+        StageTimer timer(&metrics, PipelineStage::Tracking);
+        veinTracker.update(rawDetections, workingFrame.detections);
+    }
+    else
+    {
+        // Between detector runs the tracks are predicted forward
+        denoiseSkippedFrame(frameVeinConfig, processingScale);
+        StageTimer timer(&metrics, PipelineStage::Tracking);
+        veinTracker.predict(workingFrame.detections);
+    }
+
+    // Centrelines stay those of the last detector frame while tracks are predicted
+    if (detectionEnabled && veinGraphEnabled.load(std::memory_order_relaxed))
+        workingFrame.graph = veinGraph;
+    else
+        workingFrame.graph.clear();
+
+    double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    loadController.recordFrame(frameMs, detectionMs);
+    if (traceTrigger.check(frameMs))
+    {
+        QMetaObject::invokeMethod(this, [this, frameMs]()
+                                  { saveTrace(QString("spike-%1ms").arg(qRound(frameMs))); }, Qt::QueuedConnection);
+    }
+
+    workingFrame.frameId = ++capturedFrames;
+    recordFrameAge(workingFrame.tag, FrameMilestone::Processed);
+    if (presenter->publish(workingFrame))
+        metrics.recordDrops(0, 1);
+    if (countAllocations)
+        metrics.frameAllocations().record(AllocationTracker::threadCounts() - allocationsBefore);
 }
 
-bool ControlCamera::setControl(__u32 id, int value)
+void ControlCamera::ingestFlatField(FrameResult &frame)
 {
-    if (fd < 0)
-        return false;
-    return ioctlSetControl(id, value);
+    int request = calibrationRequest.exchange(0);
+    if (request != 0)
+        flatFieldCalibrator.start(static_cast<FlatFieldCalibrator::Reference>(request - 1));
+    if (flatFieldCalibrator.isCapturing())
+    {
+        // References must cover the frame the map is applied to, whatever is cropped later
+        if (!frame.tag.region.empty())
+        {
+            qWarning() << "Flat field calibration needs the full frame; cancelled";
+            flatFieldCalibrator.cancel();
+        }
+        else if (flatFieldCalibrator.addFrame(frame.frame))
+        {
+            if (flatFieldCalibrator.compute(flatField))
+            {
+                flatField.save(flatFieldPath());
+                qInfo() << "Flat field of" << source->name() << "calibrated and saved to" << flatFieldPath();
+            }
+            else
+            {
+                qInfo() << "Dark reference of" << source->name() << "captured; capture a flat to finish";
+            }
+        }
+    }
+
+    // Luma is extracted here, corrected in the same pass, instead of by the vein chain
+    if (!flatFieldEnabled.load(std::memory_order_relaxed) || !flatField.isValid())
+        return;
+    StageTimer timer(&metrics, PipelineStage::FlatField);
+    if (flatField.apply(frame.frame, frame.tag.region, correctedFrame))
+        cv::swap(frame.frame, correctedFrame);
 }
 
-int ControlCamera::getControl(__u32 id)
+void ControlCamera::denoiseSkippedFrame(const VeinProcessingConfig &config, double scale)
 {
-    if (fd < 0)
-        return -1;
-    v4l2_control control = {};
-    control.id = id;
-    if (ioctl(fd, VIDIOC_G_CTRL, &control) != 0)
+    if (modelLoaded || !config.temporalDenoiseEnabled)
+        return;
+    const cv::Mat *frame = &workingFrame.frame;
+    if (scale < 1.0)
     {
-        return -1;
+        cv::resize(workingFrame.frame, scaledFrame, cv::Size(), scale, scale, cv::INTER_AREA);
+        frame = &scaledFrame;
     }
-    return control.value;
+    veinProcessor.updateTemporalDenoise(*frame);
 }
 
-void ControlCamera::grabFrame()
+void ControlCamera::updateExposure(const FrameStatistics &stats)
 {
-    if (!cap.isOpened())
-        return;
-    cv::Mat frame;
-    if (!cap.read(frame) || frame.empty())
+    // Only a camera in manual exposure takes its exposure time from here
+    CachedControl exposure;
+    if (!statisticsExposure.load(std::memory_order_relaxed) || fd < 0 ||
+        controlCache->value(V4L2_CID_EXPOSURE_AUTO) != V4L2_EXPOSURE_MANUAL ||
+        !controlCache->control(V4L2_CID_EXPOSURE_ABSOLUTE, exposure) || !exposure.isActive())
         return;
 
-    // Process the frame with vein detection if enabled
-    if (veinDetectionEnabled)
+    int64_t next = exposureController.update(stats, exposure.value, exposure.minimum, exposure.maximum);
+    if (next != exposure.value)
     {
-        frame = processFrameWithModel(frame);
+        // Control writes are batched on the UI thread
+        QMetaObject::invokeMethod(this, [this, next]()
+                                  { setControl(V4L2_CID_EXPOSURE_ABSOLUTE, static_cast<int>(next)); }, Qt::QueuedConnection);
     }
+}
+
+double ControlCamera::detectAtScale(const cv::Mat &frame, double scale, const cv::Point &origin, std::vector<Detection> &detections)
+{
+    StageTimer timer(&metrics, PipelineStage::Detection);
+    auto start = std::chrono::steady_clock::now();
+
+    if (scale < 1.0)
+    {
+        // Detect on a downscaled copy and map boxes back to full frame coordinates
+        cv::resize(frame, scaledFrame, cv::Size(), scale, scale, cv::INTER_AREA);
+        processFrameWithModel(scaledFrame, detections);
+        for (Detection &detection : detections)
+        {
+            cv::Rect &box = detection.boundingBox;
+            box = cv::Rect(cvRound(box.x / scale), cvRound(box.y / scale),
+                           cvRound(box.width / scale), cvRound(box.height / scale));
+        }
+        for (VeinSegment &segment : veinGraph.segments)
+        {
+            for (cv::Point &point : segment.points)
+                point = cv::Point(cvRound(point.x / scale), cvRound(point.y / scale));
+            segment.length /= scale;
+            segment.meanWidth /= scale;
+        }
+        for (VeinJunction &junction : veinGraph.junctions)
+            junction.position *= static_cast<float>(1.0 / scale);
+    }
+    else
+    {
+        processFrameWithModel(frame, detections);
+    }
+
+    // A cropped frame's boxes move to where they are in the full frame, so tracks
+    // and markers are unaffected by the region changing
+    if (origin != cv::Point())
+    {
+        for (Detection &detection : detections)
+            detection.boundingBox += origin;
+        for (VeinSegment &segment : veinGraph.segments)
+        {
+            for (cv::Point &point : segment.points)
+                point += origin;
+        }
+        for (VeinJunction &junction : veinGraph.junctions)
+            junction.position += cv::Point2f(origin);
+    }
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-    cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
-    QImage img(frame.data, frame.cols, frame.rows, static_cast<int>(frame.step), QImage::Format_RGB888);
-    previewLabel->setPixmap(QPixmap::fromImage(img).scaled(previewLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+void ControlCamera::recordFrameAge(const FrameTag &tag, FrameMilestone milestone)
+{
+    // Sources without a capture timestamp are left out rather than counted as zero
+    uint64_t now = monotonicNowNs();
+    if (tag.timestampNs != 0 && now > tag.timestampNs)
+        metrics.frameAge(milestone).record(now - tag.timestampNs);
 }
 
 void ControlCamera::addSliderRow(QVBoxLayout *parent, const QString &label, QSlider *&slider)
@@ -187,10 +488,16 @@ void ControlCamera::setupUI()
     mainLayout->setContentsMargins(15, 15, 15, 15);
     mainLayout->setSpacing(15);
 
-    previewLabel = new QLabel(scrollWidget);
-    previewLabel->setFixedSize(320, 240); // Smaller preview size
-    previewLabel->setStyleSheet("background-color: black; border-radius: 8px;");
-    mainLayout->addWidget(previewLabel, 0, Qt::AlignHCenter);
+    previewWidget = new PreviewWidget(scrollWidget);
+    previewWidget->setFixedSize(320, 240); // Smaller preview size
+    mainLayout->addWidget(previewWidget, 0, Qt::AlignHCenter);
+
+    fpsLabel = new QLabel("Delivered: - fps | Processed: - fps | Displayed: - fps", scrollWidget);
+    fpsLabel->setAlignment(Qt::AlignHCenter);
+    mainLayout->addWidget(fpsLabel);
+    mainLayout->addLayout(createRecordingRow(scrollWidget));
+    mainLayout->addLayout(createRegionRow(scrollWidget));
+    mainLayout->addLayout(createFlatFieldRow(scrollWidget));
 
     QGroupBox *controlGroup = new QGroupBox("Camera Controls", scrollWidget);
     QVBoxLayout *controlsLayout = new QVBoxLayout(controlGroup);
@@ -214,6 +521,13 @@ void ControlCamera::setupUI()
 
     addComboBoxRow(controlsLayout, "Exposure Mode", autoExposureCombo);
 
+    // Meters on the frames vein processing sees, so it only acts without a model
+    QCheckBox *statisticsExposureCheck = new QCheckBox("Auto Exposure from Vein Frames (manual mode)", scrollWidget);
+    statisticsExposureCheck->setChecked(statisticsExposure);
+    controlsLayout->addWidget(statisticsExposureCheck);
+    connect(statisticsExposureCheck, &QCheckBox::toggled, this, [this](bool checked)
+            { statisticsExposure = checked; });
+
     // Add vein detection checkbox
     QHBoxLayout *veinDetectionRow = new QHBoxLayout();
     QLabel *veinDetectionLabel = new QLabel("Vein Detection", scrollWidget);
@@ -256,6 +570,13 @@ void ControlCamera::setupUI()
     detectionLayout->addWidget(showConfidenceCheck);
     connect(showConfidenceCheck, &QCheckBox::toggled, this, &ControlCamera::showConfidence);
 
+    // Vein centrelines and branch points, from vein processing when no model is loaded
+    QCheckBox *showCentrelinesCheck = new QCheckBox("Show Vein Centrelines", scrollWidget);
+    showCentrelinesCheck->setChecked(veinGraphEnabled);
+    detectionLayout->addWidget(showCentrelinesCheck);
+    connect(showCentrelinesCheck, &QCheckBox::toggled, this, [this](bool checked)
+            { veinGraphEnabled = checked; });
+
     // Confidence threshold slider
     QHBoxLayout *confidenceRow = new QHBoxLayout();
     QLabel *confidenceLabel = new QLabel("Confidence Threshold", scrollWidget);
@@ -305,6 +626,51 @@ void ControlCamera::setupUI()
         cv::Scalar color = colorCombo->itemData(index).value<cv::Scalar>();
         setBoxColor(color); });
 
+    // Tracking between detector runs
+    QCheckBox *trackingCheck = new QCheckBox("Enable Tracking", scrollWidget);
+    trackingCheck->setChecked(trackerConfig.enabled);
+    detectionLayout->addWidget(trackingCheck);
+    connect(trackingCheck, &QCheckBox::toggled, this, [this](bool enabled)
+            {
+        QMutexLocker lock(&configMutex);
+        trackerConfig.enabled = enabled; });
+
+    QHBoxLayout *intervalRow = new QHBoxLayout();
+    QLabel *intervalLabel = new QLabel("Detect Every N Frames", scrollWidget);
+    intervalLabel->setMinimumWidth(140);
+    intervalRow->addWidget(intervalLabel);
+
+    QSlider *intervalSlider = new QSlider(Qt::Horizontal, scrollWidget);
+    intervalSlider->setMinimum(1);
+    intervalSlider->setMaximum(10);
+    intervalSlider->setValue(trackerConfig.detectionInterval);
+    intervalSlider->setFixedHeight(20);
+    intervalSlider->setMinimumWidth(120);
+    intervalRow->addWidget(intervalSlider, 1);
+
+    QLabel *intervalValueLabel = new QLabel(QString::number(trackerConfig.detectionInterval), scrollWidget);
+    intervalValueLabel->setMinimumWidth(35);
+    intervalRow->addWidget(intervalValueLabel);
+
+    detectionLayout->addLayout(intervalRow);
+
+    connect(intervalSlider, &QSlider::valueChanged, this, [this, intervalValueLabel](int value)
+            {
+        {
+            QMutexLocker lock(&configMutex);
+            trackerConfig.detectionInterval = value;
+        }
+        intervalValueLabel->setText(QString::number(value)); });
+
+    // Adaptive load shedding
+    QCheckBox *loadSheddingCheck = new QCheckBox(QString("Adaptive Load Shedding (target %1 fps)").arg(loadSheddingConfig.targetFps), scrollWidget);
+    loadSheddingCheck->setChecked(loadSheddingConfig.enabled);
+    detectionLayout->addWidget(loadSheddingCheck);
+    connect(loadSheddingCheck, &QCheckBox::toggled, this, [this](bool enabled)
+            {
+        QMutexLocker lock(&configMutex);
+        loadSheddingConfig.enabled = enabled; });
+
     detectionLayout->addStretch();
     mainLayout->addWidget(detectionGroup);
 
@@ -319,7 +685,9 @@ void ControlCamera::setupUI()
     claheCheck->setChecked(veinConfig.claheEnabled);
     veinProcessingLayout->addWidget(claheCheck);
     connect(claheCheck, &QCheckBox::toggled, this, [this](bool enabled)
-            { veinConfig.claheEnabled = enabled; });
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.claheEnabled = enabled; });
 
     // CLAHE Clip Limit
     QHBoxLayout *claheClipRow = new QHBoxLayout();
@@ -343,7 +711,10 @@ void ControlCamera::setupUI()
 
     connect(claheClipSlider, &QSlider::valueChanged, this, [this, claheClipValueLabel](int value)
             {
-        veinConfig.claheClipLimit = value / 10.0;
+        {
+            QMutexLocker lock(&configMutex);
+            veinConfig.claheClipLimit = value / 10.0;
+        }
         claheClipValueLabel->setText(QString::number(veinConfig.claheClipLimit, 'f', 1)); });
 
     // Contrast Enhancement
@@ -351,7 +722,18 @@ void ControlCamera::setupUI()
     contrastCheck->setChecked(veinConfig.contrastEnabled);
     veinProcessingLayout->addWidget(contrastCheck);
     connect(contrastCheck, &QCheckBox::toggled, this, [this](bool enabled)
-            { veinConfig.contrastEnabled = enabled; });
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.contrastEnabled = enabled; });
+
+    // Per-frame stretch from the frame statistics, used while CLAHE is off
+    QCheckBox *autoContrastCheck = new QCheckBox("Auto Contrast (without CLAHE)", scrollWidget);
+    autoContrastCheck->setChecked(veinConfig.autoContrast);
+    veinProcessingLayout->addWidget(autoContrastCheck);
+    connect(autoContrastCheck, &QCheckBox::toggled, this, [this](bool enabled)
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.autoContrast = enabled; });
 
     // Contrast Alpha (gain)
     QHBoxLayout *contrastAlphaRow = new QHBoxLayout();
@@ -375,7 +757,10 @@ void ControlCamera::setupUI()
 
     connect(contrastAlphaSlider, &QSlider::valueChanged, this, [this, contrastAlphaValueLabel](int value)
             {
-        veinConfig.contrastAlpha = value / 100.0;
+        {
+            QMutexLocker lock(&configMutex);
+            veinConfig.contrastAlpha = value / 100.0;
+        }
         contrastAlphaValueLabel->setText(QString::number(veinConfig.contrastAlpha, 'f', 2)); });
 
     // Adaptive Threshold
@@ -383,25 +768,42 @@ void ControlCamera::setupUI()
     adaptiveThresholdCheck->setChecked(veinConfig.adaptiveThresholdEnabled);
     veinProcessingLayout->addWidget(adaptiveThresholdCheck);
     connect(adaptiveThresholdCheck, &QCheckBox::toggled, this, [this](bool enabled)
-            { veinConfig.adaptiveThresholdEnabled = enabled; });
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.adaptiveThresholdEnabled = enabled; });
+
+    // Temporal Denoise
+    QCheckBox *temporalCheck = new QCheckBox("Enable Temporal Denoise (replaces spatial filters)", scrollWidget);
+    temporalCheck->setChecked(veinConfig.temporalDenoiseEnabled);
+    veinProcessingLayout->addWidget(temporalCheck);
+    connect(temporalCheck, &QCheckBox::toggled, this, [this](bool enabled)
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.temporalDenoiseEnabled = enabled; });
 
     // Bilateral Filter
     QCheckBox *bilateralCheck = new QCheckBox("Enable Bilateral Filter (Noise Reduction)", scrollWidget);
     bilateralCheck->setChecked(veinConfig.bilateralFilterEnabled);
     veinProcessingLayout->addWidget(bilateralCheck);
     connect(bilateralCheck, &QCheckBox::toggled, this, [this](bool enabled)
-            { veinConfig.bilateralFilterEnabled = enabled; });
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.bilateralFilterEnabled = enabled; });
 
     // Vein Enhancement
     QCheckBox *veinEnhanceCheck = new QCheckBox("Enable Vein Enhancement", scrollWidget);
     veinEnhanceCheck->setChecked(veinConfig.veinEnhancementEnabled);
     veinProcessingLayout->addWidget(veinEnhanceCheck);
     connect(veinEnhanceCheck, &QCheckBox::toggled, this, [this](bool enabled)
-            { veinConfig.veinEnhancementEnabled = enabled; });
+            {
+        QMutexLocker lock(&configMutex);
+        veinConfig.veinEnhancementEnabled = enabled; });
 
     veinProcessingLayout->addStretch();
     mainLayout->addWidget(veinProcessingGroup);
 
+    mainLayout->addWidget(createPerformancePanel(scrollWidget));
+
     // Set the scroll widget and add scroll area to the main widget layout
     scrollArea->setWidget(scrollWidget);
     QVBoxLayout *outerLayout = new QVBoxLayout(this);
@@ -426,6 +828,198 @@ void ControlCamera::setupUI()
     setupConnections();
 }
 
+QGroupBox *ControlCamera::createPerformancePanel(QWidget *parent)
+{
+    // Collapsible: checking the group box shows the latency table
+    QGroupBox *performanceGroup = new QGroupBox("Performance (stage latency, ms)", parent);
+    performanceGroup->setCheckable(true);
+    performanceGroup->setChecked(false);
+    QVBoxLayout *performanceLayout = new QVBoxLayout(performanceGroup);
+    performanceLayout->setSpacing(8);
+    performanceLayout->setContentsMargins(10, 10, 10, 10);
+
+    QWidget *performanceContent = new QWidget(performanceGroup);
+    QVBoxLayout *contentLayout = new QVBoxLayout(performanceContent);
+    contentLayout->setContentsMargins(0, 0, 0, 0);
+
+    metricsLabel = new QLabel(performanceContent);
+    metricsLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    metricsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    contentLayout->addWidget(metricsLabel);
+
+    // Timeline tracing is shared by all cameras
+    QHBoxLayout *traceRow = new QHBoxLayout();
+    QCheckBox *traceCheck = new QCheckBox("Trace Timeline", performanceContent);
+    traceCheck->setChecked(FrameTracer::enabled());
+    traceRow->addWidget(traceCheck);
+    traceRow->addWidget(new QLabel("Save on frames over", performanceContent));
+    QSpinBox *spikeSpin = new QSpinBox(performanceContent);
+    spikeSpin->setRange(0, 1000);
+    spikeSpin->setSuffix(" ms");
+    spikeSpin->setSpecialValueText("off");
+    spikeSpin->setValue(static_cast<int>(traceTrigger.thresholdMs()));
+    traceRow->addWidget(spikeSpin);
+    QPushButton *traceButton = new QPushButton("Save Trace", performanceContent);
+    traceRow->addWidget(traceButton);
+    contentLayout->addLayout(traceRow);
+
+    connect(traceCheck, &QCheckBox::toggled, this, [](bool enabled)
+            { FrameTracer::setEnabled(enabled); });
+    connect(spikeSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int value)
+            { traceTrigger.setThresholdMs(value); });
+    connect(traceButton, &QPushButton::clicked, this, [this]()
+            { saveTrace("manual"); });
+
+    // Allocation counting is process-wide too; per-stage counts appear under the latency table
+    QCheckBox *allocationCheck = new QCheckBox("Count Allocations", performanceContent);
+    allocationCheck->setChecked(AllocationTracker::enabled());
+    contentLayout->addWidget(allocationCheck);
+    connect(allocationCheck, &QCheckBox::toggled, this, [](bool enabled)
+            { AllocationTracker::setEnabled(enabled); });
+
+    QHBoxLayout *buttonRow = new QHBoxLayout();
+    QPushButton *dumpButton = new QPushButton("Dump to Log", performanceContent);
+    QPushButton *resetButton = new QPushButton("Reset", performanceContent);
+    buttonRow->addWidget(dumpButton);
+    buttonRow->addWidget(resetButton);
+    contentLayout->addLayout(buttonRow);
+
+    performanceLayout->addWidget(performanceContent);
+    performanceContent->setVisible(false);
+
+    connect(performanceGroup, &QGroupBox::toggled, performanceContent, &QWidget::setVisible);
+    connect(dumpButton, &QPushButton::clicked, this, [this]()
+            { qInfo().noquote() << QString("Camera %1 stage latency (ms):\n").arg(deviceIndex) + metrics.formatTable() + "\n" + controlBatcher->formatTable(); });
+    connect(resetButton, &QPushButton::clicked, this, [this]()
+            {
+        metrics.reset();
+        controlBatcher->reset();
+        metricsLabel->setText(metrics.formatTable()); });
+
+    return performanceGroup;
+}
+
+QHBoxLayout *ControlCamera::createRecordingRow(QWidget *parent)
+{
+    QHBoxLayout *recordingRow = new QHBoxLayout();
+
+    QPushButton *recordButton = new QPushButton("Record Raw", parent);
+    recordButton->setCheckable(true);
+    recordingRow->addWidget(recordButton);
+    connect(recordButton, &QPushButton::toggled, this, [this, recordButton](bool checked)
+            {
+        if (!checked)
+        {
+            recorder.close();
+            recordButton->setText("Record Raw");
+            return;
+        }
+        QString defaultPath = QDir::home().filePath(QString("camera%1-%2.veinrec")
+                                                        .arg(deviceIndex)
+                                                        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+        QString path = QFileDialog::getSaveFileName(this, "Record raw frames", defaultPath, "Raw recordings (*.veinrec)");
+        if (path.isEmpty() || !startRecording(path))
+        {
+            QSignalBlocker blocker(recordButton);
+            recordButton->setChecked(false);
+            return;
+        }
+        recordButton->setText("Stop Recording"); });
+
+    // Stepped replay advances only when asked
+    ReplayFrameSource *replay = dynamic_cast<ReplayFrameSource *>(source.get());
+    if (replay && replay->mode() == ReplayFrameSource::Stepped)
+    {
+        QPushButton *stepButton = new QPushButton("Next Frame", parent);
+        recordingRow->addWidget(stepButton);
+        connect(stepButton, &QPushButton::clicked, this, [replay]()
+                { replay->step(); });
+    }
+
+    return recordingRow;
+}
+
+QHBoxLayout *ControlCamera::createRegionRow(QWidget *parent)
+{
+    QHBoxLayout *regionRow = new QHBoxLayout();
+
+    // Regions are drawn on the preview, found automatically or cleared here
+    QPushButton *autoButton = new QPushButton("Auto Region", parent);
+    QPushButton *fullButton = new QPushButton("Full Frame", parent);
+    autoButton->setToolTip("Crop to the arm; drag over the preview to choose a region by hand");
+    regionRow->addWidget(autoButton);
+    regionRow->addWidget(fullButton);
+    connect(autoButton, &QPushButton::clicked, this, [this]()
+            { autoRegionRequested = true; });
+    connect(fullButton, &QPushButton::clicked, this, [this]()
+            { source->setRegion(cv::Rect()); });
+    connect(previewWidget, &PreviewWidget::regionDrawn, this, [this](const cv::Rect &region)
+            { source->setRegion(region + presentedRegion.tl()); });
+
+    return regionRow;
+}
+
+QHBoxLayout *ControlCamera::createFlatFieldRow(QWidget *parent)
+{
+    QHBoxLayout *flatFieldRow = new QHBoxLayout();
+
+    QCheckBox *enableCheck = new QCheckBox("Flat Field", parent);
+    QPushButton *darkButton = new QPushButton("Capture Dark", parent);
+    QPushButton *flatButton = new QPushButton("Capture Flat", parent);
+    darkButton->setToolTip("Average frames with the illumination off or the lens capped");
+    flatButton->setToolTip("Average frames of a uniform diffuse target under the working illumination");
+    flatFieldRow->addWidget(enableCheck);
+    flatFieldRow->addWidget(darkButton);
+    flatFieldRow->addWidget(flatButton);
+
+    // The map is loaded before the capture thread starts and owned by it from then on
+    bool calibrated = flatField.load(flatFieldPath());
+    enableCheck->setChecked(calibrated);
+    flatFieldEnabled = calibrated;
+    connect(enableCheck, &QCheckBox::toggled, this, [this](bool checked)
+            { flatFieldEnabled = checked; });
+    connect(darkButton, &QPushButton::clicked, this, [this]()
+            { calibrationRequest = 1 + static_cast<int>(FlatFieldCalibrator::Reference::Dark); });
+    connect(flatButton, &QPushButton::clicked, this, [this, enableCheck]()
+            {
+        calibrationRequest = 1 + static_cast<int>(FlatFieldCalibrator::Reference::Flat);
+        enableCheck->setChecked(true); });
+
+    return flatFieldRow;
+}
+
+QString ControlCamera::flatFieldPath() const
+{
+    return QDir::home().filePath(QString("camera%1-flatfield.yml.gz").arg(deviceIndex));
+}
+
+void ControlCamera::saveTrace(const QString &reason)
+{
+    QString path = QDir::home().filePath(QString("trace-camera%1-%2-%3.json")
+                                             .arg(deviceIndex)
+                                             .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"))
+                                             .arg(reason));
+    FrameTracer::writeChromeTrace(path);
+}
+
+bool ControlCamera::startRecording(const QString &path)
+{
+    if (!recorder.open(path, source->name()))
+        return false;
+
+    // Start with the full control state so replay knows the settings of the first frame
+    const __u32 controlIds[] = {V4L2_CID_BRIGHTNESS, V4L2_CID_CONTRAST, V4L2_CID_SATURATION, V4L2_CID_HUE,
+                                V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CID_GAMMA, V4L2_CID_POWER_LINE_FREQUENCY,
+                                V4L2_CID_SHARPNESS, V4L2_CID_BACKLIGHT_COMPENSATION, V4L2_CID_EXPOSURE_AUTO,
+                                V4L2_CID_EXPOSURE_ABSOLUTE, V4L2_CID_GAIN};
+    for (__u32 id : controlIds)
+    {
+        if (controlCache->contains(id))
+            recorder.appendControl(id, static_cast<int32_t>(controlCache->value(id)));
+    }
+    return true;
+}
+
 void ControlCamera::setupConnections()
 {
     connect(brightnessSlider, &QSlider::valueChanged, this, [this](int val)
@@ -462,12 +1056,11 @@ void ControlCamera::setupConnections()
             {
             if (autoExposureCombo->isEnabled()) {
                 int val = autoExposureCombo->itemData(idx).toInt();
-                setControl(V4L2_CID_EXPOSURE_AUTO, val);
-                updateControlStates(); // Always update enabled/disabled after changing exposure mode.
+                setControl(V4L2_CID_EXPOSURE_AUTO, val); // Control states refresh once it is applied
             } });
 }
 
-// Query the V4L2 controls for dynamic setup
+// Set up the widgets from the cached V4L2 controls
 void ControlCamera::setupControlsFromV4L2()
 {
     struct
@@ -484,99 +1077,151 @@ void ControlCamera::setupControlsFromV4L2()
         {V4L2_CID_BACKLIGHT_COMPENSATION, backlightCompSlider}};
     for (const auto &ctl : sliders)
     {
-        v4l2_queryctrl qctrl = {};
-        if (ioctlQueryControl(ctl.id, qctrl))
+        CachedControl info;
+        if (controlCache->control(ctl.id, info))
         {
-            ctl.slider->setRange(qctrl.minimum, qctrl.maximum);
-            ctl.slider->setSingleStep(qctrl.step);
-            ctl.slider->setPageStep((qctrl.maximum - qctrl.minimum) / 10 > 0 ? (qctrl.maximum - qctrl.minimum) / 10 : 1);
+            QSignalBlocker blocker(ctl.slider);
+            ctl.slider->setRange(static_cast<int>(info.minimum), static_cast<int>(info.maximum));
+            ctl.slider->setSingleStep(static_cast<int>(info.step));
+            ctl.slider->setPageStep((info.maximum - info.minimum) / 10 > 0 ? static_cast<int>((info.maximum - info.minimum) / 10) : 1);
         }
     }
-    // Power Line Frequency
-    powerLineFreqCombo->clear();
-    v4l2_queryctrl powerCtrl = {};
-    if (ioctlQueryControl(V4L2_CID_POWER_LINE_FREQUENCY, powerCtrl))
+
+    // Menus list only the entries the driver offers, with its names when it has them
+    struct
     {
-        for (int i = powerCtrl.minimum; i <= powerCtrl.maximum; ++i)
+        __u32 id;
+        QComboBox *combo;
+        QString (*fallbackName)(int);
+    } menus[] = {
+        {V4L2_CID_POWER_LINE_FREQUENCY, powerLineFreqCombo, [](int i) -> QString
+         {
+             switch (i)
+             {
+             case 0:
+                 return "Disabled";
+             case 1:
+                 return "50Hz";
+             case 2:
+                 return "60Hz";
+             default:
+                 return QString("Option %1").arg(i);
+             }
+         }},
+        {V4L2_CID_EXPOSURE_AUTO, autoExposureCombo, [](int i) -> QString
+         {
+             switch (i)
+             {
+             case 1:
+                 return "Manual Mode";
+             case 2:
+                 return "Shutter Priority";
+             case 3:
+                 return "Aperture Priority";
+             case 0:
+                 return "Auto Mode";
+             default:
+                 return QString("Mode %1").arg(i);
+             }
+         }}};
+    for (const auto &ctl : menus)
+    {
+        QSignalBlocker blocker(ctl.combo);
+        ctl.combo->clear();
+        CachedControl info;
+        if (!controlCache->control(ctl.id, info))
+            continue;
+        if (info.menu.empty())
         {
-            QString name;
-            switch (i)
-            {
-            case 0:
-                name = "Disabled";
-                break;
-            case 1:
-                name = "50Hz";
-                break;
-            case 2:
-                name = "60Hz";
-                break;
-            default:
-                name = QString("Option %1").arg(i);
-                break;
-            }
-            powerLineFreqCombo->addItem(name, i);
+            for (int64_t i = info.minimum; i <= info.maximum; ++i)
+                ctl.combo->addItem(ctl.fallbackName(static_cast<int>(i)), static_cast<int>(i));
         }
+        for (const auto &[index, label] : info.menu)
+            ctl.combo->addItem(label.isEmpty() ? ctl.fallbackName(static_cast<int>(index)) : label, static_cast<int>(index));
+    }
+}
+
+void ControlCamera::loadInitialControlValues()
+{
+    // From the cache, with signals blocked: the device already has these values
+    const __u32 controlIds[] = {V4L2_CID_BRIGHTNESS, V4L2_CID_CONTRAST, V4L2_CID_SATURATION, V4L2_CID_HUE,
+                                V4L2_CID_GAMMA, V4L2_CID_SHARPNESS, V4L2_CID_BACKLIGHT_COMPENSATION,
+                                V4L2_CID_AUTO_WHITE_BALANCE, V4L2_CID_POWER_LINE_FREQUENCY, V4L2_CID_EXPOSURE_AUTO};
+    for (__u32 id : controlIds)
+        syncControlWidget(id);
+}
+
+void ControlCamera::syncControlWidget(__u32 id)
+{
+    CachedControl info;
+    if (!controlCache->control(id, info))
+        return;
+    int value = static_cast<int>(info.value);
+
+    QSlider *slider = nullptr;
+    QComboBox *combo = nullptr;
+    switch (id)
+    {
+    case V4L2_CID_BRIGHTNESS:
+        slider = brightnessSlider;
+        break;
+    case V4L2_CID_CONTRAST:
+        slider = contrastSlider;
+        break;
+    case V4L2_CID_SATURATION:
+        slider = saturationSlider;
+        break;
+    case V4L2_CID_HUE:
+        slider = hueSlider;
+        break;
+    case V4L2_CID_GAMMA:
+        slider = gammaSlider;
+        break;
+    case V4L2_CID_SHARPNESS:
+        slider = sharpnessSlider;
+        break;
+    case V4L2_CID_BACKLIGHT_COMPENSATION:
+        slider = backlightCompSlider;
+        break;
+    case V4L2_CID_POWER_LINE_FREQUENCY:
+        combo = powerLineFreqCombo;
+        break;
+    case V4L2_CID_EXPOSURE_AUTO:
+        combo = autoExposureCombo;
+        break;
+    case V4L2_CID_AUTO_WHITE_BALANCE:
+    {
+        QSignalBlocker blocker(wbAutoCheck);
+        wbAutoCheck->setChecked(value != 0);
+        return;
+    }
+    default:
+        return;
+    }
+
+    if (slider && !slider->isSliderDown())
+    {
+        QSignalBlocker blocker(slider);
+        slider->setValue(value);
     }
-    // Exposure
-    autoExposureCombo->clear();
-    v4l2_queryctrl exCtrl = {};
-    if (ioctlQueryControl(V4L2_CID_EXPOSURE_AUTO, exCtrl))
+    if (combo)
     {
-        for (int i = exCtrl.minimum; i <= exCtrl.maximum; ++i)
+        int idx = combo->findData(value);
+        if (idx >= 0)
         {
-            QString name;
-            switch (i)
-            {
-            case 1:
-                name = "Manual Mode";
-                break;
-            case 2:
-                name = "Shutter Priority";
-                break;
-            case 3:
-                name = "Aperture Priority";
-                break;
-            case 0:
-                name = "Auto Mode";
-                break;
-            default:
-                name = QString("Mode %1").arg(i);
-                break;
-            }
-            autoExposureCombo->addItem(name, i);
+            QSignalBlocker blocker(combo);
+            combo->setCurrentIndex(idx);
         }
     }
 }
 
-void ControlCamera::loadInitialControlValues()
+void ControlCamera::onControlChanged(uint32_t id, uint32_t changes)
 {
-    if (brightnessSlider)
-        brightnessSlider->setValue(getControl(V4L2_CID_BRIGHTNESS));
-    if (contrastSlider)
-        contrastSlider->setValue(getControl(V4L2_CID_CONTRAST));
-    if (saturationSlider)
-        saturationSlider->setValue(getControl(V4L2_CID_SATURATION));
-    if (hueSlider)
-        hueSlider->setValue(getControl(V4L2_CID_HUE));
-    if (gammaSlider)
-        gammaSlider->setValue(getControl(V4L2_CID_GAMMA));
-    if (sharpnessSlider)
-        sharpnessSlider->setValue(getControl(V4L2_CID_SHARPNESS));
-    if (backlightCompSlider)
-        backlightCompSlider->setValue(getControl(V4L2_CID_BACKLIGHT_COMPENSATION));
-    if (wbAutoCheck)
-        wbAutoCheck->setChecked(getControl(V4L2_CID_AUTO_WHITE_BALANCE) != 0);
-
-    int plfVal = getControl(V4L2_CID_POWER_LINE_FREQUENCY);
-    int idx = powerLineFreqCombo->findData(plfVal);
-    if (idx >= 0)
-        powerLineFreqCombo->setCurrentIndex(idx);
-
-    int exVal = getControl(V4L2_CID_EXPOSURE_AUTO);
-    int idx2 = autoExposureCombo->findData(exVal);
-    if (idx2 >= 0)
-        autoExposureCombo->setCurrentIndex(idx2);
+    if (changes & (V4L2_EVENT_CTRL_CH_FLAGS | V4L2_EVENT_CTRL_CH_RANGE))
+        updateControlStates();
+    // Echoes of our own writes are skipped while a newer value is still queued
+    if ((changes & V4L2_EVENT_CTRL_CH_VALUE) && !controlBatcher->hasPending(id))
+        syncControlWidget(id);
 }
 
 void ControlCamera::updateControlStates()
@@ -598,8 +1243,8 @@ void ControlCamera::updateControlStates()
         {V4L2_CID_EXPOSURE_AUTO, autoExposureCombo}};
     for (const auto &info : infos)
     {
-        v4l2_queryctrl qctrl = {};
-        bool active = ioctlQueryControl(info.id, qctrl) && !(qctrl.flags & V4L2_CTRL_FLAG_INACTIVE);
+        CachedControl control;
+        bool active = controlCache->control(info.id, control) && control.isActive();
         info.widget->setEnabled(active);
     }
 }
@@ -651,42 +1296,76 @@ void ControlCamera::loadConfiguration()
     QString group = QString("Camera%1").arg(deviceIndex);
     settings.beginGroup(group);
 
-    if (settings.contains("Brightness"))
-        brightnessSlider->setValue(settings.value("Brightness").toInt());
-    if (settings.contains("Contrast"))
-        contrastSlider->setValue(settings.value("Contrast").toInt());
-    if (settings.contains("Saturation"))
-        saturationSlider->setValue(settings.value("Saturation").toInt());
-    if (settings.contains("Hue"))
-        hueSlider->setValue(settings.value("Hue").toInt());
+    // Saved values form one profile written in a single ioctl; the widgets are
+    // updated with signals blocked so they do not queue each control again
+    std::map<uint32_t, int32_t> profile;
+    struct
+    {
+        const char *key;
+        __u32 id;
+        QSlider *slider;
+    } sliders[] = {
+        {"Brightness", V4L2_CID_BRIGHTNESS, brightnessSlider},
+        {"Contrast", V4L2_CID_CONTRAST, contrastSlider},
+        {"Saturation", V4L2_CID_SATURATION, saturationSlider},
+        {"Hue", V4L2_CID_HUE, hueSlider},
+        {"Gamma", V4L2_CID_GAMMA, gammaSlider},
+        {"Sharpness", V4L2_CID_SHARPNESS, sharpnessSlider},
+        {"BacklightCompensation", V4L2_CID_BACKLIGHT_COMPENSATION, backlightCompSlider}};
+    for (const auto &ctl : sliders)
+    {
+        if (!settings.contains(ctl.key))
+            continue;
+        QSignalBlocker blocker(ctl.slider);
+        ctl.slider->setValue(settings.value(ctl.key).toInt());
+        if (ctl.slider->isEnabled())
+            profile[ctl.id] = ctl.slider->value();
+    }
+
     if (settings.contains("WhiteBalanceAuto"))
-        wbAutoCheck->setChecked(settings.value("WhiteBalanceAuto").toBool());
-    if (settings.contains("Gamma"))
-        gammaSlider->setValue(settings.value("Gamma").toInt());
-    if (settings.contains("PowerLineFrequency"))
     {
-        int val = settings.value("PowerLineFrequency").toInt();
-        int idx = powerLineFreqCombo->findData(val);
-        if (idx != -1)
-            powerLineFreqCombo->setCurrentIndex(idx);
+        QSignalBlocker blocker(wbAutoCheck);
+        wbAutoCheck->setChecked(settings.value("WhiteBalanceAuto").toBool());
+        if (wbAutoCheck->isEnabled())
+            profile[V4L2_CID_AUTO_WHITE_BALANCE] = wbAutoCheck->isChecked() ? 1 : 0;
     }
-    if (settings.contains("Sharpness"))
-        sharpnessSlider->setValue(settings.value("Sharpness").toInt());
-    if (settings.contains("BacklightCompensation"))
-        backlightCompSlider->setValue(settings.value("BacklightCompensation").toInt());
-    if (settings.contains("ExposureMode"))
+
+    struct
+    {
+        const char *key;
+        __u32 id;
+        QComboBox *combo;
+    } combos[] = {
+        {"PowerLineFrequency", V4L2_CID_POWER_LINE_FREQUENCY, powerLineFreqCombo},
+        {"ExposureMode", V4L2_CID_EXPOSURE_AUTO, autoExposureCombo}};
+    for (const auto &ctl : combos)
     {
-        int val = settings.value("ExposureMode").toInt();
-        int idx = autoExposureCombo->findData(val);
-        if (idx != -1)
-            autoExposureCombo->setCurrentIndex(idx);
+        if (!settings.contains(ctl.key))
+            continue;
+        int idx = ctl.combo->findData(settings.value(ctl.key).toInt());
+        if (idx == -1)
+            continue;
+        QSignalBlocker blocker(ctl.combo);
+        ctl.combo->setCurrentIndex(idx);
+        if (ctl.combo->isEnabled())
+            profile[ctl.id] = ctl.combo->itemData(idx).toInt();
     }
 
     settings.endGroup();
+    applyControlProfile(profile);
+}
+
+bool ControlCamera::applyControlProfile(const std::map<uint32_t, int32_t> &profile)
+{
+    if (fd < 0 || profile.empty())
+        return false;
+    return controlBatcher->apply(profile);
 }
 
 bool ControlCamera::loadVeinModel(const std::string &modelPath)
 {
+    pybind11::gil_scoped_acquire gil;
+
     try
     {
         // Check if file exists first
@@ -771,6 +1450,7 @@ bool ControlCamera::loadClassNames(const std::string &classPath)
 
 void ControlCamera::enableVeinDetection(bool enable)
 {
+    QMutexLocker lock(&configMutex);
     veinDetectionEnabled = enable; // Allow detection even without model for testing
     if (enable && !modelLoaded)
     {
@@ -778,63 +1458,48 @@ void ControlCamera::enableVeinDetection(bool enable)
     }
 }
 
-cv::Mat ControlCamera::processFrameWithModel(const cv::Mat &inputFrame)
+void ControlCamera::processFrameWithModel(const cv::Mat &inputFrame, std::vector<Detection> &detections)
 {
-    if (!veinDetectionEnabled)
-    {
-        return inputFrame; // Return original if detection disabled
-    }
-
     try
     {
-        // Create a clean copy of the original frame to preserve colors
-        cv::Mat processedFrame = inputFrame.clone();
-
-        // Ensure we're working with BGR format (OpenCV default)
-        if (processedFrame.channels() != 3)
-        {
-            cv::cvtColor(processedFrame, processedFrame, cv::COLOR_GRAY2BGR);
-        }
-
         // Run detection on the frame (works with or without model)
-        std::vector<Detection> detections = runDetection(inputFrame);
-
-        // Draw detections on the clean frame copy
-        processedFrame = drawDetections(processedFrame, detections);
-
-        return processedFrame;
+        detections = runDetection(inputFrame);
     }
     catch (const std::exception &e)
     {
         qWarning() << "Error during frame processing:" << e.what();
-        return inputFrame; // Return original frame on error
+        detections.clear();
     }
 }
 
 std::vector<Detection> ControlCamera::runDetection(const cv::Mat &inputFrame)
 {
     std::vector<Detection> detections;
+    veinGraph.clear();
 
     // If model is not loaded, use vein processing instead of test detections
     if (!modelLoaded)
     {
-        // Apply vein processing to enhance veins
-        cv::Mat processedFrame = processVeinFrame(inputFrame);
-
-        // Get binary frame for contour detection
-        cv::Mat binaryFrame = getVeinBinaryFrame(inputFrame);
+        // Get binary frame for contour detection. The chain runs once per frame:
+        // the temporal denoiser keeps state and must see each frame exactly once.
+        cv::Mat binaryFrame = veinProcessor.getVeinBinaryFrame(inputFrame);
+        loadController.recordScene(veinProcessor.statistics());
+        updateExposure(veinProcessor.statistics());
 
         // Find vein regions in the binary frame
-        detections = findVeinRegions(binaryFrame);
+        detections = veinProcessor.findVeinRegions(binaryFrame, detectionThreshold);
+
+        // Centrelines come from the same binary frame
+        if (veinGraphEnabled.load(std::memory_order_relaxed))
+            veinProcessor.extractVeinGraph(binaryFrame, veinGraph);
 
         return detections;
     }
 
     try
     {
-        // Use OpenCV DNN for detection
-        cv::Mat inputClone = inputFrame.clone();
-        detectWithPython(inputClone, detections);
+        // The numpy array copies from the frame using its own strides, no clone needed
+        detectWithPython(inputFrame, detections);
     }
     catch (const std::exception &e)
     {
@@ -861,13 +1526,35 @@ void ControlCamera::detectWithPython(const cv::Mat &image, std::vector<Detection
     if (!modelLoaded)
         return;
 
+    // Called on the capture thread; the main thread released the GIL at startup
+    auto gilWaitStart = FrameTracer::Clock::now();
+    pybind11::gil_scoped_acquire gil;
+    if (FrameTracer::enabled())
+        FrameTracer::record("gil wait", gilWaitStart, FrameTracer::Clock::now());
+    TraceScope pythonScope("detectWithPython");
+
     try
     {
+        // The model takes 8-bit BGR; deep NIR frames are reduced and corrected
+        // luma expanded at its input
+        const cv::Mat *input = &image;
+        if (image.channels() == 1)
+        {
+            const cv::Mat *gray = &image;
+            if (image.depth() == CV_16U)
+            {
+                image.convertTo(modelGray, CV_8U, 1.0 / 257.0);
+                gray = &modelGray;
+            }
+            cv::cvtColor(*gray, modelInput, cv::COLOR_GRAY2BGR);
+            input = &modelInput;
+        }
+
         // Convert OpenCV Mat to numpy array for Python
         pybind11::array_t<uint8_t> np_array = pybind11::array_t<uint8_t>(
-            {image.rows, image.cols, image.channels()},
-            {sizeof(uint8_t) * image.cols * image.channels(), sizeof(uint8_t) * image.channels(), sizeof(uint8_t)},
-            image.data);
+            {input->rows, input->cols, input->channels()},
+            {input->step[0], input->step[1], sizeof(uint8_t)},
+            input->data);
 
         // Call Python detection function
         auto result = yolo_module.attr("detect_veins")(np_array, CONFIDENCE_THRESHOLD);
@@ -910,22 +1597,21 @@ void ControlCamera::detectWithPython(const cv::Mat &image, std::vector<Detection
     }
 }
 
-cv::Mat ControlCamera::drawDetections(const cv::Mat &frame, const std::vector<Detection> &detections)
+void ControlCamera::drawDetections(DetectionOverlay &overlay, const std::vector<Detection> &detections, const VeinGraph &graph,
+                                   const cv::Point &origin)
 {
-    // Ensure we work with a BGR frame for consistent color handling
-    cv::Mat result;
-    if (frame.channels() == 1)
-    {
-        cv::cvtColor(frame, result, cv::COLOR_GRAY2BGR);
-    }
-    else
-    {
-        result = frame.clone();
-    }
+    StageTimer timer(&metrics, PipelineStage::Drawing);
+    overlay.clear();
+    overlay.setLabelMode(visualConfig.showLabels, visualConfig.showConfidence);
+    overlay.setLineWidth(visualConfig.boxThickness);
+    overlay.setFontScale(visualConfig.fontScale);
+    overlay.setColors(QColor(visualConfig.boxColor[2], visualConfig.boxColor[1], visualConfig.boxColor[0]),
+                      QColor(visualConfig.textColor[2], visualConfig.textColor[1], visualConfig.textColor[0]));
 
     // Find the detection with highest confidence
     float maxConfidence = -1.0f;
     int bestDetectionIndex = -1;
+    int previousBestIndex = -1;
 
     for (size_t i = 0; i < detections.size(); i++)
     {
@@ -934,137 +1620,51 @@ cv::Mat ControlCamera::drawDetections(const cv::Mat &frame, const std::vector<De
             maxConfidence = detections[i].confidence;
             bestDetectionIndex = static_cast<int>(i);
         }
-    }
-
-    for (size_t i = 0; i < detections.size(); i++)
-    {
-        const auto &detection = detections[i];
-        bool isHighestConfidence = (static_cast<int>(i) == bestDetectionIndex);
-
-        // Calculate center point of detection
-        cv::Point center(
-            detection.boundingBox.x + detection.boundingBox.width / 2,
-            detection.boundingBox.y + detection.boundingBox.height / 2);
-
-        // Draw cross-hair or point instead of bounding box
-        drawCrosshair(result, detection, center, isHighestConfidence);
-
-        // Draw label with confidence
-        if (visualConfig.showLabels || visualConfig.showConfidence)
+        if (detections[i].trackId >= 0 && detections[i].trackId == bestTrackId)
         {
-            cv::Point labelPos(center.x + 15, center.y - 15);
-            drawLabel(result, detection, labelPos, isHighestConfidence);
+            previousBestIndex = static_cast<int>(i);
         }
     }
 
-    // Print highest confidence detection info
-    if (bestDetectionIndex >= 0)
+    // Keep the previous best track unless another one is clearly better
+    const float BEST_HYSTERESIS = 0.1f;
+    if (previousBestIndex >= 0 && detections[previousBestIndex].confidence + BEST_HYSTERESIS >= maxConfidence)
     {
-        const auto &bestDetection = detections[bestDetectionIndex];
-        qDebug() << "Highest confidence detection:"
-                 << QString::fromStdString(bestDetection.className)
-                 << "with confidence:" << bestDetection.confidence;
+        bestDetectionIndex = previousBestIndex;
     }
+    bestTrackId = bestDetectionIndex >= 0 ? detections[bestDetectionIndex].trackId : -1;
 
-    return result;
-}
-
-void ControlCamera::drawCrosshair(cv::Mat &frame, const Detection &detection, const cv::Point &center, bool isHighestConfidence)
-{
-    // Use only green colors - no color selection options
-    // Using BGR format: (Blue, Green, Red)
-    cv::Scalar crossColor = isHighestConfidence ? cv::Scalar(0, 255, 100) : cv::Scalar(0, 255, 0);  // Bright green for highest, normal green for others
-    cv::Scalar circleColor = isHighestConfidence ? cv::Scalar(0, 255, 200) : cv::Scalar(0, 200, 0); // Light green for highest, dark green for others
-
-    int thickness = isHighestConfidence ? visualConfig.boxThickness + 1 : visualConfig.boxThickness;
-    int crossSize = isHighestConfidence ? 25 : 20;  // Larger cross for highest confidence
-    int circleRadius = isHighestConfidence ? 8 : 5; // Larger circle for highest confidence
-
-    // Ensure center is within frame bounds
-    if (center.x < 0 || center.x >= frame.cols || center.y < 0 || center.y >= frame.rows)
-        return;
-
-    // Draw crosshair - horizontal line
-    cv::Point leftPoint(std::max(0, center.x - crossSize), center.y);
-    cv::Point rightPoint(std::min(frame.cols - 1, center.x + crossSize), center.y);
-    cv::line(frame, leftPoint, rightPoint, crossColor, thickness);
-
-    // Draw crosshair - vertical line
-    cv::Point topPoint(center.x, std::max(0, center.y - crossSize));
-    cv::Point bottomPoint(center.x, std::min(frame.rows - 1, center.y + crossSize));
-    cv::line(frame, topPoint, bottomPoint, crossColor, thickness);
-
-    // Draw center circle
-    cv::circle(frame, center, circleRadius, circleColor, -1); // Filled circle
-
-    // Draw outer ring for highest confidence detection
-    if (isHighestConfidence)
+    for (size_t i = 0; i < detections.size(); i++)
     {
-        cv::circle(frame, center, circleRadius + 3, cv::Scalar(255, 255, 255), 2); // White outer ring
-    }
-}
-
-void ControlCamera::drawLabel(cv::Mat &frame, const Detection &detection, const cv::Point &position, bool isHighestConfidence)
-{
-    std::string labelText;
+        const auto &detection = detections[i];
+        bool isHighestConfidence = (static_cast<int>(i) == bestDetectionIndex);
 
-    // Build label text
-    if (visualConfig.showLabels && visualConfig.showConfidence)
-    {
-        labelText = detection.className + ": " + std::to_string(static_cast<int>(detection.confidence * 100)) + "%";
-        if (isHighestConfidence)
-        {
-            labelText = "[BEST] " + labelText; // Mark the highest confidence
-        }
+        // Crosshair at the center of the detection, in frame coordinates
+        QPointF center(detection.boundingBox.x - origin.x + detection.boundingBox.width * 0.5,
+                       detection.boundingBox.y - origin.y + detection.boundingBox.height * 0.5);
+        overlay.addMarker(center, isHighestConfidence, detection.classId, detection.className, detection.confidence);
     }
-    else if (visualConfig.showLabels)
+
+    // Centrelines through pixel centres, and the junctions where veins branch
+    for (const VeinSegment &segment : graph.segments)
     {
-        labelText = detection.className;
-        if (isHighestConfidence)
-        {
-            labelText = "[BEST] " + labelText;
-        }
+        QPolygonF line;
+        line.reserve(static_cast<int>(segment.points.size()));
+        for (const cv::Point &point : segment.points)
+            line.append(QPointF(point.x - origin.x + 0.5, point.y - origin.y + 0.5));
+        overlay.addCentreline(line);
     }
-    else if (visualConfig.showConfidence)
+    for (const VeinJunction &junction : graph.junctions)
     {
-        labelText = std::to_string(static_cast<int>(detection.confidence * 100)) + "%";
-        if (isHighestConfidence)
-        {
-            labelText = "[BEST] " + labelText;
-        }
-    }
-
-    if (!labelText.empty())
-    {
-        // Choose colors based on whether this is the highest confidence detection
-        cv::Scalar bgColor = isHighestConfidence ? cv::Scalar(0, 0, 255) : visualConfig.boxColor;        // Red bg for highest
-        cv::Scalar textColor = isHighestConfidence ? cv::Scalar(255, 255, 255) : visualConfig.textColor; // White text for highest
-        float fontScale = isHighestConfidence ? visualConfig.fontScale * 1.2f : visualConfig.fontScale;  // Larger text for highest
-
-        // Get text size for background rectangle
-        int baseline = 0;
-        cv::Size textSize = cv::getTextSize(labelText, cv::FONT_HERSHEY_SIMPLEX,
-                                            fontScale, 1, &baseline);
-
-        // Draw background rectangle for better text visibility
-        cv::Rect textBackground(position.x, position.y - textSize.height - 5,
-                                textSize.width + 10, textSize.height + 10);
-
-        // Ensure text background is within frame bounds
-        textBackground = textBackground & cv::Rect(0, 0, frame.cols, frame.rows);
-
-        cv::rectangle(frame, textBackground, bgColor, -1); // Filled rectangle
-
-        // Draw text
-        cv::Point textPos(position.x + 5, position.y - 5);
-        cv::putText(frame, labelText, textPos, cv::FONT_HERSHEY_SIMPLEX,
-                    fontScale, textColor, 1, cv::LINE_AA);
+        if (junction.degree >= 3)
+            overlay.addJunction(QPointF(junction.position.x - origin.x + 0.5, junction.position.y - origin.y + 0.5));
     }
 }
 
 // Visualization configuration methods
 void ControlCamera::setVisualizationConfig(const VisualizationConfig &config)
 {
+    QMutexLocker lock(&configMutex);
     visualConfig = config;
 }
 
@@ -1075,6 +1675,7 @@ VisualizationConfig ControlCamera::getVisualizationConfig() const
 
 void ControlCamera::setConfidenceThreshold(float threshold)
 {
+    QMutexLocker lock(&configMutex);
     visualConfig.confidenceThreshold = std::max(0.0f, std::min(1.0f, threshold));
 }
 
@@ -1108,6 +1709,7 @@ void ControlCamera::showConfidence(bool show)
 // Vein processing configuration methods
 void ControlCamera::setVeinProcessingConfig(const VeinProcessingConfig &config)
 {
+    QMutexLocker lock(&configMutex);
     veinConfig = config;
 }
 
@@ -1115,365 +1717,3 @@ VeinProcessingConfig ControlCamera::getVeinProcessingConfig() const
 {
     return veinConfig;
 }
-
-// Vein processing methods based on Python VeinProcessor
-cv::Mat ControlCamera::processVeinFrame(const cv::Mat &inputFrame)
-{
-    if (inputFrame.empty())
-    {
-        qWarning() << "Empty frame provided to vein processor";
-        return inputFrame;
-    }
-
-    try
-    {
-        cv::Mat processed = inputFrame.clone();
-        cv::Mat gray;
-
-        // Convert to grayscale if needed
-        if (processed.channels() == 3)
-        {
-            cv::cvtColor(processed, gray, cv::COLOR_BGR2GRAY);
-        }
-        else
-        {
-            gray = processed.clone();
-        }
-
-        // Apply filters based on configuration
-        if (veinConfig.medianFilterEnabled)
-        {
-            gray = applyMedianFilter(gray);
-        }
-
-        if (veinConfig.gaussianFilterEnabled)
-        {
-            gray = applyGaussianFilter(gray);
-        }
-
-        if (veinConfig.bilateralFilterEnabled)
-        {
-            gray = applyBilateralFilter(gray);
-        }
-
-        if (veinConfig.claheEnabled)
-        {
-            gray = applyCLAHE(gray);
-        }
-
-        if (veinConfig.contrastEnabled)
-        {
-            gray = applyContrastEnhancement(gray);
-        }
-
-        // Apply vein enhancement (simple edge detection as fallback for Frangi filter)
-        cv::Mat enhanced = applyVeinEnhancement(gray, gray);
-
-        // Apply adaptive thresholding if enabled
-        cv::Mat binary;
-        if (veinConfig.adaptiveThresholdEnabled)
-        {
-            binary = applyAdaptiveThreshold(enhanced);
-
-            if (veinConfig.morphologyEnabled)
-            {
-                binary = applyMorphology(binary);
-            }
-        }
-
-        // Create colored visualization with veins highlighted
-        if (processed.channels() == 3)
-        {
-            cv::Mat result = processed.clone();
-
-            if (!binary.empty())
-            {
-                // Create blue mask for veins
-                cv::Mat blueMask = cv::Mat::zeros(result.size(), result.type());
-                std::vector<cv::Mat> channels(3);
-                cv::split(blueMask, channels);
-                channels[0] = binary; // Blue channel
-                cv::merge(channels, blueMask);
-
-                // Blend with original
-                cv::addWeighted(result, 1.0, blueMask, veinConfig.enhancementAlpha, 0, result);
-            }
-            else
-            {
-                // Use enhanced grayscale for all channels with blue emphasis
-                std::vector<cv::Mat> channels(3);
-                cv::split(result, channels);
-                cv::addWeighted(channels[0], 0.5, enhanced, 0.5, 0, channels[0]); // Blue
-                cv::addWeighted(channels[1], 0.7, enhanced, 0.3, 0, channels[1]); // Green
-                cv::addWeighted(channels[2], 0.9, enhanced, 0.1, 0, channels[2]); // Red
-                cv::merge(channels, result);
-            }
-
-            return result;
-        }
-        else
-        {
-            return enhanced;
-        }
-    }
-    catch (const std::exception &e)
-    {
-        qWarning() << "Error in vein processing:" << e.what();
-        return inputFrame;
-    }
-}
-
-cv::Mat ControlCamera::getVeinBinaryFrame(const cv::Mat &inputFrame)
-{
-    if (inputFrame.empty())
-    {
-        qWarning() << "Empty frame provided to vein binary processor";
-        return cv::Mat();
-    }
-
-    try
-    {
-        cv::Mat gray;
-
-        // Convert to grayscale if needed
-        if (inputFrame.channels() == 3)
-        {
-            cv::cvtColor(inputFrame, gray, cv::COLOR_BGR2GRAY);
-        }
-        else
-        {
-            gray = inputFrame.clone();
-        }
-
-        // Apply filters based on configuration
-        if (veinConfig.medianFilterEnabled)
-        {
-            gray = applyMedianFilter(gray);
-        }
-
-        if (veinConfig.gaussianFilterEnabled)
-        {
-            gray = applyGaussianFilter(gray);
-        }
-
-        if (veinConfig.bilateralFilterEnabled)
-        {
-            gray = applyBilateralFilter(gray);
-        }
-
-        if (veinConfig.claheEnabled)
-        {
-            gray = applyCLAHE(gray);
-        }
-
-        if (veinConfig.contrastEnabled)
-        {
-            gray = applyContrastEnhancement(gray);
-        }
-
-        // Apply vein enhancement (simple edge detection as fallback for Frangi filter)
-        cv::Mat enhanced = applyVeinEnhancement(gray, gray);
-
-        // Apply adaptive thresholding to get binary image
-        cv::Mat binary;
-        if (veinConfig.adaptiveThresholdEnabled)
-        {
-            binary = applyAdaptiveThreshold(enhanced);
-
-            if (veinConfig.morphologyEnabled)
-            {
-                binary = applyMorphology(binary);
-            }
-        }
-        else
-        {
-            // Simple threshold as fallback
-            cv::threshold(enhanced, binary, 128, 255, cv::THRESH_BINARY);
-        }
-
-        return binary;
-    }
-    catch (const std::exception &e)
-    {
-        qWarning() << "Error in vein binary processing:" << e.what();
-        return cv::Mat();
-    }
-}
-
-cv::Mat ControlCamera::applyMedianFilter(const cv::Mat &frame)
-{
-    cv::Mat result;
-    int kernelSize = veinConfig.medianKernelSize;
-    // Ensure kernel size is odd
-    if (kernelSize % 2 == 0)
-        kernelSize++;
-    cv::medianBlur(frame, result, kernelSize);
-    return result;
-}
-
-cv::Mat ControlCamera::applyGaussianFilter(const cv::Mat &frame)
-{
-    cv::Mat result;
-    int kernelSize = veinConfig.gaussianKernelSize;
-    // Ensure kernel size is odd
-    if (kernelSize % 2 == 0)
-        kernelSize++;
-    cv::GaussianBlur(frame, result, cv::Size(kernelSize, kernelSize), veinConfig.gaussianSigma);
-    return result;
-}
-
-cv::Mat ControlCamera::applyBilateralFilter(const cv::Mat &frame)
-{
-    cv::Mat result;
-    cv::bilateralFilter(frame, result, veinConfig.bilateralDiameter,
-                        veinConfig.bilateralSigmaColor, veinConfig.bilateralSigmaSpace);
-    return result;
-}
-
-cv::Mat ControlCamera::applyCLAHE(const cv::Mat &frame)
-{
-    cv::Mat result;
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(
-        veinConfig.claheClipLimit,
-        cv::Size(veinConfig.claheTileGridSizeX, veinConfig.claheTileGridSizeY));
-    clahe->apply(frame, result);
-    return result;
-}
-
-cv::Mat ControlCamera::applyContrastEnhancement(const cv::Mat &frame)
-{
-    cv::Mat result;
-    frame.convertTo(result, -1, veinConfig.contrastAlpha, veinConfig.contrastBeta);
-    return result;
-}
-
-cv::Mat ControlCamera::applyAdaptiveThreshold(const cv::Mat &frame)
-{
-    cv::Mat result;
-    int blockSize = veinConfig.adaptiveBlockSize;
-    // Ensure block size is odd
-    if (blockSize % 2 == 0)
-        blockSize++;
-
-    cv::adaptiveThreshold(frame, result, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
-                          cv::THRESH_BINARY_INV, blockSize, veinConfig.adaptiveCValue);
-    return result;
-}
-
-cv::Mat ControlCamera::applyMorphology(const cv::Mat &frame)
-{
-    cv::Mat result;
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT,
-                                               cv::Size(veinConfig.morphologyKernelSize, veinConfig.morphologyKernelSize));
-    cv::morphologyEx(frame, result, veinConfig.morphologyOperation, kernel);
-    return result;
-}
-
-cv::Mat ControlCamera::applyVeinEnhancement(const cv::Mat &frame, const cv::Mat &enhanced)
-{
-    cv::Mat result;
-
-    // Simple edge detection as a fallback for Frangi filter
-    cv::Mat laplacian;
-    cv::Laplacian(frame, laplacian, CV_8U, 3);
-
-    // Invert to highlight veins (veins appear as dark lines in NIR)
-    cv::Mat inverted = 255 - laplacian;
-
-    // Blend with original using weighted addition
-    cv::addWeighted(frame, veinConfig.enhancementAlpha, inverted, veinConfig.enhancementBeta, 0, result);
-
-    return result;
-}
-
-cv::Mat ControlCamera::applyVeinEnhancementForDetection(const cv::Mat &frame)
-{
-    // Vein enhancement preprocessing similar to Python approach
-    cv::Mat enhanced_frame;
-
-    // Convert to grayscale
-    cv::Mat gray;
-    if (frame.channels() == 3)
-    {
-        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
-    }
-    else
-    {
-        gray = frame.clone();
-    }
-
-    // Apply CLAHE for contrast enhancement
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(3.0, cv::Size(8, 8));
-    cv::Mat gray_enhanced;
-    clahe->apply(gray, gray_enhanced);
-
-    // Convert back to BGR for YOLO detection
-    cv::cvtColor(gray_enhanced, enhanced_frame, cv::COLOR_GRAY2BGR);
-
-    return enhanced_frame;
-}
-
-std::vector<Detection> ControlCamera::findVeinRegions(const cv::Mat &binaryFrame)
-{
-    std::vector<Detection> detections;
-
-    if (binaryFrame.empty())
-        return detections;
-
-    try
-    {
-        // Find contours in the binary image
-        std::vector<std::vector<cv::Point>> contours;
-        std::vector<cv::Vec4i> hierarchy;
-        cv::findContours(binaryFrame, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-
-        // Filter contours and create detections
-        for (size_t i = 0; i < contours.size(); i++)
-        {
-            double area = cv::contourArea(contours[i]);
-
-            // Filter by area (adjust these thresholds based on your needs)
-            if (area > 100 && area < 10000) // Min and max area for vein regions
-            {
-                cv::Rect boundingRect = cv::boundingRect(contours[i]);
-
-                // Filter by aspect ratio (veins are typically elongated)
-                double aspectRatio = static_cast<double>(boundingRect.width) / boundingRect.height;
-                if (aspectRatio > 0.2 && aspectRatio < 5.0) // Allow some variation in aspect ratio
-                {
-                    Detection detection;
-                    detection.boundingBox = boundingRect;
-                    detection.confidence = static_cast<float>(area / 1000.0); // Confidence based on area
-                    detection.confidence = std::min(detection.confidence, 1.0f);
-                    detection.classId = 0;
-                    detection.className = "vein_region";
-
-                    // Only add if confidence is above threshold
-                    if (detection.confidence > visualConfig.confidenceThreshold)
-                    {
-                        detections.push_back(detection);
-                    }
-                }
-            }
-        }
-
-        // Sort by confidence (highest first)
-        std::sort(detections.begin(), detections.end(),
-                  [](const Detection &a, const Detection &b)
-                  {
-                      return a.confidence > b.confidence;
-                  });
-
-        // Limit the number of detections to prevent clutter
-        if (detections.size() > 10)
-        {
-            detections.resize(10);
-        }
-    }
-    catch (const std::exception &e)
-    {
-        qWarning() << "Error finding vein regions:" << e.what();
-    }
-
-    return detections;
-}
@@ -1,18 +1,31 @@
 #pragma once
 
 #include <QWidget>
-#include <QTimer>
+#include <QThread>
+#include <QMutex>
 #include <QSlider>
 #include <QLabel>
 #include <QCheckBox>
 #include <QComboBox>
 #include <QVBoxLayout>
+#include <QGroupBox>
 #include <QVariant>
 #include <opencv2/opencv.hpp>
 #include <linux/videodev2.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include "PreviewWidget.h"
+#include "FramePresenter.h"
+#include "VeinProcessor.h"
+#include "VeinTracker.h"
+#include "LoadController.h"
+#include "ExposureController.h"
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+#include "ControlBatcher.h"
+#include "ControlCache.h"
+#include "FlatField.h"
 
 // Register cv::Scalar as a QVariant type
 Q_DECLARE_METATYPE(cv::Scalar)
@@ -24,15 +37,8 @@ Q_DECLARE_METATYPE(cv::Scalar)
 #include <pybind11/stl.h>
 #define slots Q_SLOTS
 #include <fstream>
-
-// Detection result structure
-struct Detection
-{
-    cv::Rect boundingBox;
-    float confidence;
-    int classId;
-    std::string className;
-};
+#include <atomic>
+#include <memory>
 
 // Visualization options
 struct VisualizationConfig
@@ -48,55 +54,14 @@ struct VisualizationConfig
     float confidenceThreshold = 0.5;
 };
 
-// Vein processing configuration based on Python VeinProcessor
-struct VeinProcessingConfig
-{
-    // Filter settings
-    bool medianFilterEnabled = true;
-    int medianKernelSize = 5;
-
-    bool gaussianFilterEnabled = true;
-    int gaussianKernelSize = 5;
-    double gaussianSigma = 1.2;
-
-    bool bilateralFilterEnabled = true;
-    int bilateralDiameter = 9;
-    double bilateralSigmaColor = 75.0;
-    double bilateralSigmaSpace = 75.0;
-
-    // CLAHE settings
-    bool claheEnabled = true;
-    double claheClipLimit = 3.0;
-    int claheTileGridSizeX = 8;
-    int claheTileGridSizeY = 8;
-
-    // Contrast enhancement
-    bool contrastEnabled = true;
-    double contrastAlpha = 1.8;
-    int contrastBeta = 10;
-
-    // Adaptive thresholding
-    bool adaptiveThresholdEnabled = true;
-    int adaptiveBlockSize = 11;
-    int adaptiveCValue = 2;
-
-    // Morphological operations
-    bool morphologyEnabled = true;
-    int morphologyKernelSize = 3;
-    int morphologyOperation = cv::MORPH_CLOSE;
-
-    // Vein enhancement
-    bool veinEnhancementEnabled = true;
-    double enhancementAlpha = 0.7;
-    double enhancementBeta = 0.3;
-};
-
 class ControlCamera : public QWidget
 {
     Q_OBJECT
 
 public:
     explicit ControlCamera(int deviceIndex, QWidget *parent = nullptr);
+    // Camera fed from another source, e.g. a virtual camera; deviceIndex keys its saved settings
+    ControlCamera(int deviceIndex, std::unique_ptr<FrameSource> frameSource, QWidget *parent = nullptr);
     ~ControlCamera();
 
     bool openCamera();
@@ -111,6 +76,9 @@ public:
     void loadConfiguration();
     void saveConfiguration();
 
+    // Write a set of control values in one call, e.g. a saved or NIR profile
+    bool applyControlProfile(const std::map<uint32_t, int32_t> &profile);
+
     // Load the vein detection model (ONNX format)
     bool loadVeinModel(const std::string &modelPath);
 
@@ -134,17 +102,62 @@ public:
     void setVeinProcessingConfig(const VeinProcessingConfig &config);
     VeinProcessingConfig getVeinProcessingConfig() const;
 
-    // private slots:
+private:
+    // Capture thread: read, process and publish one frame
     void grabFrame();
+    // Run detection at a processing scale, with boxes offset by origin into full
+    // frame coordinates; returns elapsed milliseconds
+    double detectAtScale(const cv::Mat &frame, double scale, const cv::Point &origin, std::vector<Detection> &detections);
+    // Record how long after its capture timestamp a frame reached milestone
+    void recordFrameAge(const FrameTag &tag, FrameMilestone milestone);
 
-private:
-    int fd; // file descriptor
+    int fd; // file descriptor for V4L2 controls, -1 when the source has none
     int deviceIndex;
-    cv::VideoCapture cap;
-    QTimer *frameTimer;
+    FrameRecorder recorder; // Raw frames and control changes, while recording
+    std::unique_ptr<FrameSource> source;
+    ControlBatcher *controlBatcher; // Coalesces control writes into one ioctl per frame
+    ControlCache *controlCache;     // Control values and flags, kept current by driver events
+
+    // Capture and processing run on their own thread; the presenter shows
+    // the newest result on the UI thread at display refresh
+    QThread *captureThread;
+    std::atomic<bool> captureRunning;
+    FramePresenter *presenter;
+
+    // Capture thread state
+    FrameResult workingFrame;
+    VeinProcessor veinProcessor;
+    VeinTracker veinTracker;
+    std::vector<Detection> rawDetections;
+    cv::Mat scaledFrame;
+    cv::Mat modelGray, modelInput; // 8-bit BGR copy of gray frames for the model
+    LoadController loadController;
+    int idleSkippedFrames; // Untracked frames since the detector last looked at an idle scene
+    ExposureController exposureController;
+    std::atomic<bool> statisticsExposure; // Drive a manual exposure from the vein chain's statistics
+    std::atomic<bool> autoRegionRequested; // Set by the UI, served on the next frame
+    FlatFieldCorrection flatField;
+    FlatFieldCalibrator flatFieldCalibrator;
+    cv::Mat correctedFrame;
+    std::atomic<bool> flatFieldEnabled;
+    std::atomic<int> calibrationRequest; // 1 + FlatFieldCalibrator::Reference, 0 for none
+    std::atomic<bool> veinGraphEnabled;   // Extract centrelines on detector frames for the overlay
+    VeinGraph veinGraph;                  // Of the last detector frame, in its coordinates until mapped
+    float detectionThreshold;
+    quint64 capturedFrames;
+
+    // Per-stage latency histograms, written from the capture and UI threads
+    PipelineMetrics metrics;
+    TraceSpikeTrigger traceTrigger;
+
+    // Guards settings written by the UI and snapshotted by the capture thread
+    QMutex configMutex;
 
     // UI Controls
-    QLabel *previewLabel;
+    PreviewWidget *previewWidget;
+    QLabel *fpsLabel;
+    QLabel *metricsLabel;
+    cv::Rect presentedRegion; // Part of the full frame on screen, empty for all of it
 
     QSlider *brightnessSlider;
     QSlider *contrastSlider;
@@ -161,52 +174,60 @@ private:
     // Python YOLO model members
     pybind11::module_ yolo_module;
     std::vector<std::string> classNames;
-    bool modelLoaded;
+    std::atomic<bool> modelLoaded;
     bool veinDetectionEnabled;
     VisualizationConfig visualConfig;
     VeinProcessingConfig veinConfig;
+    TrackerConfig trackerConfig;
+    LoadSheddingConfig loadSheddingConfig;
+    int bestTrackId; // Keeps the [BEST] marker on one track until another clearly wins
 
     // Python interpreter guard
     static bool python_initialized;
+    // Released on the main thread after startup so detection can run on the capture thread
+    static pybind11::gil_scoped_release *python_gil_release;
 
     // Model constants
     static constexpr float CONFIDENCE_THRESHOLD = 0.3f;
 
-    // Process frame through the model
-    cv::Mat processFrameWithModel(const cv::Mat &inputFrame);
-
-    // Vein processing methods (based on Python VeinProcessor)
-    cv::Mat processVeinFrame(const cv::Mat &inputFrame);
-    cv::Mat getVeinBinaryFrame(const cv::Mat &inputFrame);
-    cv::Mat applyMedianFilter(const cv::Mat &frame);
-    cv::Mat applyGaussianFilter(const cv::Mat &frame);
-    cv::Mat applyBilateralFilter(const cv::Mat &frame);
-    cv::Mat applyCLAHE(const cv::Mat &frame);
-    cv::Mat applyContrastEnhancement(const cv::Mat &frame);
-    cv::Mat applyAdaptiveThreshold(const cv::Mat &frame);
-    cv::Mat applyMorphology(const cv::Mat &frame);
-    cv::Mat applyVeinEnhancement(const cv::Mat &frame, const cv::Mat &enhanced);
-    cv::Mat applyVeinEnhancementForDetection(const cv::Mat &frame);
-    std::vector<Detection> findVeinRegions(const cv::Mat &binaryFrame);
+    // Process frame through the model, filling detections in frame coordinates
+    void processFrameWithModel(const cv::Mat &inputFrame, std::vector<Detection> &detections);
 
     // Detection and visualization methods
     std::vector<Detection> runDetection(const cv::Mat &inputFrame);
     void detectWithPython(const cv::Mat &image, std::vector<Detection> &output);
     cv::Mat formatForYolo(const cv::Mat &source);
     cv::Mat matToNumpyArray(const cv::Mat &mat);
-    cv::Mat drawDetections(const cv::Mat &frame, const std::vector<Detection> &detections);
-    void drawCrosshair(cv::Mat &frame, const Detection &detection, const cv::Point &center, bool isHighestConfidence);
-    void drawLabel(cv::Mat &frame, const Detection &detection, const cv::Point &position, bool isHighestConfidence = false);
+    // Markers for detections and centrelines in full frame coordinates, over a frame
+    // showing the region at origin
+    void drawDetections(DetectionOverlay &overlay, const std::vector<Detection> &detections, const VeinGraph &graph,
+                        const cv::Point &origin);
 
     void setupUI();
+    QGroupBox *createPerformancePanel(QWidget *parent);
+    QHBoxLayout *createRecordingRow(QWidget *parent);
+    QHBoxLayout *createRegionRow(QWidget *parent);
+    QHBoxLayout *createFlatFieldRow(QWidget *parent);
+    // Where this camera's flat field map is kept
+    QString flatFieldPath() const;
+    // Capture thread: average calibration frames, then swap frame for its corrected luma
+    void ingestFlatField(FrameResult &frame);
+    // Capture thread: keep the temporal denoiser on consecutive frames through a frame
+    // the detector skips, at the scale detection runs at
+    void denoiseSkippedFrame(const VeinProcessingConfig &config, double scale);
+    // Capture thread: step the manual exposure towards the target for these statistics
+    void updateExposure(const FrameStatistics &stats);
+    // Write the trace timeline to the home directory
+    void saveTrace(const QString &reason);
+    bool startRecording(const QString &path);
     void setupConnections();
 
-    bool ioctlQueryControl(__u32 id, v4l2_queryctrl &ctrl);
-    bool ioctlSetControl(__u32 id, int value);
-
     void addSliderRow(QVBoxLayout *, const QString &, QSlider *&);
     void addComboBoxRow(QVBoxLayout *, const QString &, QComboBox *&);
     void setupControlsFromV4L2();
     void loadInitialControlValues();
     void updateControlStates();
+    // Show the cached value of id in its widget without writing it back
+    void syncControlWidget(__u32 id);
+    void onControlChanged(uint32_t id, uint32_t changes);
 };
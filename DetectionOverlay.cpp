@@ -0,0 +1,200 @@
+#include "DetectionOverlay.h"
+#include <QFont>
+#include <QFontMetrics>
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Bound the label cache, checked between frames so a frame's markers keep their
+// labels; confidences are quantised to percent so this is rarely hit
+constexpr int MAX_CACHED_LABELS = 1024;
+// Pixel height of FONT_HERSHEY_SIMPLEX at font scale 1, so labels keep their putText size
+constexpr double HERSHEY_PIXEL_SIZE = 22.0;
+}
+
+DetectionOverlay::DetectionOverlay()
+    : showNames(true), showConfidence(true),
+      labelBackground(0, 255, 0), labelText(255, 255, 255), fontScale(0.5f), lineWidth(2)
+{
+}
+
+void DetectionOverlay::clear()
+{
+    if (labelCache.size() >= MAX_CACHED_LABELS)
+        labelCache.clear();
+    markers.clear();
+    centrelines.clear();
+    junctions.clear();
+}
+
+void DetectionOverlay::addMarker(const QPointF &center, bool isHighestConfidence, int classId,
+                                 const std::string &className, float confidence)
+{
+    Marker marker;
+    marker.center = center;
+    marker.isHighestConfidence = isHighestConfidence;
+    marker.labelKey = 0;
+
+    if (showNames || showConfidence)
+    {
+        int percent = std::clamp(static_cast<int>(confidence * 100), 0, 100);
+        // Key layout: class id, confidence percent, best flag; never zero
+        marker.labelKey = (static_cast<quint64>(static_cast<quint32>(classId) + 1) << 16) |
+                          (static_cast<quint64>(percent) << 1) |
+                          (isHighestConfidence ? 1u : 0u);
+        labelImage(marker.labelKey, className, percent, isHighestConfidence);
+    }
+
+    markers.push_back(marker);
+}
+
+void DetectionOverlay::addCentreline(const QPolygonF &points)
+{
+    centrelines.push_back(points);
+}
+
+void DetectionOverlay::addJunction(const QPointF &position)
+{
+    junctions.push_back(position);
+}
+
+void DetectionOverlay::setLabelMode(bool names, bool confidence)
+{
+    if (names == showNames && confidence == showConfidence)
+        return;
+    showNames = names;
+    showConfidence = confidence;
+    labelCache.clear();
+}
+
+void DetectionOverlay::setColors(const QColor &background, const QColor &text)
+{
+    if (background == labelBackground && text == labelText)
+        return;
+    labelBackground = background;
+    labelText = text;
+    labelCache.clear();
+}
+
+void DetectionOverlay::setFontScale(float scale)
+{
+    if (scale == fontScale)
+        return;
+    fontScale = scale;
+    labelCache.clear();
+}
+
+void DetectionOverlay::setLineWidth(int width)
+{
+    lineWidth = std::max(1, width);
+}
+
+const QImage &DetectionOverlay::labelImage(quint64 key, const std::string &className, int percent, bool isHighestConfidence)
+{
+    auto it = labelCache.constFind(key);
+    if (it != labelCache.constEnd())
+        return it.value();
+
+    // Build label text, only on a cache miss
+    QString text;
+    if (showNames)
+        text = QString::fromStdString(className);
+    if (showConfidence)
+        text += showNames ? QString(": %1%").arg(percent) : QString("%1%").arg(percent);
+    if (isHighestConfidence)
+        text.prepend("[BEST] "); // Mark the highest confidence
+
+    QFont font;
+    double scale = isHighestConfidence ? fontScale * 1.2 : fontScale; // Larger text for highest
+    font.setPixelSize(std::max(1, static_cast<int>(std::lround(HERSHEY_PIXEL_SIZE * scale))));
+    QFontMetrics metrics(font);
+    QSize textSize(metrics.horizontalAdvance(text), metrics.height());
+
+    QImage image(textSize.width() + 10, textSize.height() + 6, QImage::Format_ARGB32_Premultiplied);
+    image.fill(isHighestConfidence ? QColor(255, 0, 0) : labelBackground); // Red bg for highest
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(font);
+    painter.setPen(isHighestConfidence ? QColor(255, 255, 255) : labelText);
+    painter.drawText(QPoint(5, 3 + metrics.ascent()), text);
+    painter.end();
+
+    return *labelCache.insert(key, image);
+}
+
+void DetectionOverlay::paint(QPainter &painter, const QRectF &target, double scale)
+{
+    if (markers.empty() && centrelines.empty())
+        return;
+
+    painter.save();
+    painter.setClipRect(target);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    // Centrelines under the markers; a cosmetic pen keeps their width at any scale
+    if (!centrelines.empty())
+    {
+        painter.save();
+        painter.translate(target.topLeft());
+        painter.scale(scale, scale);
+        QPen centrelinePen(QColor(0, 200, 255), lineWidth);
+        centrelinePen.setCosmetic(true);
+        painter.setPen(centrelinePen);
+        for (const QPolygonF &line : centrelines)
+            painter.drawPolyline(line);
+        painter.restore();
+
+        painter.setPen(QPen(Qt::white, 1));
+        painter.setBrush(QColor(255, 120, 0));
+        for (const QPointF &junction : junctions)
+            painter.drawEllipse(target.topLeft() + junction * scale, 4.0, 4.0);
+        painter.setBrush(Qt::NoBrush);
+    }
+
+    for (const Marker &marker : markers)
+    {
+        QPointF center = target.topLeft() + marker.center * scale;
+        if (!target.contains(center))
+            continue;
+
+        bool best = marker.isHighestConfidence;
+        QColor crossColor = best ? QColor(100, 255, 0) : QColor(0, 255, 0);  // Bright green for highest, normal green for others
+        QColor circleColor = best ? QColor(200, 255, 0) : QColor(0, 200, 0); // Light green for highest, dark green for others
+        double crossSize = best ? 25 : 20;                                   // Larger cross for highest confidence
+        double circleRadius = best ? 8 : 5;                                  // Larger circle for highest confidence
+
+        // Crosshair
+        painter.setPen(QPen(crossColor, best ? lineWidth + 1 : lineWidth));
+        painter.drawLine(QPointF(center.x() - crossSize, center.y()), QPointF(center.x() + crossSize, center.y()));
+        painter.drawLine(QPointF(center.x(), center.y() - crossSize), QPointF(center.x(), center.y() + crossSize));
+
+        // Filled center circle
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(circleColor);
+        painter.drawEllipse(center, circleRadius, circleRadius);
+        painter.setBrush(Qt::NoBrush);
+
+        // White outer ring for highest confidence detection
+        if (best)
+        {
+            painter.setPen(QPen(Qt::white, 2));
+            painter.drawEllipse(center, circleRadius + 3, circleRadius + 3);
+        }
+
+        // Label above and to the right of the crosshair
+        if (marker.labelKey != 0)
+        {
+            auto it = labelCache.constFind(marker.labelKey);
+            if (it != labelCache.constEnd())
+            {
+                QPointF position(center.x() + 15, center.y() - 15 - it.value().height() + 5);
+                painter.drawImage(position, it.value());
+            }
+        }
+    }
+
+    painter.restore();
+}
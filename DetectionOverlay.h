@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+#include <string>
+#include <vector>
+
+class QPainter;
+
+// Vector overlay for detections, painted over the preview at paint time.
+// Detections are kept as small markers in source frame coordinates, and label
+// bitmaps are rendered once per (class, confidence, best) and reused, so the
+// camera frame is never drawn on and overlay cost does not depend on resolution.
+class DetectionOverlay
+{
+public:
+    DetectionOverlay();
+
+    // Start a new set of markers for the next frame
+    void clear();
+
+    // Add a crosshair at center (source frame coordinates) with an optional label
+    void addMarker(const QPointF &center, bool isHighestConfidence, int classId,
+                   const std::string &className, float confidence);
+
+    // Add a vein centreline through points and a branch point, source frame coordinates
+    void addCentreline(const QPolygonF &points);
+    void addJunction(const QPointF &position);
+
+    // Label and line settings; changing them invalidates cached labels
+    void setLabelMode(bool showNames, bool showConfidence);
+    void setColors(const QColor &labelBackground, const QColor &labelText);
+    // Label size in cv::putText font scale units, which the overlay used to be drawn with
+    void setFontScale(float scale);
+    void setLineWidth(int width);
+
+    // Paint all markers; target is where the frame is drawn, scale maps frame to widget pixels
+    void paint(QPainter &painter, const QRectF &target, double scale);
+
+private:
+    struct Marker
+    {
+        QPointF center;
+        quint64 labelKey; // Key into labelCache, 0 when no label is shown
+        bool isHighestConfidence;
+    };
+
+    const QImage &labelImage(quint64 key, const std::string &className, int percent, bool isHighestConfidence);
+
+    std::vector<Marker> markers;
+    std::vector<QPolygonF> centrelines;
+    std::vector<QPointF> junctions;
+    QHash<quint64, QImage> labelCache;
+
+    bool showNames;
+    bool showConfidence;
+    QColor labelBackground;
+    QColor labelText;
+    float fontScale;
+    int lineWidth;
+};
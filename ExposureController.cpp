@@ -0,0 +1,56 @@
+#include "ExposureController.h"
+#include "VeinKernels.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr double DAMPING = 0.5;        // Share of the log exposure error corrected per step
+constexpr double MAX_STEP = 2.0;       // Exposure changes by at most this factor per step
+constexpr double HIGHLIGHT_STEP = 0.8; // Exposure factor while highlights are clipping
+constexpr int SETTLE_UPDATES = 3;      // Drivers apply a new exposure a frame or two late
+}
+
+ExposureController::ExposureController(const ExposureConfig &initialConfig)
+    : config(initialConfig), settleUpdates(0)
+{
+}
+
+int64_t ExposureController::update(const FrameStatistics &stats, int64_t current, int64_t minimum, int64_t maximum)
+{
+    if (!stats.isValid() || maximum <= minimum)
+        return current;
+    if (settleUpdates > 0)
+    {
+        settleUpdates--;
+        return current;
+    }
+
+    const double fullScale = 255.0 * grayLevelScale(stats.depth);
+    const double median = std::max(stats.percentile(0.5), 1.0) / fullScale;
+    const double highlights = stats.percentile(0.99) / fullScale;
+
+    // Brightening stops short of clipping the highlights, and clipping ones pull back
+    double ratio = config.targetLevel / median;
+    if (highlights >= config.highlightLimit)
+        ratio = std::min(ratio, HIGHLIGHT_STEP);
+    else
+        ratio = std::min(ratio, config.highlightLimit / std::max(highlights, 1.0 / fullScale));
+    if (std::abs(std::log(ratio)) < std::log1p(config.tolerance))
+        return current;
+
+    ratio = std::clamp(std::pow(ratio, DAMPING), 1.0 / MAX_STEP, MAX_STEP);
+    int64_t next = std::llround(static_cast<double>(std::max<int64_t>(current, 1)) * ratio);
+    // Short exposures round back to where they were; move by at least one unit
+    if (next == current)
+        next += ratio > 1.0 ? 1 : -1;
+    next = std::clamp(next, minimum, maximum);
+    if (next != current)
+        settleUpdates = SETTLE_UPDATES;
+    return next;
+}
+
+void ExposureController::reset()
+{
+    settleUpdates = 0;
+}
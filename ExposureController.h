@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include "FrameStatistics.h"
+
+// Exposure targets, as fractions of the frame's full scale
+struct ExposureConfig
+{
+    double targetLevel = 0.45;    // Median gray level sought
+    double highlightLimit = 0.97; // The 99th percentile is pulled back under this
+    double tolerance = 0.1;       // Relative median error left alone
+};
+
+// Software auto exposure for cameras left in manual exposure.
+// It reads the shared frame statistics rather than the frame, and steps the
+// exposure time towards the median target. Keeping highlights below the limit
+// wins over brightening the median, since clipped veins cannot be recovered.
+// Steps are halved in log space and wait for the sensor to settle after each
+// change, so the loop neither oscillates nor acts on frames exposed before it.
+class ExposureController
+{
+public:
+    explicit ExposureController(const ExposureConfig &config = ExposureConfig());
+
+    // Exposure to use after a frame with these statistics taken at current, within
+    // [minimum, maximum]; current when it should stay
+    int64_t update(const FrameStatistics &stats, int64_t current, int64_t minimum, int64_t maximum);
+
+    // Forget pending settling, e.g. after the camera changed
+    void reset();
+
+private:
+    ExposureConfig config;
+    int settleUpdates; // Updates to let pass before the last change shows in the statistics
+};
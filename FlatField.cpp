@@ -0,0 +1,264 @@
+#include "FlatField.h"
+#include "VeinKernels.h"
+#include <QDebug>
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+
+namespace
+{
+using namespace cv;
+
+// BGR to luma weights with 8 fraction bits, OpenCV's BT.601 weights rounded
+constexpr int LUMA_BITS = 8;
+constexpr ushort LUMA_B = 29;
+constexpr ushort LUMA_G = 150;
+constexpr ushort LUMA_R = 77;
+
+// 8-bit frames carry luma with LUMA_BITS fraction bits into the gain multiply
+constexpr int SHIFT_8U = FlatFieldCorrection::GAIN_BITS + LUMA_BITS;
+constexpr int SHIFT_16U = FlatFieldCorrection::GAIN_BITS;
+
+inline uint32_t correctPixel(int luma, ushort dark, ushort gain, int shift)
+{
+    uint32_t value = static_cast<uint32_t>(std::max(luma - dark, 0)) * gain;
+    return (value + (1u << (shift - 1))) >> shift;
+}
+
+#if CV_SIMD
+// (luma - dark) * gain, rounded back down by SHIFT and saturated to 16 bits
+template <int SHIFT>
+inline v_uint16 correctLanes(const v_uint16 &luma, const ushort *dark, const ushort *gain)
+{
+    const v_uint32 half = vx_setall_u32(1u << (SHIFT - 1));
+    v_uint32 lo, hi;
+    v_mul_expand(luma - vx_load(dark), vx_load(gain), lo, hi);
+    return v_pack(v_shr<SHIFT>(lo + half), v_shr<SHIFT>(hi + half));
+}
+#endif
+
+void correctBgrRow(const uchar *src, const ushort *dark, const ushort *gain, uchar *dst, int width)
+{
+    int x = 0;
+#if CV_SIMD
+    const v_uint16 vB = vx_setall_u16(LUMA_B);
+    const v_uint16 vG = vx_setall_u16(LUMA_G);
+    const v_uint16 vR = vx_setall_u16(LUMA_R);
+    for (; x <= width - v_uint8::nlanes; x += v_uint8::nlanes)
+    {
+        v_uint8 b, g, r;
+        v_load_deinterleave(src + 3 * x, b, g, r);
+        v_uint16 b0, b1, g0, g1, r0, r1;
+        v_expand(b, b0, b1);
+        v_expand(g, g0, g1);
+        v_expand(r, r0, r1);
+        v_uint16 luma0 = v_mul_wrap(b0, vB) + v_mul_wrap(g0, vG) + v_mul_wrap(r0, vR);
+        v_uint16 luma1 = v_mul_wrap(b1, vB) + v_mul_wrap(g1, vG) + v_mul_wrap(r1, vR);
+        const int x1 = x + v_uint16::nlanes;
+        v_store(dst + x, v_pack(correctLanes<SHIFT_8U>(luma0, dark + x, gain + x),
+                                correctLanes<SHIFT_8U>(luma1, dark + x1, gain + x1)));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+    {
+        int luma = src[3 * x] * LUMA_B + src[3 * x + 1] * LUMA_G + src[3 * x + 2] * LUMA_R;
+        dst[x] = saturate_cast<uchar>(correctPixel(luma, dark[x], gain[x], SHIFT_8U));
+    }
+}
+
+void correctGrayRow(const uchar *src, const ushort *dark, const ushort *gain, uchar *dst, int width)
+{
+    int x = 0;
+#if CV_SIMD
+    for (; x <= width - v_uint8::nlanes; x += v_uint8::nlanes)
+    {
+        v_uint16 luma0, luma1;
+        v_expand(vx_load(src + x), luma0, luma1);
+        const int x1 = x + v_uint16::nlanes;
+        v_store(dst + x, v_pack(correctLanes<SHIFT_8U>(v_shl<LUMA_BITS>(luma0), dark + x, gain + x),
+                                correctLanes<SHIFT_8U>(v_shl<LUMA_BITS>(luma1), dark + x1, gain + x1)));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = saturate_cast<uchar>(correctPixel(src[x] << LUMA_BITS, dark[x], gain[x], SHIFT_8U));
+}
+
+void correctGrayRow(const ushort *src, const ushort *dark, const ushort *gain, ushort *dst, int width)
+{
+    int x = 0;
+#if CV_SIMD
+    for (; x <= width - v_uint16::nlanes; x += v_uint16::nlanes)
+        v_store(dst + x, correctLanes<SHIFT_16U>(vx_load(src + x), dark + x, gain + x));
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = saturate_cast<ushort>(correctPixel(src[x], dark[x], gain[x], SHIFT_16U));
+}
+}
+
+bool FlatFieldCorrection::isValid() const
+{
+    return !gain.empty();
+}
+
+cv::Size FlatFieldCorrection::size() const
+{
+    return gain.size();
+}
+
+void FlatFieldCorrection::setReferences(const cv::Mat &dark, const cv::Mat &flat)
+{
+    // The falloff is smooth, so blurring removes the target's texture and sensor
+    // noise without touching it. The dark frame keeps its per-pixel pattern.
+    cv::Mat signal;
+    cv::subtract(flat, dark, signal);
+    double sigma = std::max(signal.cols, signal.rows) / 64.0;
+    cv::GaussianBlur(signal, signal, cv::Size(), sigma, sigma, cv::BORDER_REPLICATE);
+    cv::max(signal, 1.0, signal);
+
+    cv::Mat ratio;
+    cv::divide(cv::mean(signal)[0] * (1 << GAIN_BITS), signal, ratio);
+    ratio.convertTo(gain, CV_16U); // Gains past 16x saturate
+    dark.convertTo(dark16, CV_16U);
+    dark16.convertTo(dark8, CV_16U, 256.0 / 257.0);
+}
+
+bool FlatFieldCorrection::apply(const cv::Mat &frame, const cv::Rect &region, cv::Mat &gray) const
+{
+    cv::Rect area = region.empty() ? cv::Rect(0, 0, frame.cols, frame.rows) : region;
+    bool deep = frame.type() == CV_16UC1;
+    if (!isValid() || area.size() != frame.size() || (area & cv::Rect(cv::Point(), size())) != area)
+        return false;
+    if (!deep && frame.type() != CV_8UC3 && frame.type() != CV_8UC1)
+        return false;
+
+    const cv::Mat darkArea = (deep ? dark16 : dark8)(area);
+    const cv::Mat gainArea = gain(area);
+    gray.create(frame.size(), deep ? CV_16UC1 : CV_8UC1);
+    const int width = frame.cols;
+    const bool bgr = frame.channels() == 3;
+    cv::parallel_for_(cv::Range(0, frame.rows), [&](const cv::Range &rows)
+                      {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            const ushort *dark = darkArea.ptr<ushort>(y);
+            const ushort *gainRow = gainArea.ptr<ushort>(y);
+            if (deep)
+                correctGrayRow(frame.ptr<ushort>(y), dark, gainRow, gray.ptr<ushort>(y), width);
+            else if (bgr)
+                correctBgrRow(frame.ptr<uchar>(y), dark, gainRow, gray.ptr<uchar>(y), width);
+            else
+                correctGrayRow(frame.ptr<uchar>(y), dark, gainRow, gray.ptr<uchar>(y), width);
+        } });
+    return true;
+}
+
+bool FlatFieldCorrection::save(const QString &path) const
+{
+    try
+    {
+        cv::FileStorage storage(path.toStdString(), cv::FileStorage::WRITE);
+        if (!storage.isOpened())
+        {
+            qWarning() << "Failed to write flat field" << path;
+            return false;
+        }
+        storage << "gain_bits" << GAIN_BITS << "gain" << gain << "dark" << dark16;
+        return true;
+    }
+    catch (const cv::Exception &e)
+    {
+        qWarning() << "Failed to write flat field" << path << e.what();
+        return false;
+    }
+}
+
+bool FlatFieldCorrection::load(const QString &path)
+{
+    cv::Mat loadedGain, loadedDark;
+    int gainBits = 0;
+    try
+    {
+        cv::FileStorage storage(path.toStdString(), cv::FileStorage::READ);
+        if (!storage.isOpened())
+            return false;
+        storage["gain_bits"] >> gainBits;
+        storage["gain"] >> loadedGain;
+        storage["dark"] >> loadedDark;
+    }
+    catch (const cv::Exception &e)
+    {
+        qWarning() << "Failed to read flat field" << path << e.what();
+        return false;
+    }
+
+    if (gainBits != GAIN_BITS || loadedGain.type() != CV_16UC1 || loadedDark.type() != CV_16UC1 ||
+        loadedGain.size() != loadedDark.size())
+    {
+        qWarning() << "Ignoring malformed flat field" << path;
+        return false;
+    }
+    gain = loadedGain;
+    dark16 = loadedDark;
+    dark16.convertTo(dark8, CV_16U, 256.0 / 257.0);
+    return true;
+}
+
+void FlatFieldCalibrator::start(Reference which, int frames)
+{
+    reference = which;
+    remaining = std::max(frames, 1);
+    frameCount = 0;
+    sum.release();
+}
+
+void FlatFieldCalibrator::cancel()
+{
+    remaining = 0;
+    sum.release();
+}
+
+bool FlatFieldCalibrator::isCapturing() const
+{
+    return remaining > 0;
+}
+
+bool FlatFieldCalibrator::addFrame(const cv::Mat &frame)
+{
+    if (remaining <= 0 || frame.empty())
+        return false;
+
+    const cv::Mat *gray = &frame;
+    if (frame.channels() == 3)
+    {
+        cv::cvtColor(frame, luma, cv::COLOR_BGR2GRAY);
+        gray = &luma;
+    }
+    if (sum.size() != gray->size())
+    {
+        sum = cv::Mat::zeros(gray->size(), CV_32FC1);
+        frameCount = 0;
+    }
+    cv::accumulate(*gray, sum);
+    frameCount++;
+    if (--remaining > 0)
+        return false;
+
+    // References are kept in 16-bit gray levels, whatever the depth they were captured at
+    double scale = gray->depth() == CV_8U ? PixelDepth<ushort>::grayLevel : 1.0;
+    sum.convertTo(reference == Reference::Dark ? dark : flat, CV_32F, scale / frameCount);
+    sum.release();
+    return true;
+}
+
+bool FlatFieldCalibrator::compute(FlatFieldCorrection &correction) const
+{
+    if (flat.empty())
+        return false;
+    if (dark.size() == flat.size())
+        correction.setReferences(dark, flat);
+    else
+        correction.setReferences(cv::Mat::zeros(flat.size(), CV_32FC1), flat);
+    return true;
+}
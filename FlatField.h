@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QString>
+#include <opencv2/opencv.hpp>
+
+// Per-pixel correction of the NIR illumination falloff and sensor dark level,
+// stored in fixed point: corrected = (luma - dark) * gain. It is applied while the
+// frame's luma is extracted at ingest, so correcting costs no pass of its own.
+class FlatFieldCorrection
+{
+public:
+    static constexpr int GAIN_BITS = 12; // Gains are Q4.12, up to 16x
+
+    bool isValid() const;
+    // Size of the full frame the map covers
+    cv::Size size() const;
+
+    // Build the map from mean dark and flat luma, CV_32FC1 in 16-bit gray levels.
+    // The flat is normalised to its mean, so overall brightness is kept.
+    void setReferences(const cv::Mat &dark, const cv::Mat &flat);
+
+    // Corrected luma of frame, which shows region of the full frame (empty for all
+    // of it): CV_8UC1 from 8-bit BGR or gray, CV_16UC1 from 16-bit gray. False when
+    // the map does not cover the frame.
+    bool apply(const cv::Mat &frame, const cv::Rect &region, cv::Mat &gray) const;
+
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+
+private:
+    cv::Mat gain;   // CV_16UC1, Q4.12
+    cv::Mat dark16; // CV_16UC1, dark level in 16-bit gray levels
+    cv::Mat dark8;  // CV_16UC1, dark level in 8-bit gray levels with 8 fraction bits
+};
+
+// Averages reference frames for a FlatFieldCorrection. Dark frames are taken with
+// the illumination off or the lens capped, flat frames of a uniform diffuse target
+// under the working illumination.
+class FlatFieldCalibrator
+{
+public:
+    enum class Reference
+    {
+        Dark,
+        Flat,
+    };
+
+    static constexpr int DEFAULT_FRAMES = 32;
+
+    // Start averaging the next frames into reference, replacing any earlier one
+    void start(Reference reference, int frames = DEFAULT_FRAMES);
+    void cancel();
+    bool isCapturing() const;
+
+    // Add a whole frame to the reference being captured; true when that completes it
+    bool addFrame(const cv::Mat &frame);
+
+    // Build correction from the captured references; false until a flat is captured.
+    // Without a dark reference the dark level is taken as zero.
+    bool compute(FlatFieldCorrection &correction) const;
+
+private:
+    Reference reference = Reference::Dark;
+    int remaining = 0;
+    int frameCount = 0;
+    cv::Mat sum;  // CV_32FC1 luma sum of the reference being captured
+    cv::Mat luma; // Scratch for one frame's luma
+    cv::Mat dark; // CV_32FC1 mean luma in 16-bit gray levels
+    cv::Mat flat;
+};
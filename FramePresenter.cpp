@@ -0,0 +1,87 @@
+#include "FramePresenter.h"
+#include <QMutexLocker>
+
+FramePresenter::FramePresenter(PresentFunction present, QObject *parent)
+    : QObject(parent), present(std::move(present)), pendingFresh(false),
+      processedCount(0), displayedCount(0), lastProcessedCount(0), lastDisplayedCount(0),
+      processedRate(0.0), displayedRate(0.0)
+{
+    refreshTimer = new QTimer(this);
+    refreshTimer->setTimerType(Qt::PreciseTimer);
+    connect(refreshTimer, &QTimer::timeout, this, &FramePresenter::onRefresh);
+}
+
+void FramePresenter::start(double refreshRate)
+{
+    if (refreshRate <= 0.0)
+        refreshRate = 60.0;
+    refreshTimer->setInterval(std::max(1, static_cast<int>(1000.0 / refreshRate)));
+    rateTimer.start();
+    refreshTimer->start();
+}
+
+void FramePresenter::stop()
+{
+    refreshTimer->stop();
+
+    QMutexLocker lock(&mailboxMutex);
+    pending = FrameResult();
+    pendingFresh = false;
+}
+
+bool FramePresenter::publish(FrameResult &frame)
+{
+    bool replaced;
+    {
+        QMutexLocker lock(&mailboxMutex);
+        // An unpresented pending frame is dropped here and its buffers reused
+        std::swap(frame, pending);
+        replaced = pendingFresh;
+        pendingFresh = true;
+    }
+    processedCount.fetch_add(1, std::memory_order_relaxed);
+    return replaced;
+}
+
+double FramePresenter::processedFps() const
+{
+    return processedRate;
+}
+
+double FramePresenter::displayedFps() const
+{
+    return displayedRate;
+}
+
+void FramePresenter::onRefresh()
+{
+    bool fresh = false;
+    {
+        QMutexLocker lock(&mailboxMutex);
+        if (pendingFresh)
+        {
+            std::swap(pending, displayed);
+            pendingFresh = false;
+            fresh = true;
+        }
+    }
+
+    // Only new frames are presented; the previous image stays on screen otherwise
+    if (fresh)
+    {
+        present(displayed);
+        ++displayedCount;
+    }
+
+    qint64 elapsed = rateTimer.elapsed();
+    if (elapsed >= 1000)
+    {
+        quint64 processed = processedCount.load(std::memory_order_relaxed);
+        processedRate = (processed - lastProcessedCount) * 1000.0 / elapsed;
+        displayedRate = (displayedCount - lastDisplayedCount) * 1000.0 / elapsed;
+        lastProcessedCount = processed;
+        lastDisplayedCount = displayedCount;
+        rateTimer.restart();
+        emit fpsUpdated(processedRate, displayedRate);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "VeinProcessor.h"
+#include "FrameSource.h"
+
+// One processed frame handed from the capture thread to the UI
+struct FrameResult
+{
+    cv::Mat frame;
+    std::vector<Detection> detections;
+    VeinGraph graph; // Centrelines of the last detector frame, empty when not shown
+    quint64 frameId = 0;
+    FrameTag tag; // Capture timestamp and sequence of the source frame
+};
+
+// Presents the newest processed frame at display refresh rate.
+// The capture thread publishes into a mailbox slot and never waits for the UI;
+// the UI picks up at most one frame per refresh and skips stale ones. Frames are
+// swapped between three slots (working, pending, displayed), so buffers are
+// recycled instead of copied.
+class FramePresenter : public QObject
+{
+    Q_OBJECT
+
+public:
+    using PresentFunction = std::function<void(const FrameResult &)>;
+
+    explicit FramePresenter(PresentFunction present, QObject *parent = nullptr);
+
+    // Start pacing at the given refresh rate in Hz
+    void start(double refreshRate);
+    void stop();
+
+    // Called from the capture thread. Swaps the frame into the mailbox and hands
+    // back a recycled slot for the next frame. Returns true when this replaced a
+    // frame that was never presented.
+    bool publish(FrameResult &frame);
+
+    double processedFps() const;
+    double displayedFps() const;
+
+signals:
+    // Emitted about once per second with the measured rates
+    void fpsUpdated(double processed, double displayed);
+
+private:
+    void onRefresh();
+
+    PresentFunction present;
+    QTimer *refreshTimer;
+
+    QMutex mailboxMutex;
+    FrameResult pending;
+    bool pendingFresh;
+    FrameResult displayed;
+
+    std::atomic<quint64> processedCount;
+    quint64 displayedCount;
+    quint64 lastProcessedCount;
+    quint64 lastDisplayedCount;
+    QElapsedTimer rateTimer;
+    double processedRate;
+    double displayedRate;
+};
@@ -0,0 +1,188 @@
+#include "FrameRecorder.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QMutexLocker>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace RecordingFormat;
+
+namespace
+{
+constexpr size_t GROWTH_STEP = size_t(256) << 20; // Bytes added to the file each time it fills up
+}
+
+FrameRecorder::FrameRecorder()
+    : recording(false), fd(-1), mapping(nullptr), capacity(0), used(0)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+bool FrameRecorder::open(const QString &path, const QString &sourceName)
+{
+    close();
+    QMutexLocker lock(&mutex);
+
+    fd = ::open(path.toStdString().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        qWarning() << "Failed to create recording" << path;
+        return false;
+    }
+    filePath = path;
+    used = 0;
+    index.clear();
+    if (!reserve(sizeof(FileHeader)))
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    FileHeader header = {};
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.createdMs = QDateTime::currentMSecsSinceEpoch();
+    strncpy(header.source, sourceName.toUtf8().constData(), sizeof(header.source) - 1);
+    memcpy(mapping, &header, sizeof(header));
+    used = sizeof(header);
+
+    recording = true;
+    qInfo() << "Recording raw frames from" << sourceName << "to" << path;
+    return true;
+}
+
+void FrameRecorder::close()
+{
+    QMutexLocker lock(&mutex);
+    if (fd < 0)
+        return;
+    recording = false;
+
+    // Index and trailer make reopening instant; without them the reader scans
+    size_t indexOffset = used;
+    Trailer trailer;
+    trailer.indexOffset = indexOffset;
+    memcpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+    if (append(IndexRecord, index.data(), index.size() * sizeof(IndexEntry), nullptr, 0) && reserve(sizeof(trailer)))
+    {
+        memcpy(mapping + used, &trailer, sizeof(trailer));
+        used += sizeof(trailer);
+    }
+
+    munmap(mapping, capacity);
+    mapping = nullptr;
+    capacity = 0;
+    if (ftruncate(fd, static_cast<off_t>(used)) != 0)
+        qWarning() << "Failed to trim recording" << filePath;
+    ::close(fd);
+    fd = -1;
+    qInfo() << "Recording" << filePath << "closed with" << index.size() << "frames," << used << "bytes";
+}
+
+bool FrameRecorder::isRecording() const
+{
+    return recording.load(std::memory_order_relaxed);
+}
+
+void FrameRecorder::appendFrame(const RawFrame &frame)
+{
+    if (!recording.load(std::memory_order_relaxed))
+        return;
+
+    FrameInfo info = {};
+    info.timestampNs = frame.timestampNs;
+    info.sequence = frame.sequence;
+    info.pixelFormat = frame.pixelFormat;
+    info.width = static_cast<uint32_t>(frame.width);
+    info.height = static_cast<uint32_t>(frame.height);
+    info.bytesPerLine = static_cast<uint32_t>(frame.bytesPerLine);
+
+    QMutexLocker lock(&mutex);
+    if (fd < 0)
+        return;
+    // Indexed only once written, so the index never points past the end of the file
+    size_t offset = used;
+    if (append(FrameRecord, &info, sizeof(info), frame.data, frame.size))
+        index.push_back({offset, frame.timestampNs});
+}
+
+void FrameRecorder::appendControl(uint32_t id, int32_t value)
+{
+    if (!recording.load(std::memory_order_relaxed))
+        return;
+
+    ControlInfo info = {};
+    info.timestampNs = monotonicNowNs();
+    info.id = id;
+    info.value = value;
+
+    QMutexLocker lock(&mutex);
+    if (fd < 0)
+        return;
+    append(ControlRecord, &info, sizeof(info), nullptr, 0);
+}
+
+quint64 FrameRecorder::framesWritten() const
+{
+    QMutexLocker lock(&mutex);
+    return index.size();
+}
+
+bool FrameRecorder::reserve(size_t bytes)
+{
+    if (used + bytes <= capacity)
+        return true;
+
+    size_t newCapacity = capacity + std::max(GROWTH_STEP, used + bytes - capacity);
+    if (mapping)
+        munmap(mapping, capacity);
+    mapping = nullptr;
+    capacity = 0;
+
+    if (ftruncate(fd, static_cast<off_t>(newCapacity)) != 0)
+    {
+        qWarning() << "Failed to grow recording" << filePath << "to" << newCapacity << "bytes";
+        recording = false;
+        return false;
+    }
+    void *address = mmap(nullptr, newCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        qWarning() << "Failed to map recording" << filePath;
+        recording = false;
+        return false;
+    }
+    mapping = static_cast<uint8_t *>(address);
+    capacity = newCapacity;
+    return true;
+}
+
+bool FrameRecorder::append(uint32_t type, const void *header, size_t headerSize, const void *data, size_t dataSize)
+{
+    size_t payload = headerSize + dataSize;
+    size_t total = sizeof(RecordHeader) + alignedSize(payload);
+    if (!reserve(total))
+        return false;
+
+    RecordHeader record;
+    record.type = type;
+    record.size = static_cast<uint32_t>(payload);
+    uint8_t *out = mapping + used;
+    memcpy(out, &record, sizeof(record));
+    if (headerSize)
+        memcpy(out + sizeof(record), header, headerSize);
+    if (dataSize)
+        memcpy(out + sizeof(record) + headerSize, data, dataSize);
+    // Padding is already zero: the file grows by ftruncate
+    used += total;
+    return true;
+}
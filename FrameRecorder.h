@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QString>
+#include <QMutex>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "FrameSource.h"
+
+// Raw capture container (.veinrec).
+// A 64 byte header is followed by 8-byte aligned records: frames exactly as the
+// driver delivered them with their V4L2 timestamp and sequence, and control
+// changes with the time they were applied. Closing appends a frame index and a
+// trailer pointing at it; a file without a trailer (e.g. after a crash) is
+// indexed by scanning the records instead.
+namespace RecordingFormat
+{
+constexpr char FILE_MAGIC[8] = {'V', 'E', 'I', 'N', 'R', 'E', 'C', '1'};
+constexpr char INDEX_MAGIC[8] = {'V', 'E', 'I', 'N', 'I', 'D', 'X', '1'};
+constexpr uint32_t VERSION = 1;
+
+enum RecordType : uint32_t
+{
+    FrameRecord = 1,
+    ControlRecord = 2,
+    IndexRecord = 3
+};
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int64_t createdMs; // Wall clock, for humans
+    char source[40];   // Device path or source name
+};
+
+struct RecordHeader
+{
+    uint32_t type;
+    uint32_t size; // Payload bytes, excluding this header and padding
+};
+
+struct FrameInfo
+{
+    uint64_t timestampNs;
+    uint32_t sequence;
+    uint32_t pixelFormat;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerLine;
+    uint32_t reserved;
+    // Followed by the frame data
+};
+
+struct ControlInfo
+{
+    uint64_t timestampNs;
+    uint32_t id;
+    int32_t value;
+};
+
+struct IndexEntry
+{
+    uint64_t offset; // Of the frame's RecordHeader
+    uint64_t timestampNs;
+};
+
+struct Trailer
+{
+    uint64_t indexOffset;
+    char magic[8];
+};
+
+static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+static_assert(sizeof(FrameInfo) % 8 == 0 && sizeof(ControlInfo) % 8 == 0, "Record payload alignment");
+
+inline size_t alignedSize(size_t size)
+{
+    return (size + 7) & ~size_t(7);
+}
+}
+
+// Appends raw frames and control changes to a memory-mapped .veinrec file.
+// Frames come from the capture thread and controls from the UI thread; appends
+// are serialized and cost one memcpy into the mapping. The file grows in large
+// steps so remapping is rare.
+class FrameRecorder
+{
+public:
+    FrameRecorder();
+    ~FrameRecorder();
+
+    bool open(const QString &path, const QString &sourceName);
+    void close();
+    bool isRecording() const;
+
+    void appendFrame(const RawFrame &frame);
+    void appendControl(uint32_t id, int32_t value);
+
+    quint64 framesWritten() const;
+
+private:
+    bool reserve(size_t bytes);
+    bool append(uint32_t type, const void *header, size_t headerSize, const void *data, size_t dataSize);
+
+    mutable QMutex mutex;
+    std::atomic<bool> recording;
+    QString filePath;
+    int fd;
+    uint8_t *mapping;
+    size_t capacity;
+    size_t used;
+    std::vector<RecordingFormat::IndexEntry> index;
+};
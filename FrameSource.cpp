@@ -0,0 +1,769 @@
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+#include "PipelineMetrics.h"
+#include <QDebug>
+#include <linux/videodev2.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr int POLL_TIMEOUT_MS = 200; // A stalled camera returns control to the capture loop this often
+
+int xioctl(int fd, unsigned long request, void *arg)
+{
+    int result;
+    do
+    {
+        result = ioctl(fd, request, arg);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+bool getSelection(int fd, uint32_t target, cv::Rect &rect)
+{
+    v4l2_selection selection = {};
+    selection.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    selection.target = target;
+    if (xioctl(fd, VIDIOC_G_SELECTION, &selection) != 0)
+        return false;
+    rect = cv::Rect(selection.r.left, selection.r.top, static_cast<int>(selection.r.width),
+                    static_cast<int>(selection.r.height));
+    return true;
+}
+
+bool setSelection(int fd, const cv::Rect &rect, cv::Rect &applied)
+{
+    v4l2_selection selection = {};
+    selection.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    selection.target = V4L2_SEL_TGT_CROP;
+    selection.r.left = rect.x;
+    selection.r.top = rect.y;
+    selection.r.width = static_cast<__u32>(rect.width);
+    selection.r.height = static_cast<__u32>(rect.height);
+    if (xioctl(fd, VIDIOC_S_SELECTION, &selection) != 0)
+        return false;
+    // The driver rounds to what the sensor can do
+    applied = cv::Rect(selection.r.left, selection.r.top, static_cast<int>(selection.r.width),
+                       static_cast<int>(selection.r.height));
+    return true;
+}
+
+// Bytes per pixel of the uncompressed formats cropRawFrame() can narrow, 0 for others
+int rawPixelBytes(uint32_t pixelFormat)
+{
+    switch (pixelFormat)
+    {
+    case V4L2_PIX_FMT_GREY:
+        return 1;
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_Y10:
+    case V4L2_PIX_FMT_Y12:
+    case V4L2_PIX_FMT_Y16:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// region clipped to a width x height image, widened to whole YUYV pixel pairs
+cv::Rect rawRegion(const cv::Rect &region, uint32_t pixelFormat, int width, int height)
+{
+    cv::Rect clipped = region & cv::Rect(0, 0, width, height);
+    if (pixelFormat == V4L2_PIX_FMT_YUYV && !clipped.empty())
+    {
+        // U and V are shared by each pair of pixels
+        int right = std::min((clipped.x + clipped.width + 1) & ~1, width & ~1);
+        clipped.x &= ~1;
+        clipped.width = right - clipped.x;
+    }
+    return clipped;
+}
+}
+
+uint64_t monotonicNowNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+void FrameSource::tagFrame(uint64_t timestampNs, uint32_t sequence, uint32_t skipped)
+{
+    skipped += pendingSkips;
+    pendingSkips = 0;
+
+    // Sequence numbers the driver skipped and that were not skipped by us were lost
+    // at the sensor; a sequence that goes backwards is a restart, not a loss
+    uint32_t sensorDropped = 0;
+    if (tagged && sequence > lastTag.sequence)
+    {
+        uint32_t missing = sequence - lastTag.sequence - 1;
+        sensorDropped = missing > skipped ? missing - skipped : 0;
+    }
+    lastTag.timestampNs = timestampNs;
+    lastTag.sequence = sequence;
+    lastTag.sensorDropped = sensorDropped;
+    lastTag.skipped = skipped;
+    tagged = true;
+
+    // Delivered rate over windows of at least a second of capture time
+    if (rateWindowStartNs == 0 || timestampNs < rateWindowStartNs)
+    {
+        rateWindowStartNs = timestampNs;
+        rateWindowFrames = 0;
+        return;
+    }
+    rateWindowFrames += 1 + skipped;
+    uint64_t span = timestampNs - rateWindowStartNs;
+    if (span >= 1000000000ULL)
+    {
+        deliveredRate.store(rateWindowFrames * 1e9 / span, std::memory_order_relaxed);
+        rateWindowStartNs = timestampNs;
+        rateWindowFrames = 0;
+    }
+}
+
+void FrameSource::skipFrames(uint32_t count)
+{
+    pendingSkips += count;
+}
+
+void FrameSource::resetTag()
+{
+    tagged = false;
+    pendingSkips = 0;
+    rateWindowStartNs = 0;
+    rateWindowFrames = 0;
+    deliveredRate.store(0.0, std::memory_order_relaxed);
+}
+
+bool FrameSource::read(cv::Mat &frame)
+{
+    bool regionChanged = false;
+    cv::Rect requested;
+    {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        std::swap(regionChanged, regionPending);
+        requested = pendingRegion;
+    }
+    if (regionChanged)
+    {
+        cv::Rect applied;
+        sourceCrops = applyRegion(requested, applied);
+        activeRegion = sourceCrops ? applied : requested;
+    }
+
+    if (!readFrame(frame))
+        return false;
+
+    cv::Rect region = activeRegion;
+    if (!sourceCrops && !region.empty())
+    {
+        region &= cv::Rect(0, 0, frame.cols, frame.rows);
+        if (region.empty() || region.size() == frame.size())
+        {
+            region = cv::Rect();
+        }
+        else
+        {
+            frame(region).copyTo(cropScratch);
+            cv::swap(frame, cropScratch);
+        }
+    }
+    lastTag.region = region;
+    return true;
+}
+
+void FrameSource::setRegion(const cv::Rect &region)
+{
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    pendingRegion = region;
+    regionPending = true;
+}
+
+void FrameSource::restoreRegion()
+{
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    regionPending = true;
+}
+
+bool FrameSource::applyRegion(const cv::Rect &, cv::Rect &)
+{
+    return false;
+}
+
+QString FrameSource::modeDescription() const
+{
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    return description;
+}
+
+void FrameSource::setModeDescription(const QString &text)
+{
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    description = text;
+}
+
+bool cropRawFrame(RawFrame &raw, const cv::Rect &region)
+{
+    int pixelBytes = rawPixelBytes(raw.pixelFormat);
+    cv::Rect clipped = rawRegion(region, raw.pixelFormat, raw.width, raw.height);
+    if (pixelBytes == 0 || clipped.empty())
+        return false;
+
+    raw.data += static_cast<size_t>(clipped.y) * raw.bytesPerLine + static_cast<size_t>(clipped.x) * pixelBytes;
+    raw.width = clipped.width;
+    raw.height = clipped.height;
+    raw.size = static_cast<size_t>(clipped.height - 1) * raw.bytesPerLine + static_cast<size_t>(clipped.width) * pixelBytes;
+    return true;
+}
+
+bool rawFrameFits(const RawFrame &raw)
+{
+    if (!raw.data || raw.width <= 0 || raw.height <= 0)
+        return false;
+    int pixelBytes = rawPixelBytes(raw.pixelFormat);
+    if (pixelBytes == 0)
+        return raw.size > 0;
+    uint64_t rowBytes = static_cast<uint64_t>(raw.width) * pixelBytes;
+    return raw.bytesPerLine > 0 && static_cast<uint64_t>(raw.bytesPerLine) >= rowBytes &&
+           static_cast<uint64_t>(raw.height - 1) * raw.bytesPerLine + rowBytes <= raw.size;
+}
+
+bool convertRawFrame(const RawFrame &raw, cv::Mat &frame)
+{
+    void *data = const_cast<uint8_t *>(raw.data);
+    switch (raw.pixelFormat)
+    {
+    case V4L2_PIX_FMT_YUYV:
+        cv::cvtColor(cv::Mat(raw.height, raw.width, CV_8UC2, data, raw.bytesPerLine), frame, cv::COLOR_YUV2BGR_YUYV);
+        return true;
+    case V4L2_PIX_FMT_GREY:
+        cv::cvtColor(cv::Mat(raw.height, raw.width, CV_8UC1, data, raw.bytesPerLine), frame, cv::COLOR_GRAY2BGR);
+        return true;
+    case V4L2_PIX_FMT_Y16:
+        cv::Mat(raw.height, raw.width, CV_16UC1, data, raw.bytesPerLine).copyTo(frame);
+        return true;
+    case V4L2_PIX_FMT_Y10:
+    case V4L2_PIX_FMT_Y12:
+    {
+        // Right-aligned in 16 bits; scaled to full range like Y16
+        int shift = raw.pixelFormat == V4L2_PIX_FMT_Y10 ? 6 : 4;
+        cv::Mat(raw.height, raw.width, CV_16UC1, data, raw.bytesPerLine).convertTo(frame, CV_16U, 1 << shift);
+        return true;
+    }
+    case V4L2_PIX_FMT_MJPEG:
+        cv::imdecode(cv::Mat(1, static_cast<int>(raw.size), CV_8UC1, data), cv::IMREAD_COLOR, &frame);
+        return !frame.empty();
+    default:
+        return false;
+    }
+}
+
+V4L2FrameSource::V4L2FrameSource(int deviceIndex, const CaptureConfig &config)
+    : deviceIndex(deviceIndex), config(config), fd(-1), wakeFd(-1), bytesPerLine(0), selectionSupported(false)
+{
+}
+
+V4L2FrameSource::~V4L2FrameSource()
+{
+    close();
+}
+
+bool V4L2FrameSource::open()
+{
+    QString path = devicePath();
+    // Non-blocking so read() can drain every completed buffer after poll() wakes it
+    fd = ::open(path.toStdString().c_str(), O_RDWR | O_NONBLOCK);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0 || wakeFd < 0)
+    {
+        qWarning() << "Failed to open" << path << "for streaming";
+        close();
+        return false;
+    }
+
+    // Sensor cropping needs the selection API, which UVC drivers do not have. A crop
+    // left behind by an earlier run is undone first, so the negotiated mode is the full frame
+    cv::Rect currentCrop, unused;
+    selectionSupported = getSelection(fd, V4L2_SEL_TGT_CROP_DEFAULT, defaultCrop) &&
+                         getSelection(fd, V4L2_SEL_TGT_CROP, currentCrop);
+    if (selectionSupported && currentCrop != defaultCrop)
+        setSelection(fd, defaultCrop, unused);
+
+    if (config.policy != CapturePolicy::Current && !negotiateMode())
+        qInfo() << "Keeping the current mode of" << path;
+    if (!readMode())
+    {
+        qWarning() << "VIDIOC_G_FMT failed on" << path;
+        close();
+        return false;
+    }
+    fullSize = cv::Size(mode.width, mode.height);
+    sensorRegion = cv::Rect();
+    dequeueRegion = cv::Rect();
+
+    if (!startStreaming())
+    {
+        close();
+        return false;
+    }
+
+    resetTag();
+    restoreRegion();
+    describe();
+    qInfo() << "Streaming" << path << mode.describe() << "with" << buffers.size() << "buffers"
+            << (selectionSupported ? "and sensor cropping" : "and cropping at dequeue");
+    return true;
+}
+
+bool V4L2FrameSource::startStreaming()
+{
+    QString path = devicePath();
+    v4l2_requestbuffers request = {};
+    request.count = config.bufferCount > 0 ? config.bufferCount : minimumBufferCount(mode);
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_REQBUFS, &request) != 0 || request.count == 0)
+    {
+        qWarning() << "VIDIOC_REQBUFS failed on" << path;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < request.count; i++)
+    {
+        v4l2_buffer buffer = {};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = i;
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buffer) != 0)
+        {
+            qWarning() << "VIDIOC_QUERYBUF failed on" << path;
+            stopStreaming();
+            return false;
+        }
+        void *start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buffer.m.offset);
+        if (start == MAP_FAILED)
+        {
+            qWarning() << "Failed to map capture buffer" << i << "of" << path;
+            stopStreaming();
+            return false;
+        }
+        buffers.push_back({start, buffer.length});
+        if (xioctl(fd, VIDIOC_QBUF, &buffer) != 0)
+        {
+            qWarning() << "VIDIOC_QBUF failed on" << path;
+            stopStreaming();
+            return false;
+        }
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_STREAMON, &type) != 0)
+    {
+        qWarning() << "VIDIOC_STREAMON failed on" << path;
+        stopStreaming();
+        return false;
+    }
+    return true;
+}
+
+void V4L2FrameSource::stopStreaming()
+{
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(fd, VIDIOC_STREAMOFF, &type);
+    for (const Buffer &buffer : buffers)
+    {
+        munmap(buffer.start, buffer.length);
+    }
+    buffers.clear();
+
+    v4l2_requestbuffers request = {};
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    xioctl(fd, VIDIOC_REQBUFS, &request);
+}
+
+bool V4L2FrameSource::negotiateMode()
+{
+    v4l2_format format = {};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_FMT, &format) != 0)
+        return false;
+
+    // Without a preferred size the camera keeps its current one and only the
+    // format and rate are chosen
+    CaptureConfig preference = config;
+    if (preference.width <= 0 || preference.height <= 0)
+    {
+        preference.width = static_cast<int>(format.fmt.pix.width);
+        preference.height = static_cast<int>(format.fmt.pix.height);
+    }
+
+    std::vector<CaptureMode> modes = enumerateCaptureModes(fd);
+    CaptureMode chosen;
+    if (!selectCaptureMode(modes, preference, chosen))
+        return false;
+
+    format.fmt.pix.pixelformat = chosen.pixelFormat;
+    format.fmt.pix.width = static_cast<__u32>(chosen.width);
+    format.fmt.pix.height = static_cast<__u32>(chosen.height);
+    format.fmt.pix.field = V4L2_FIELD_ANY;
+    format.fmt.pix.bytesperline = 0;
+    format.fmt.pix.sizeimage = 0;
+    if (xioctl(fd, VIDIOC_S_FMT, &format) != 0)
+    {
+        qWarning() << "VIDIOC_S_FMT failed for" << chosen.describe() << "on" << devicePath();
+        return false;
+    }
+
+    if (chosen.fps() > 0.0)
+    {
+        v4l2_streamparm streamParm = {};
+        streamParm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        streamParm.parm.capture.timeperframe.numerator = chosen.intervalNumerator;
+        streamParm.parm.capture.timeperframe.denominator = chosen.intervalDenominator;
+        if (xioctl(fd, VIDIOC_S_PARM, &streamParm) != 0)
+            qWarning() << "VIDIOC_S_PARM failed for" << chosen.describe() << "on" << devicePath();
+    }
+
+    qInfo() << "Chose" << chosen.describe() << "from" << modes.size() << "modes of" << devicePath()
+            << "for policy" << capturePolicyName(config.policy);
+    return true;
+}
+
+bool V4L2FrameSource::readMode()
+{
+    // The driver may have adjusted the request, so what it reports is what streams
+    v4l2_format format = {};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_FMT, &format) != 0)
+        return false;
+    mode = CaptureMode();
+    mode.pixelFormat = format.fmt.pix.pixelformat;
+    mode.width = static_cast<int>(format.fmt.pix.width);
+    mode.height = static_cast<int>(format.fmt.pix.height);
+    bytesPerLine = static_cast<int>(format.fmt.pix.bytesperline);
+    if (bytesPerLine == 0)
+        bytesPerLine = mode.pixelFormat == V4L2_PIX_FMT_GREY ? mode.width : mode.width * 2;
+
+    v4l2_streamparm streamParm = {};
+    streamParm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_PARM, &streamParm) == 0)
+    {
+        mode.intervalNumerator = streamParm.parm.capture.timeperframe.numerator;
+        mode.intervalDenominator = streamParm.parm.capture.timeperframe.denominator;
+    }
+    return true;
+}
+
+void V4L2FrameSource::close()
+{
+    if (wakeFd >= 0)
+    {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+    if (fd < 0)
+        return;
+
+    stopStreaming();
+    ::close(fd);
+    fd = -1;
+    setModeDescription(QString());
+}
+
+bool V4L2FrameSource::isOpened() const
+{
+    return fd >= 0;
+}
+
+bool V4L2FrameSource::readFrame(cv::Mat &frame)
+{
+    if (fd < 0)
+        return false;
+
+    // Sleep until the driver completes a buffer, interrupt() is called or the timeout passes
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+    int ready;
+    do
+    {
+        ready = poll(fds, 2, POLL_TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+    if (fds[1].revents & POLLIN)
+    {
+        uint64_t wakeups;
+        [[maybe_unused]] ssize_t drained = ::read(wakeFd, &wakeups, sizeof(wakeups));
+        return false;
+    }
+    if (ready <= 0 || !(fds[0].revents & POLLIN))
+        return false;
+
+    // Dequeue every completed buffer so all of them are recorded, but convert only
+    // the newest: if processing fell behind, the pipeline skips to the present
+    StageTimer timer(metrics, PipelineStage::Capture);
+    v4l2_buffer latest = {};
+    bool haveLatest = false;
+    uint32_t skipped = 0;
+    for (;;)
+    {
+        v4l2_buffer buffer = {};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(fd, VIDIOC_DQBUF, &buffer) != 0)
+            break; // EAGAIN once the queue is empty
+
+        if (recorder && !(buffer.flags & V4L2_BUF_FLAG_ERROR))
+            recorder->appendFrame(rawFrame(buffer));
+        if (haveLatest)
+        {
+            xioctl(fd, VIDIOC_QBUF, &latest);
+            skipped++;
+        }
+        latest = buffer;
+        haveLatest = true;
+    }
+    if (!haveLatest)
+        return false;
+
+    // Recordings keep the whole frame; only the copy that is converted is cropped
+    RawFrame raw = rawFrame(latest);
+    if (!dequeueRegion.empty())
+        cropRawFrame(raw, dequeueRegion);
+    bool converted = !(latest.flags & V4L2_BUF_FLAG_ERROR) && convertRawFrame(raw, frame);
+    if (converted)
+        tagFrame(raw.timestampNs, raw.sequence, skipped);
+    else
+        skipFrames(skipped + 1);
+
+    // Hand the buffer back before processing starts
+    xioctl(fd, VIDIOC_QBUF, &latest);
+    return converted;
+}
+
+RawFrame V4L2FrameSource::rawFrame(const v4l2_buffer &buffer) const
+{
+    RawFrame raw;
+    raw.pixelFormat = mode.pixelFormat;
+    raw.width = mode.width;
+    raw.height = mode.height;
+    raw.bytesPerLine = bytesPerLine;
+    raw.sequence = buffer.sequence;
+    raw.data = static_cast<const uint8_t *>(buffers[buffer.index].start);
+    raw.size = buffer.bytesused;
+    if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        raw.timestampNs = static_cast<uint64_t>(buffer.timestamp.tv_sec) * 1000000000ULL + buffer.timestamp.tv_usec * 1000ULL;
+    else
+        raw.timestampNs = monotonicNowNs();
+    return raw;
+}
+
+void V4L2FrameSource::interrupt()
+{
+    if (wakeFd >= 0)
+    {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    }
+}
+
+QString V4L2FrameSource::devicePath() const
+{
+    return QString("/dev/video%1").arg(deviceIndex);
+}
+
+QString V4L2FrameSource::name() const
+{
+    return devicePath();
+}
+
+bool V4L2FrameSource::applyRegion(const cv::Rect &requested, cv::Rect &applied)
+{
+    // A JPEG can only be cut once it is decoded, which read() does anyway
+    if (fd < 0 || mode.isCompressed())
+        return false;
+    if (requested.empty() && sensorRegion.empty() && dequeueRegion.empty())
+    {
+        applied = cv::Rect();
+        return true;
+    }
+
+    if (selectionSupported)
+    {
+        if (setSensorCrop(requested, applied))
+        {
+            dequeueRegion = cv::Rect();
+            describe();
+            return true;
+        }
+        if (fd < 0)
+            return false;
+        qInfo() << devicePath() << "refused a sensor crop, cropping at dequeue instead";
+    }
+
+    // Cut before conversion, so only the region is converted and processed
+    cv::Rect region = rawRegion(requested, mode.pixelFormat, mode.width, mode.height);
+    if (region.size() == cv::Size(mode.width, mode.height))
+        region = cv::Rect();
+    dequeueRegion = region;
+    applied = region;
+    describe();
+    return true;
+}
+
+bool V4L2FrameSource::setSensorCrop(const cv::Rect &region, cv::Rect &applied)
+{
+    // Buffers are sized for the format, so the stream restarts around the change
+    stopStreaming();
+    bool cropped = writeSensorCrop(region, applied);
+    if (!cropped && !region.empty())
+        writeSensorCrop(cv::Rect(), applied);
+    if (!readMode() || !startStreaming())
+    {
+        qWarning() << "Failed to restart" << devicePath() << "after changing its crop";
+        close();
+        return false;
+    }
+    sensorRegion = cropped ? applied : cv::Rect();
+    return cropped;
+}
+
+bool V4L2FrameSource::writeSensorCrop(const cv::Rect &region, cv::Rect &applied)
+{
+    // Sensor pixels per frame pixel, for drivers that bin or scale the full frame
+    double scaleX = static_cast<double>(defaultCrop.width) / fullSize.width;
+    double scaleY = static_cast<double>(defaultCrop.height) / fullSize.height;
+    cv::Rect sensor = defaultCrop;
+    if (!region.empty())
+    {
+        sensor = cv::Rect(defaultCrop.x + cvRound(region.x * scaleX), defaultCrop.y + cvRound(region.y * scaleY),
+                          cvRound(region.width * scaleX), cvRound(region.height * scaleY));
+    }
+
+    cv::Rect selected;
+    if (!setSelection(fd, sensor, selected))
+        return false;
+
+    // Stream the crop unscaled: one frame pixel per sensor pixel the full frame had
+    v4l2_format format = {};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_FMT, &format) != 0)
+        return false;
+    format.fmt.pix.width = static_cast<__u32>(cvRound(selected.width / scaleX));
+    format.fmt.pix.height = static_cast<__u32>(cvRound(selected.height / scaleY));
+    format.fmt.pix.bytesperline = 0;
+    format.fmt.pix.sizeimage = 0;
+    if (xioctl(fd, VIDIOC_S_FMT, &format) != 0)
+        return false;
+
+    applied = cv::Rect(cvRound((selected.x - defaultCrop.x) / scaleX), cvRound((selected.y - defaultCrop.y) / scaleY),
+                       static_cast<int>(format.fmt.pix.width), static_cast<int>(format.fmt.pix.height));
+    applied &= cv::Rect(cv::Point(), fullSize);
+    if (applied.size() == fullSize)
+        applied = cv::Rect();
+    return true;
+}
+
+void V4L2FrameSource::describe()
+{
+    QString text = QString("%1, %2 buffers").arg(mode.describe()).arg(buffers.size());
+    if (!sensorRegion.empty())
+        text += QString(", sensor crop at %1,%2").arg(sensorRegion.x).arg(sensorRegion.y);
+    else if (!dequeueRegion.empty())
+        text += QString(", %1x%2 at %3,%4 cut at dequeue")
+                    .arg(dequeueRegion.width)
+                    .arg(dequeueRegion.height)
+                    .arg(dequeueRegion.x)
+                    .arg(dequeueRegion.y);
+    setModeDescription(text);
+}
+
+SyntheticFrameSource::SyntheticFrameSource(const SyntheticVeinConfig &config)
+    : generator(config), frameIndex(0), opened(false)
+{
+}
+
+bool SyntheticFrameSource::open()
+{
+    frameIndex = 0;
+    nextFrameTime = std::chrono::steady_clock::now();
+    resetTag();
+    const SyntheticVeinConfig &config = generator.getConfig();
+    QString text = QString("%1x%2 GREY").arg(config.width).arg(config.height);
+    if (config.fps > 0.0)
+        text += QString(" @ %1 fps").arg(config.fps, 0, 'f', 1);
+    setModeDescription(text);
+    opened = true;
+    return true;
+}
+
+void SyntheticFrameSource::close()
+{
+    opened = false;
+}
+
+bool SyntheticFrameSource::isOpened() const
+{
+    return opened;
+}
+
+bool SyntheticFrameSource::readFrame(cv::Mat &frame)
+{
+    if (!opened)
+        return false;
+
+    double fps = generator.getConfig().fps;
+    if (fps > 0.0)
+    {
+        // Wait for the frame's slot like a driver would; if we fell behind,
+        // restart the schedule instead of bursting to catch up
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / fps));
+        auto now = std::chrono::steady_clock::now();
+        if (nextFrameTime + interval < now)
+            nextFrameTime = now;
+        std::this_thread::sleep_until(nextFrameTime);
+        nextFrameTime += interval;
+    }
+
+    StageTimer timer(metrics, PipelineStage::Capture);
+    generator.render(frameIndex++, lastFrame);
+    uint64_t timestampNs = monotonicNowNs();
+    tagFrame(timestampNs, static_cast<uint32_t>(lastFrame.frameIndex));
+    if (recorder)
+    {
+        // Recorded as a GREY camera so the synthetic stream can be replayed like a real one
+        RawFrame raw;
+        raw.pixelFormat = V4L2_PIX_FMT_GREY;
+        raw.width = lastFrame.image.cols;
+        raw.height = lastFrame.image.rows;
+        raw.bytesPerLine = static_cast<int>(lastFrame.image.step);
+        raw.timestampNs = timestampNs;
+        raw.sequence = static_cast<uint32_t>(lastFrame.frameIndex);
+        raw.data = lastFrame.image.data;
+        raw.size = lastFrame.image.step * lastFrame.image.rows;
+        recorder->appendFrame(raw);
+    }
+    cv::cvtColor(lastFrame.image, frame, cv::COLOR_GRAY2BGR);
+    return true;
+}
+
+QString SyntheticFrameSource::name() const
+{
+    const SyntheticVeinConfig &config = generator.getConfig();
+    return QString("synthetic %1x%2 seed %3").arg(config.width).arg(config.height).arg(config.seed);
+}
+
+const SyntheticFrame &SyntheticFrameSource::groundTruth() const
+{
+    return lastFrame;
+}
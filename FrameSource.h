@@ -0,0 +1,226 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "SyntheticVeinGenerator.h"
+#include "CaptureMode.h"
+
+class FrameRecorder;
+class PipelineMetrics;
+struct v4l2_buffer;
+
+// A frame as the driver delivered it, before any conversion
+struct RawFrame
+{
+    uint32_t pixelFormat = 0; // V4L2_PIX_FMT_*
+    int width = 0;
+    int height = 0;
+    int bytesPerLine = 0;
+    uint64_t timestampNs = 0; // CLOCK_MONOTONIC
+    uint32_t sequence = 0;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+// Narrow raw to region of its image without copying, widened to whole YUYV pixel
+// pairs and clipped to the image; false for compressed formats
+bool cropRawFrame(RawFrame &raw, const cv::Rect &region);
+
+// Whether raw's data holds its whole width x height image, with rows bytesPerLine
+// apart; compressed formats only need some data
+bool rawFrameFits(const RawFrame &raw);
+
+// Convert a raw frame for the pipeline; false for unsupported formats.
+// YUYV, GREY and MJPEG become 8-bit BGR. Y10, Y12 and Y16 stay single channel
+// CV_16UC1 scaled to the full 16-bit range, so NIR depth survives until display.
+bool convertRawFrame(const RawFrame &raw, cv::Mat &frame);
+
+// CLOCK_MONOTONIC in nanoseconds, the clock V4L2 stamps buffers with
+uint64_t monotonicNowNs();
+
+// Where a frame came from, carried with it through the pipeline
+struct FrameTag
+{
+    uint64_t timestampNs = 0;   // Capture time on the CLOCK_MONOTONIC timeline
+    uint32_t sequence = 0;      // Driver sequence number
+    uint32_t sensorDropped = 0; // Frames lost by the driver since the previous read
+    uint32_t skipped = 0;       // Completed frames passed over since the previous read
+    cv::Rect region;            // Part of the full frame the frame shows, empty for all of it
+};
+
+// Where a camera's frames come from. Used from the capture thread unless noted;
+// read() blocks until the next frame is available.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() = default;
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool isOpened() const = 0;
+
+    // Read the next frame into frame, reusing its buffer where possible: 8-bit BGR,
+    // or CV_16UC1 for deep gray formats (see convertRawFrame)
+    bool read(cv::Mat &frame);
+
+    // Deliver only region of the full frame from the next read() on, an empty
+    // rect for all of it; safe from any thread. Sources crop as early as they
+    // can, and whatever they cannot is cropped from the converted frame.
+    void setRegion(const cv::Rect &region);
+
+    // Make a read() blocked in another thread return early; safe from any thread
+    virtual void interrupt() {}
+
+    // V4L2 device node for camera controls, empty when the source has none
+    virtual QString devicePath() const { return QString(); }
+
+    // Short description for logs
+    virtual QString name() const = 0;
+
+    // Format, size and nominal rate being streamed, empty when not known; safe from any thread
+    QString modeDescription() const;
+
+    // Raw frames are appended to recorder while it is recording; the recorder must outlive the source
+    void setRecorder(FrameRecorder *frameRecorder) { recorder = frameRecorder; }
+    // Time spent taking each frame from the source and converting it, without waiting
+    // for it, goes to the capture stage of metrics; metrics must outlive the source
+    void setMetrics(PipelineMetrics *pipelineMetrics) { metrics = pipelineMetrics; }
+
+    // Tag of the frame returned by the last successful read()
+    const FrameTag &tag() const { return lastTag; }
+
+    // Frames per second the source delivered, including ones read() passed over,
+    // measured over the last second of capture timestamps; safe from any thread
+    double deliveredFps() const { return deliveredRate.load(std::memory_order_relaxed); }
+
+protected:
+    // Read the next whole, or source-cropped, frame
+    virtual bool readFrame(cv::Mat &frame) = 0;
+
+    // Crop frames from now on to requested, in full frame coordinates, or stop
+    // cropping when it is empty. Returns false to leave cropping to read(), or
+    // true with applied set to the part of the full frame that frames will show.
+    virtual bool applyRegion(const cv::Rect &requested, cv::Rect &applied);
+
+    // Called by readFrame() for each frame it returns; skipped counts frames it dequeued but did not return
+    void tagFrame(uint64_t timestampNs, uint32_t sequence, uint32_t skipped = 0);
+    // Called by readFrame() for frames it dequeued but failed to return; the next tagged frame counts them as skipped
+    void skipFrames(uint32_t count);
+    void resetTag();
+    void setModeDescription(const QString &description);
+    // Have the next read() apply the last requested region again, e.g. after reopening
+    void restoreRegion();
+
+    FrameRecorder *recorder = nullptr;
+    PipelineMetrics *metrics = nullptr;
+
+private:
+    mutable std::mutex sharedMutex; // Guards what other threads set or read
+    cv::Rect pendingRegion;
+    bool regionPending = false;
+    cv::Rect activeRegion;
+    bool sourceCrops = false;
+    cv::Mat cropScratch;
+    QString description;
+
+    FrameTag lastTag;
+    bool tagged = false;
+    uint32_t pendingSkips = 0; // Frames passed over since the last tagged one without a tag of their own
+    uint64_t rateWindowStartNs = 0;
+    uint32_t rateWindowFrames = 0;
+    std::atomic<double> deliveredRate{0.0};
+};
+
+// A V4L2 camera streamed through mmap buffers. open() negotiates the format,
+// size and frame interval under the configured policy and requests the fewest
+// buffers that sustain that rate. read() sleeps in poll() on the device until
+// the driver completes a buffer, so each frame is dequeued as soon as it exists.
+// A region crops the sensor where the driver has the selection API, which saves
+// bus bandwidth as well as conversion; UVC cameras crop each buffer at dequeue.
+class V4L2FrameSource : public FrameSource
+{
+public:
+    explicit V4L2FrameSource(int deviceIndex, const CaptureConfig &config = CaptureConfig());
+    ~V4L2FrameSource() override;
+
+    bool open() override;
+    void close() override;
+    bool isOpened() const override;
+    void interrupt() override;
+    QString devicePath() const override;
+    QString name() const override;
+
+protected:
+    bool readFrame(cv::Mat &frame) override;
+    // On the sensor through the selection API when the driver has it, otherwise
+    // at dequeue, before conversion
+    bool applyRegion(const cv::Rect &requested, cv::Rect &applied) override;
+
+private:
+    struct Buffer
+    {
+        void *start;
+        size_t length;
+    };
+
+    RawFrame rawFrame(const v4l2_buffer &buffer) const;
+    // Switch the device to the mode the policy prefers; false leaves it as it was
+    bool negotiateMode();
+    // Read back the mode the driver settled on
+    bool readMode();
+    // Allocate, map and queue buffers and start the stream, or undo all of it
+    bool startStreaming();
+    void stopStreaming();
+    // Crop the sensor to region, or restore its default crop for an empty one,
+    // restarting the stream around the change. When the driver refuses the
+    // region the sensor is left uncropped.
+    bool setSensorCrop(const cv::Rect &region, cv::Rect &applied);
+    // Selection and format for setSensorCrop(), while the stream is off
+    bool writeSensorCrop(const cv::Rect &region, cv::Rect &applied);
+    void describe();
+
+    int deviceIndex;
+    CaptureConfig config;
+    CaptureMode mode;
+    int fd;
+    int wakeFd; // eventfd that interrupt() signals to end a poll early
+    int bytesPerLine;
+    std::vector<Buffer> buffers;
+
+    // Sensor crop rectangles are in sensor pixels; defaultCrop maps to fullSize
+    bool selectionSupported;
+    cv::Rect defaultCrop;
+    cv::Size fullSize;
+    cv::Rect sensorRegion;  // Region the sensor crops to, in full frame coordinates
+    cv::Rect dequeueRegion; // Region cut from each buffer when the sensor cannot crop
+};
+
+// Virtual camera backed by SyntheticVeinGenerator, paced at the configured rate
+class SyntheticFrameSource : public FrameSource
+{
+public:
+    explicit SyntheticFrameSource(const SyntheticVeinConfig &config);
+
+    bool open() override;
+    void close() override;
+    bool isOpened() const override;
+    QString name() const override;
+
+    // Ground truth of the frame returned by the last read(), always of the full frame
+    const SyntheticFrame &groundTruth() const;
+
+protected:
+    bool readFrame(cv::Mat &frame) override;
+
+private:
+    SyntheticVeinGenerator generator;
+    SyntheticFrame lastFrame;
+    int frameIndex;
+    bool opened;
+    std::chrono::steady_clock::time_point nextFrameTime;
+};
@@ -0,0 +1,146 @@
+#include "FrameStatistics.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+
+namespace
+{
+using namespace cv;
+
+// Sum and sum of squares of a 16-bit row; 8-bit moments come from the histogram
+void addRowMoments(const ushort *src, int width, uint64_t &sum, uint64_t &sumSq)
+{
+    int x = 0;
+#if CV_SIMD
+    v_uint32 vSum = vx_setzero_u32();
+    v_uint64 vSumSq = vx_setzero_u64();
+    for (; x <= width - v_uint16::nlanes; x += v_uint16::nlanes)
+    {
+        v_uint32 lo, hi;
+        v_expand(vx_load(src + x), lo, hi);
+        vSum += lo + hi;
+        v_uint64 sq0, sq1, sq2, sq3;
+        v_mul_expand(lo, lo, sq0, sq1);
+        v_mul_expand(hi, hi, sq2, sq3);
+        vSumSq += (sq0 + sq1) + (sq2 + sq3);
+    }
+    sum += v_reduce_sum(vSum);
+    uint64 lanes[v_uint64::nlanes];
+    v_store(lanes, vSumSq);
+    for (int i = 0; i < v_uint64::nlanes; i++)
+        sumSq += lanes[i];
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+    {
+        sum += src[x];
+        sumSq += static_cast<uint64_t>(src[x]) * src[x];
+    }
+}
+
+// Histogram one tile. Pixels inside the frame also count towards frameHist and the
+// moments; the mirrored edge counts towards the tile alone.
+template <typename T>
+void countTile(const Mat &gray, const Rect &rect, int shift, int bins, int *hist, int *frameHist,
+               uint64_t &sum, uint64_t &sumSq)
+{
+    const int insideRight = std::min(rect.x + rect.width, gray.cols);
+    const int insideBottom = std::min(rect.y + rect.height, gray.rows);
+    for (int y = rect.y; y < insideBottom; y++)
+    {
+        const T *row = gray.ptr<T>(y);
+        for (int x = rect.x; x < insideRight; x++)
+            hist[row[x] >> shift]++;
+        if constexpr (std::is_same<T, ushort>::value)
+        {
+            if (insideRight > rect.x)
+                addRowMoments(row + rect.x, insideRight - rect.x, sum, sumSq);
+        }
+    }
+    for (int i = 0; i < bins; i++)
+        frameHist[i] += hist[i];
+
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+    {
+        const T *row = gray.ptr<T>(borderInterpolate(y, gray.rows, BORDER_REFLECT_101));
+        int start = y < gray.rows ? std::max(insideRight, rect.x) : rect.x;
+        for (int x = start; x < rect.x + rect.width; x++)
+            hist[row[borderInterpolate(x, gray.cols, BORDER_REFLECT_101)] >> shift]++;
+    }
+}
+}
+
+void FrameStatistics::compute(const cv::Mat &gray, cv::Size tileGrid)
+{
+    CV_Assert(gray.type() == CV_8UC1 || gray.type() == CV_16UC1);
+    depth = gray.depth();
+    shift = depth == CV_16U ? DEEP_SHIFT : 0;
+    bins = (depth == CV_16U ? 65536 : 256) >> shift;
+    size = gray.size();
+    tiles = cv::Size(std::max(1, tileGrid.width), std::max(1, tileGrid.height));
+    tileSize = cv::Size((gray.cols + tiles.width - 1) / tiles.width, (gray.rows + tiles.height - 1) / tiles.height);
+
+    histogram.assign(bins, 0);
+    tileHistograms.assign(static_cast<size_t>(tiles.area()) * bins, 0);
+    uint64_t sum = 0;
+    uint64_t sumSq = 0;
+    std::mutex mergeMutex;
+    cv::parallel_for_(cv::Range(0, tiles.area()), [&](const cv::Range &range)
+                      {
+        std::vector<int> frameHist(bins, 0);
+        uint64_t partialSum = 0;
+        uint64_t partialSumSq = 0;
+        for (int tile = range.start; tile < range.end; tile++)
+        {
+            cv::Rect rect((tile % tiles.width) * tileSize.width, (tile / tiles.width) * tileSize.height,
+                          tileSize.width, tileSize.height);
+            int *hist = tileHistograms.data() + static_cast<size_t>(tile) * bins;
+            if (depth == CV_16U)
+                countTile<ushort>(gray, rect, shift, bins, hist, frameHist.data(), partialSum, partialSumSq);
+            else
+                countTile<uchar>(gray, rect, shift, bins, hist, frameHist.data(), partialSum, partialSumSq);
+        }
+
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        for (int i = 0; i < bins; i++)
+            histogram[i] += frameHist[i];
+        sum += partialSum;
+        sumSq += partialSumSq; });
+
+    if (depth == CV_8U)
+    {
+        for (int i = 0; i < bins; i++)
+        {
+            sum += static_cast<uint64_t>(i) * histogram[i];
+            sumSq += static_cast<uint64_t>(i) * i * histogram[i];
+        }
+    }
+    double pixels = std::max(1.0, static_cast<double>(size.area()));
+    mean = sum / pixels;
+    variance = std::max(0.0, sumSq / pixels - mean * mean);
+}
+
+double FrameStatistics::percentile(double fraction) const
+{
+    if (!isValid() || size.area() == 0)
+        return 0.0;
+    int64_t target = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * size.area())));
+    int64_t count = 0;
+    for (int i = 0; i < bins; i++)
+    {
+        count += histogram[i];
+        if (count >= target)
+            return (i << shift) + ((1 << shift) - 1) * 0.5; // Middle of the bin
+    }
+    return ((bins - 1) << shift) + ((1 << shift) - 1) * 0.5;
+}
+
+double FrameStatistics::saturatedFraction() const
+{
+    if (!isValid() || size.area() == 0)
+        return 0.0;
+    return static_cast<double>(histogram[bins - 1]) / size.area();
+}
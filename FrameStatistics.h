@@ -0,0 +1,38 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Histograms and moments of one gray frame, gathered in a single pass and shared
+// by every stage that needs them, so none of them rescans the frame. 8-bit frames
+// are binned per gray level, 16-bit frames at 12-bit resolution.
+struct FrameStatistics
+{
+    static constexpr int DEEP_SHIFT = 4; // 16-bit gray levels per bin, as a shift
+
+    int depth = -1; // CV_8U or CV_16U, -1 before the first compute()
+    int shift = 0;  // A gray level's bin is level >> shift
+    int bins = 0;
+    cv::Size size;
+    // Tiles cover the frame with its ragged right and bottom edge mirrored, as CLAHE
+    // expects, so every tile holds tileSize.area() pixels
+    cv::Size tiles;
+    cv::Size tileSize;
+
+    std::vector<int> histogram;      // Whole frame, edge mirroring excluded
+    std::vector<int> tileHistograms; // bins entries per tile, tiles in row order
+    double mean = 0.0;               // In the frame's gray levels
+    double variance = 0.0;
+
+    // Gather everything for a CV_8UC1 or CV_16UC1 frame over a grid of tiles,
+    // reusing the buffers of the previous frame
+    void compute(const cv::Mat &gray, cv::Size tileGrid);
+
+    bool isValid() const { return depth >= 0; }
+    const int *tileHistogram(int tile) const { return tileHistograms.data() + static_cast<size_t>(tile) * bins; }
+
+    // Gray level at or below which fraction of the pixels lie, fraction in [0, 1]
+    double percentile(double fraction) const;
+    // Share of the pixels in the top bin, e.g. of an overexposed sensor
+    double saturatedFraction() const;
+};
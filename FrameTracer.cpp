@@ -0,0 +1,202 @@
+#include "FrameTracer.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t RING_CAPACITY = 1 << 15;          // Events kept per thread, power of two
+constexpr int64_t SPIKE_COOLDOWN_NS = 5000000000LL; // One automatic dump per 5 s at most
+
+struct TraceEvent
+{
+    const char *name;
+    int64_t beginNs;
+    int64_t endNs;
+    quint64 frameId;
+};
+
+struct ThreadRing
+{
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[RING_CAPACITY]};
+    std::atomic<uint64_t> head{0};
+    std::atomic<bool> inUse{true};
+    int threadId = 0;
+    QString threadName;  // Guarded by registryMutex
+    quint64 frameId = 0; // Owner thread only
+};
+
+// Rings outlive their threads; a ring is handed to a new thread once its owner exits
+QMutex registryMutex;
+std::vector<std::unique_ptr<ThreadRing>> rings;
+int nextThreadId = 1;
+
+struct RingHandle
+{
+    ThreadRing *ring = nullptr;
+    ~RingHandle()
+    {
+        if (ring)
+            ring->inUse.store(false, std::memory_order_release);
+    }
+};
+thread_local RingHandle threadRing;
+
+ThreadRing *currentRing()
+{
+    if (threadRing.ring)
+        return threadRing.ring;
+
+    QMutexLocker lock(&registryMutex);
+    ThreadRing *ring = nullptr;
+    for (auto &candidate : rings)
+    {
+        bool expected = false;
+        if (candidate->inUse.compare_exchange_strong(expected, true))
+        {
+            ring = candidate.get();
+            ring->head.store(0, std::memory_order_relaxed);
+            break;
+        }
+    }
+    if (!ring)
+    {
+        rings.push_back(std::make_unique<ThreadRing>());
+        ring = rings.back().get();
+    }
+    ring->threadId = nextThreadId++;
+    ring->threadName = QString("thread %1").arg(ring->threadId);
+    ring->frameId = 0;
+    threadRing.ring = ring;
+    return ring;
+}
+
+int64_t toNs(FrameTracer::Clock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+}
+
+std::atomic<bool> FrameTracer::enabledFlag{false};
+
+void FrameTracer::setEnabled(bool enable)
+{
+    enabledFlag.store(enable, std::memory_order_relaxed);
+}
+
+void FrameTracer::setThreadName(const QString &name)
+{
+    ThreadRing *ring = currentRing();
+    QMutexLocker lock(&registryMutex);
+    ring->threadName = name;
+}
+
+void FrameTracer::setFrameId(quint64 frameId)
+{
+    currentRing()->frameId = frameId;
+}
+
+void FrameTracer::record(const char *name, Clock::time_point begin, Clock::time_point end)
+{
+    ThreadRing *ring = currentRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head & (RING_CAPACITY - 1)] = {name, toNs(begin), toNs(end), ring->frameId};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+int FrameTracer::writeChromeTrace(const QString &path)
+{
+    QJsonArray traceEvents;
+    qint64 pid = QCoreApplication::applicationPid();
+    int written = 0;
+
+    {
+        QMutexLocker lock(&registryMutex);
+        std::vector<TraceEvent> snapshot;
+        for (const auto &ring : rings)
+        {
+            QJsonObject threadName;
+            threadName["name"] = "thread_name";
+            threadName["ph"] = "M";
+            threadName["pid"] = pid;
+            threadName["tid"] = ring->threadId;
+            threadName["args"] = QJsonObject{{"name", ring->threadName}};
+            traceEvents.append(threadName);
+
+            // The owner keeps writing while we copy; slots it reached again may be torn and are dropped
+            uint64_t end = ring->head.load(std::memory_order_acquire);
+            uint64_t start = end > RING_CAPACITY ? end - RING_CAPACITY : 0;
+            snapshot.assign(end - start, TraceEvent());
+            for (uint64_t i = start; i < end; i++)
+                snapshot[i - start] = ring->events[i & (RING_CAPACITY - 1)];
+            uint64_t after = ring->head.load(std::memory_order_acquire);
+            uint64_t firstValid = after > RING_CAPACITY ? after - RING_CAPACITY : 0;
+
+            for (uint64_t i = std::max(start, firstValid); i < end; i++)
+            {
+                const TraceEvent &event = snapshot[i - start];
+                QJsonObject entry;
+                entry["name"] = event.name;
+                entry["cat"] = "pipeline";
+                entry["ph"] = "X";
+                entry["ts"] = event.beginNs / 1000.0;
+                entry["dur"] = (event.endNs - event.beginNs) / 1000.0;
+                entry["pid"] = pid;
+                entry["tid"] = ring->threadId;
+                entry["args"] = QJsonObject{{"frame", static_cast<qint64>(event.frameId)}};
+                traceEvents.append(entry);
+                written++;
+            }
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Failed to write trace" << path;
+        return 0;
+    }
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    qInfo() << "Wrote" << written << "trace events to" << path;
+    return written;
+}
+
+TraceSpikeTrigger::TraceSpikeTrigger()
+    : threshold(0.0), lastTriggerNs(0)
+{
+}
+
+void TraceSpikeTrigger::setThresholdMs(double thresholdMs)
+{
+    threshold.store(thresholdMs, std::memory_order_relaxed);
+}
+
+double TraceSpikeTrigger::thresholdMs() const
+{
+    return threshold.load(std::memory_order_relaxed);
+}
+
+bool TraceSpikeTrigger::check(double frameMs)
+{
+    double limit = threshold.load(std::memory_order_relaxed);
+    if (limit <= 0.0 || frameMs < limit || !FrameTracer::enabled())
+        return false;
+
+    int64_t now = toNs(FrameTracer::Clock::now());
+    int64_t last = lastTriggerNs.load(std::memory_order_relaxed);
+    if (last != 0 && now - last < SPIKE_COOLDOWN_NS)
+        return false;
+    return lastTriggerNs.compare_exchange_strong(last, now);
+}
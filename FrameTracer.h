@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Process-wide timeline tracing for the frame pipeline.
+// Each thread writes complete (begin + end) events into its own ring buffer, so
+// recording is lock-free and costs one relaxed load while tracing is off. Events
+// carry the frame id the thread is working on. writeChromeTrace() merges the
+// rings into Chrome trace-event JSON that Perfetto and chrome://tracing open.
+class FrameTracer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static void setEnabled(bool enable);
+    static bool enabled()
+    {
+        return enabledFlag.load(std::memory_order_relaxed);
+    }
+
+    // Name shown for the calling thread's track
+    static void setThreadName(const QString &name);
+
+    // Frame id attached to the calling thread's following events
+    static void setFrameId(quint64 frameId);
+
+    // name must be a string literal or otherwise outlive the tracer
+    static void record(const char *name, Clock::time_point begin, Clock::time_point end);
+
+    // Write everything still in the rings; returns the number of events written
+    static int writeChromeTrace(const QString &path);
+
+private:
+    static std::atomic<bool> enabledFlag;
+};
+
+// Traces the lifetime of a scope when tracing is on
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : name(name), traced(FrameTracer::enabled())
+    {
+        if (traced)
+            begin = FrameTracer::Clock::now();
+    }
+
+    ~TraceScope()
+    {
+        if (traced)
+            FrameTracer::record(name, begin, FrameTracer::Clock::now());
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    bool traced;
+    FrameTracer::Clock::time_point begin;
+};
+
+// Decides when a slow frame should dump the trace, at most once per cooldown
+class TraceSpikeTrigger
+{
+public:
+    TraceSpikeTrigger();
+
+    // 0 disables the trigger
+    void setThresholdMs(double thresholdMs);
+    double thresholdMs() const;
+
+    // True when frameMs is a spike worth dumping; safe from any thread
+    bool check(double frameMs);
+
+private:
+    std::atomic<double> threshold;
+    std::atomic<int64_t> lastTriggerNs;
+};
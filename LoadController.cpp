@@ -0,0 +1,161 @@
+#include "LoadController.h"
+#include "VeinKernels.h"
+#include <QDebug>
+
+namespace
+{
+constexpr double SMOOTHING = 0.1;         // Weight of the newest frame in the moving average
+constexpr double HEADROOM_RATIO = 0.6;    // Step up only when well inside the budget
+constexpr int OVER_BUDGET_FRAMES = 15;    // Sustained overload before shedding
+constexpr int UNDER_BUDGET_FRAMES = 90;   // Sustained headroom before restoring
+constexpr int SETTLE_FRAMES = 30;         // Let averages reflect a change before the next one
+}
+
+LoadController::LoadController()
+    : currentLevel(FullQuality), smoothedFrameMs(-1.0), smoothedDetectionMs(0.0),
+      overBudgetFrames(0), underBudgetFrames(0), settleFrames(0), sceneIdle(false)
+{
+}
+
+void LoadController::setConfig(const LoadSheddingConfig &newConfig)
+{
+    config = newConfig;
+    if (!config.enabled)
+        sceneIdle = false;
+    if (!config.enabled && currentLevel.load() != FullQuality)
+    {
+        changeLevel(FullQuality, "load shedding disabled");
+    }
+}
+
+void LoadController::recordFrame(double frameMs, double detectionMs)
+{
+    if (smoothedFrameMs < 0.0)
+    {
+        smoothedFrameMs = frameMs;
+        smoothedDetectionMs = detectionMs;
+    }
+    else
+    {
+        smoothedFrameMs += SMOOTHING * (frameMs - smoothedFrameMs);
+        smoothedDetectionMs += SMOOTHING * (detectionMs - smoothedDetectionMs);
+    }
+
+    if (!config.enabled || config.targetFps <= 0.0)
+        return;
+
+    if (settleFrames > 0)
+    {
+        settleFrames--;
+        return;
+    }
+
+    double budgetMs = 1000.0 / config.targetFps;
+    int level = currentLevel.load();
+
+    if (smoothedFrameMs > budgetMs)
+    {
+        underBudgetFrames = 0;
+        if (++overBudgetFrames >= OVER_BUDGET_FRAMES && level + 1 < LevelCount)
+        {
+            changeLevel(level + 1, "over budget");
+        }
+    }
+    else if (smoothedFrameMs < budgetMs * HEADROOM_RATIO)
+    {
+        overBudgetFrames = 0;
+        if (++underBudgetFrames >= UNDER_BUDGET_FRAMES && level > FullQuality)
+        {
+            changeLevel(level - 1, "headroom");
+        }
+    }
+    else
+    {
+        overBudgetFrames = 0;
+        underBudgetFrames = 0;
+    }
+}
+
+void LoadController::recordScene(const FrameStatistics &stats)
+{
+    if (!stats.isValid())
+        return;
+    double spread = (stats.percentile(0.95) - stats.percentile(0.05)) / grayLevelScale(stats.depth);
+    bool idle = config.enabled && spread < config.idleSpread;
+    if (idle != sceneIdle)
+    {
+        qInfo().nospace() << "Load shedding " << (idle ? "scene idle" : "scene active") << " (spread " << spread
+                          << " gray levels, mean " << stats.mean / grayLevelScale(stats.depth) << ")";
+        sceneIdle = idle;
+    }
+}
+
+void LoadController::changeLevel(int newLevel, const char *reason)
+{
+    int oldLevel = currentLevel.exchange(newLevel);
+    qInfo().nospace() << "Load shedding " << reason << ": " << levelName(oldLevel) << " -> " << levelName(newLevel)
+                      << " (frame " << smoothedFrameMs << " ms, detection " << smoothedDetectionMs
+                      << " ms, budget " << (config.targetFps > 0.0 ? 1000.0 / config.targetFps : 0.0) << " ms)";
+    overBudgetFrames = 0;
+    underBudgetFrames = 0;
+    settleFrames = SETTLE_FRAMES;
+}
+
+void LoadController::apply(VeinProcessingConfig &veinConfig, TrackerConfig &trackerConfig, double &processingScale) const
+{
+    // Levels are cumulative: each one keeps the degradations below it
+    int level = currentLevel.load();
+    processingScale = 1.0;
+
+    // Overload hands the frames between detector runs to the tracker. An empty scene
+    // needs detection only often enough to notice an arm arriving, tracked or not
+    if (level >= SkipDetectionFrames)
+    {
+        trackerConfig.enabled = true;
+    }
+    if (level >= SkipDetectionFrames || sceneIdle)
+    {
+        trackerConfig.detectionInterval = std::max(2, trackerConfig.detectionInterval * 2);
+    }
+    if (level >= ReducedResolution)
+    {
+        processingScale = 0.5;
+    }
+    if (level >= CheapBilateral)
+    {
+        veinConfig.bilateralDiameter = std::min(veinConfig.bilateralDiameter, 5);
+    }
+    if (level >= NoVeinEnhancement)
+    {
+        veinConfig.veinEnhancementEnabled = false;
+    }
+}
+
+bool LoadController::idleScene() const
+{
+    return sceneIdle;
+}
+
+int LoadController::level() const
+{
+    return currentLevel.load();
+}
+
+const char *LoadController::levelName(int level)
+{
+    switch (level)
+    {
+    case FullQuality:
+        return "full quality";
+    case SkipDetectionFrames:
+        return "skip detection frames";
+    case ReducedResolution:
+        return "reduced resolution";
+    case CheapBilateral:
+        return "cheap bilateral";
+    case NoVeinEnhancement:
+        return "no vein enhancement";
+    default:
+        return "unknown";
+    }
+}
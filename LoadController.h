@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include "VeinProcessor.h"
+#include "VeinTracker.h"
+#include "FrameStatistics.h"
+
+// Load shedding settings
+struct LoadSheddingConfig
+{
+    bool enabled = true;
+    double targetFps = 30.0; // Processing budget per frame is 1000 / targetFps ms
+    // A frame whose 5th to 95th percentile spread is under this many gray levels
+    // shows no arm, and detection runs at the reduced rate until one appears; 0 disables
+    double idleSpread = 8.0;
+};
+
+// Feedback controller that holds processing inside the frame budget.
+// It tracks smoothed per-frame and detection latency and steps through a ranked
+// list of degradations when over budget, stepping back once there is headroom.
+// Every level change is logged with the latency that caused it.
+class LoadController
+{
+public:
+    enum Level
+    {
+        FullQuality = 0,
+        SkipDetectionFrames, // Run the detector less often, tracker fills the gaps
+        ReducedResolution,   // Process at half resolution
+        CheapBilateral,      // Smaller bilateral kernel
+        NoVeinEnhancement,   // Skip the Laplacian enhancement stage
+        LevelCount
+    };
+
+    LoadController();
+
+    void setConfig(const LoadSheddingConfig &newConfig);
+
+    // Record latencies of one processed frame in milliseconds
+    void recordFrame(double frameMs, double detectionMs);
+
+    // Record the statistics of a frame the vein chain processed
+    void recordScene(const FrameStatistics &stats);
+
+    // Apply the current degradations to this frame's settings
+    void apply(VeinProcessingConfig &veinConfig, TrackerConfig &trackerConfig, double &processingScale) const;
+
+    // The last recorded scene showed nothing to detect; detector runs may be spaced
+    // by the interval apply() gives even when nothing is tracked
+    bool idleScene() const;
+
+    // Safe to read from any thread
+    int level() const;
+    static const char *levelName(int level);
+
+private:
+    void changeLevel(int newLevel, const char *reason);
+
+    LoadSheddingConfig config;
+    std::atomic<int> currentLevel;
+    double smoothedFrameMs;
+    double smoothedDetectionMs;
+    int overBudgetFrames;
+    int underBudgetFrames;
+    int settleFrames; // Frames to wait after a change before deciding again
+    bool sceneIdle;   // The last frame with statistics showed nothing to detect
+};
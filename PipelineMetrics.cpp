@@ -0,0 +1,376 @@
+#include "PipelineMetrics.h"
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return static_cast<int>(value);
+
+    // Group by the highest set bit, then take the next SUB_BUCKET_BITS bits
+    int msb = 63 - __builtin_clzll(value);
+    int group = msb - SUB_BUCKET_BITS + 1;
+    int sub = static_cast<int>((value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return group * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    int group = index / SUB_BUCKETS;
+    int sub = index % SUB_BUCKETS;
+    if (group == 0)
+        return static_cast<uint64_t>(sub);
+
+    int shift = group - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + sub) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t previous = maxValue.load(std::memory_order_relaxed);
+    while (nanoseconds > previous &&
+           !maxValue.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const
+{
+    Summary result;
+    result.count = count.load(std::memory_order_relaxed);
+    if (result.count == 0)
+        return result;
+
+    const double NS_PER_MS = 1e6;
+    uint64_t maxNs = maxValue.load(std::memory_order_relaxed);
+    result.meanMs = total.load(std::memory_order_relaxed) / NS_PER_MS / result.count;
+    result.maxMs = maxNs / NS_PER_MS;
+
+    // Walk the buckets once, filling percentiles in ascending order
+    const double quantiles[] = {0.50, 0.95, 0.99};
+    double *outputs[] = {&result.p50Ms, &result.p95Ms, &result.p99Ms};
+    int next = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT && next < 3; i++)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        while (next < 3 && seen >= static_cast<uint64_t>(std::ceil(quantiles[next] * result.count)))
+        {
+            *outputs[next] = std::min(bucketUpperBound(i), maxNs) / NS_PER_MS;
+            next++;
+        }
+    }
+    // Samples recorded while walking can leave the tail unfilled
+    for (; next < 3; next++)
+    {
+        *outputs[next] = result.maxMs;
+    }
+    return result;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+AllocationStats::AllocationStats()
+{
+    reset();
+}
+
+void AllocationStats::record(const AllocationTracker::Counts &counts)
+{
+    samples.fetch_add(1, std::memory_order_relaxed);
+    allocations.fetch_add(counts.allocations, std::memory_order_relaxed);
+    bytes.fetch_add(counts.bytes, std::memory_order_relaxed);
+
+    uint64_t previous = maxAllocations.load(std::memory_order_relaxed);
+    while (counts.allocations > previous &&
+           !maxAllocations.compare_exchange_weak(previous, counts.allocations, std::memory_order_relaxed))
+    {
+    }
+}
+
+AllocationStats::Summary AllocationStats::summary() const
+{
+    Summary result;
+    result.samples = samples.load(std::memory_order_relaxed);
+    if (result.samples == 0)
+        return result;
+    result.meanAllocations = static_cast<double>(allocations.load(std::memory_order_relaxed)) / result.samples;
+    result.meanBytes = static_cast<double>(bytes.load(std::memory_order_relaxed)) / result.samples;
+    result.maxAllocations = maxAllocations.load(std::memory_order_relaxed);
+    return result;
+}
+
+void AllocationStats::reset()
+{
+    samples.store(0, std::memory_order_relaxed);
+    allocations.store(0, std::memory_order_relaxed);
+    bytes.store(0, std::memory_order_relaxed);
+    maxAllocations.store(0, std::memory_order_relaxed);
+}
+
+LatencyHistogram &PipelineMetrics::stage(PipelineStage stage)
+{
+    return histograms[static_cast<size_t>(stage)];
+}
+
+const LatencyHistogram &PipelineMetrics::stage(PipelineStage stage) const
+{
+    return histograms[static_cast<size_t>(stage)];
+}
+
+AllocationStats &PipelineMetrics::allocations(PipelineStage stage)
+{
+    return stageAllocations[static_cast<size_t>(stage)];
+}
+
+const AllocationStats &PipelineMetrics::allocations(PipelineStage stage) const
+{
+    return stageAllocations[static_cast<size_t>(stage)];
+}
+
+AllocationStats &PipelineMetrics::frameAllocations()
+{
+    return frameTotals;
+}
+
+const AllocationStats &PipelineMetrics::frameAllocations() const
+{
+    return frameTotals;
+}
+
+LatencyHistogram &PipelineMetrics::frameAge(FrameMilestone milestone)
+{
+    return frameAges[static_cast<size_t>(milestone)];
+}
+
+const LatencyHistogram &PipelineMetrics::frameAge(FrameMilestone milestone) const
+{
+    return frameAges[static_cast<size_t>(milestone)];
+}
+
+const char *PipelineMetrics::milestoneName(FrameMilestone milestone)
+{
+    switch (milestone)
+    {
+    case FrameMilestone::Detected:
+        return "detected";
+    case FrameMilestone::Processed:
+        return "processed";
+    case FrameMilestone::Presented:
+        return "presented";
+    default:
+        return "unknown";
+    }
+}
+
+void PipelineMetrics::recordDrops(uint64_t sensor, uint64_t pipeline)
+{
+    if (sensor)
+        sensorDropCount.fetch_add(sensor, std::memory_order_relaxed);
+    if (pipeline)
+        pipelineDropCount.fetch_add(pipeline, std::memory_order_relaxed);
+}
+
+uint64_t PipelineMetrics::sensorDrops() const
+{
+    return sensorDropCount.load(std::memory_order_relaxed);
+}
+
+uint64_t PipelineMetrics::pipelineDrops() const
+{
+    return pipelineDropCount.load(std::memory_order_relaxed);
+}
+
+const char *PipelineMetrics::stageName(PipelineStage stage)
+{
+    switch (stage)
+    {
+    case PipelineStage::Capture:
+        return "capture";
+    case PipelineStage::FlatField:
+        return "flatfield";
+    case PipelineStage::MedianFilter:
+        return "median";
+    case PipelineStage::GaussianFilter:
+        return "gaussian";
+    case PipelineStage::BilateralFilter:
+        return "bilateral";
+    case PipelineStage::TemporalDenoise:
+        return "temporal";
+    case PipelineStage::Statistics:
+        return "statistics";
+    case PipelineStage::Clahe:
+        return "clahe";
+    case PipelineStage::Contrast:
+        return "contrast";
+    case PipelineStage::VeinEnhancement:
+        return "enhancement";
+    case PipelineStage::AdaptiveThreshold:
+        return "threshold";
+    case PipelineStage::FusedStages:
+        return "fused";
+    case PipelineStage::Morphology:
+        return "morphology";
+    case PipelineStage::VeinRegions:
+        return "regions";
+    case PipelineStage::Skeleton:
+        return "skeleton";
+    case PipelineStage::Detection:
+        return "detection";
+    case PipelineStage::Tracking:
+        return "tracking";
+    case PipelineStage::Drawing:
+        return "drawing";
+    case PipelineStage::Presentation:
+        return "presentation";
+    default:
+        return "unknown";
+    }
+}
+
+QString PipelineMetrics::formatTable() const
+{
+    QString table = QString("%1 %2 %3 %4 %5 %6 %7\n")
+                        .arg("stage", -12)
+                        .arg("count", 8)
+                        .arg("mean", 8)
+                        .arg("p50", 8)
+                        .arg("p95", 8)
+                        .arg("p99", 8)
+                        .arg("max", 8);
+
+    auto latencyRow = [](const QString &name, const LatencyHistogram::Summary &s)
+    {
+        return QString("%1 %2 %3 %4 %5 %6 %7\n")
+            .arg(name, -12)
+            .arg(static_cast<qulonglong>(s.count), 8)
+            .arg(s.meanMs, 8, 'f', 2)
+            .arg(s.p50Ms, 8, 'f', 2)
+            .arg(s.p95Ms, 8, 'f', 2)
+            .arg(s.p99Ms, 8, 'f', 2)
+            .arg(s.maxMs, 8, 'f', 2);
+    };
+    for (size_t i = 0; i < histograms.size(); i++)
+    {
+        LatencyHistogram::Summary s = histograms[i].summary();
+        if (s.count > 0)
+            table += latencyRow(stageName(static_cast<PipelineStage>(i)), s);
+    }
+
+    // Glass-to-glass: how long after capture frames reach each milestone
+    for (size_t i = 0; i < frameAges.size(); i++)
+    {
+        LatencyHistogram::Summary s = frameAges[i].summary();
+        if (s.count > 0)
+            table += latencyRow(QString("to %1").arg(milestoneName(static_cast<FrameMilestone>(i))), s);
+    }
+    uint64_t sensor = sensorDrops();
+    uint64_t pipeline = pipelineDrops();
+    if (sensor || pipeline)
+        table += QString("drops: sensor %1, pipeline %2\n").arg(static_cast<qulonglong>(sensor)).arg(static_cast<qulonglong>(pipeline));
+
+    AllocationStats::Summary frame = frameTotals.summary();
+    bool anyCounted = frame.samples > 0;
+    for (const AllocationStats &stats : stageAllocations)
+        anyCounted = anyCounted || stats.summary().samples > 0;
+    if (!anyCounted)
+        return table;
+
+    // Allocations per call; a stage runs at most once per frame
+    table += QString("\n%1 %2 %3 %4\n").arg("allocations", -12).arg("mean", 8).arg("KB", 8).arg("max", 8);
+    auto allocationRow = [](const QString &name, const AllocationStats::Summary &a)
+    {
+        return QString("%1 %2 %3 %4\n")
+            .arg(name, -12)
+            .arg(a.meanAllocations, 8, 'f', 1)
+            .arg(a.meanBytes / 1024.0, 8, 'f', 1)
+            .arg(static_cast<qulonglong>(a.maxAllocations), 8);
+    };
+    for (size_t i = 0; i < stageAllocations.size(); i++)
+    {
+        AllocationStats::Summary a = stageAllocations[i].summary();
+        if (a.samples > 0)
+            table += allocationRow(stageName(static_cast<PipelineStage>(i)), a);
+    }
+    if (frame.samples > 0)
+        table += allocationRow("frame", frame);
+    return table;
+}
+
+QJsonObject PipelineMetrics::toJson() const
+{
+    QJsonObject stages;
+    for (size_t i = 0; i < histograms.size(); i++)
+    {
+        LatencyHistogram::Summary s = histograms[i].summary();
+        if (s.count == 0)
+            continue;
+        QJsonObject stage;
+        stage["count"] = static_cast<qint64>(s.count);
+        stage["mean_ms"] = s.meanMs;
+        stage["p50_ms"] = s.p50Ms;
+        stage["p95_ms"] = s.p95Ms;
+        stage["p99_ms"] = s.p99Ms;
+        stage["max_ms"] = s.maxMs;
+        AllocationStats::Summary a = stageAllocations[i].summary();
+        if (a.samples > 0)
+        {
+            stage["allocations_mean"] = a.meanAllocations;
+            stage["allocated_bytes_mean"] = a.meanBytes;
+            stage["allocations_max"] = static_cast<qint64>(a.maxAllocations);
+        }
+        stages[stageName(static_cast<PipelineStage>(i))] = stage;
+    }
+    for (size_t i = 0; i < frameAges.size(); i++)
+    {
+        LatencyHistogram::Summary s = frameAges[i].summary();
+        if (s.count == 0)
+            continue;
+        QJsonObject age;
+        age["count"] = static_cast<qint64>(s.count);
+        age["mean_ms"] = s.meanMs;
+        age["p50_ms"] = s.p50Ms;
+        age["p95_ms"] = s.p95Ms;
+        age["p99_ms"] = s.p99Ms;
+        age["max_ms"] = s.maxMs;
+        stages[QString("capture_to_%1").arg(milestoneName(static_cast<FrameMilestone>(i)))] = age;
+    }
+    return stages;
+}
+
+void PipelineMetrics::reset()
+{
+    for (auto &histogram : histograms)
+    {
+        histogram.reset();
+    }
+    for (auto &stats : stageAllocations)
+    {
+        stats.reset();
+    }
+    frameTotals.reset();
+    for (auto &histogram : frameAges)
+    {
+        histogram.reset();
+    }
+    sensorDropCount.store(0, std::memory_order_relaxed);
+    pipelineDropCount.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <QString>
+#include <QJsonObject>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "AllocationTracker.h"
+#include "FrameTracer.h"
+
+// Pipeline stages with their own latency histogram
+enum class PipelineStage
+{
+    Capture,
+    FlatField,
+    MedianFilter,
+    GaussianFilter,
+    BilateralFilter,
+    TemporalDenoise,
+    Statistics,
+    Clahe,
+    Contrast,
+    VeinEnhancement,
+    AdaptiveThreshold,
+    FusedStages,
+    Morphology,
+    VeinRegions,
+    Skeleton,
+    Detection,
+    Tracking,
+    Drawing,
+    Presentation,
+    Count
+};
+
+// Points where a frame's age since capture is measured
+enum class FrameMilestone
+{
+    Detected,  // Detector finished with it
+    Processed, // Handed to the presenter
+    Presented, // Handed to the preview widget
+    Count
+};
+
+// HDR-style latency histogram in nanoseconds.
+// Buckets are log-linear: 16 linear sub-buckets per power of two, so any recorded
+// value is reported within 1/16 of its true size from 1 ns up to hours. Recording is
+// a few relaxed atomic adds and safe from any thread without locking.
+class LatencyHistogram
+{
+public:
+    struct Summary
+    {
+        uint64_t count = 0;
+        double meanMs = 0.0;
+        double p50Ms = 0.0;
+        double p95Ms = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+    LatencyHistogram();
+
+    void record(uint64_t nanoseconds);
+    Summary summary() const;
+    void reset();
+
+private:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> maxValue;
+};
+
+// Heap allocations made by one stage or frame, accumulated over samples
+class AllocationStats
+{
+public:
+    struct Summary
+    {
+        uint64_t samples = 0;
+        double meanAllocations = 0.0;
+        double meanBytes = 0.0;
+        uint64_t maxAllocations = 0;
+    };
+
+    AllocationStats();
+
+    void record(const AllocationTracker::Counts &counts);
+    Summary summary() const;
+    void reset();
+
+private:
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> maxAllocations;
+};
+
+// Per-camera latency histograms and allocation counts for every pipeline stage
+class PipelineMetrics
+{
+public:
+    LatencyHistogram &stage(PipelineStage stage);
+    const LatencyHistogram &stage(PipelineStage stage) const;
+    static const char *stageName(PipelineStage stage);
+
+    // Only filled while AllocationTracker is enabled
+    AllocationStats &allocations(PipelineStage stage);
+    const AllocationStats &allocations(PipelineStage stage) const;
+    AllocationStats &frameAllocations();
+    const AllocationStats &frameAllocations() const;
+
+    // Time from the frame's capture timestamp to each milestone
+    LatencyHistogram &frameAge(FrameMilestone milestone);
+    const LatencyHistogram &frameAge(FrameMilestone milestone) const;
+    static const char *milestoneName(FrameMilestone milestone);
+
+    // Frames lost by the sensor or driver, and frames the pipeline never displayed
+    void recordDrops(uint64_t sensor, uint64_t pipeline);
+    uint64_t sensorDrops() const;
+    uint64_t pipelineDrops() const;
+
+    // Fixed-width table of count/mean/p50/p95/p99/max per stage and milestone that
+    // has samples, then drop counts and allocations per call when any were counted
+    QString formatTable() const;
+
+    // Same summaries keyed by stage name, for benchmark reports
+    QJsonObject toJson() const;
+    void reset();
+
+private:
+    std::array<LatencyHistogram, static_cast<size_t>(PipelineStage::Count)> histograms;
+    std::array<AllocationStats, static_cast<size_t>(PipelineStage::Count)> stageAllocations;
+    AllocationStats frameTotals;
+    std::array<LatencyHistogram, static_cast<size_t>(FrameMilestone::Count)> frameAges;
+    std::atomic<uint64_t> sensorDropCount{0};
+    std::atomic<uint64_t> pipelineDropCount{0};
+};
+
+// Records the lifetime of the scope into a stage histogram, and onto the
+// trace timeline while tracing is on; no-op without either. Allocations made
+// on this thread inside the scope are counted while AllocationTracker is on.
+class StageTimer
+{
+public:
+    StageTimer(PipelineMetrics *metrics, PipelineStage stage)
+        : metrics(metrics), stage(stage), traced(FrameTracer::enabled()),
+          counted(metrics && AllocationTracker::enabled())
+    {
+        if (counted)
+            allocationsBefore = AllocationTracker::threadCounts();
+        if (metrics || traced)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~StageTimer()
+    {
+        if (!metrics && !traced)
+            return;
+        auto end = std::chrono::steady_clock::now();
+        if (metrics)
+        {
+            metrics->stage(stage).record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        }
+        if (traced)
+            FrameTracer::record(PipelineMetrics::stageName(stage), start, end);
+        if (counted)
+            metrics->allocations(stage).record(AllocationTracker::threadCounts() - allocationsBefore);
+    }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    PipelineMetrics *metrics;
+    PipelineStage stage;
+    bool traced;
+    bool counted;
+    AllocationTracker::Counts allocationsBefore;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,106 @@
+#include "PreviewWidget.h"
+#include <QMouseEvent>
+#include <QPainter>
+
+PreviewWidget::PreviewWidget(QWidget *parent)
+    : QWidget(parent), scale(1.0), rubberBand(new QRubberBand(QRubberBand::Rectangle, this))
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void PreviewWidget::setFrame(const cv::Mat &frame)
+{
+    if (frame.empty() || width() <= 0 || height() <= 0)
+        return;
+
+    // Fit the frame inside the widget, keeping its aspect ratio
+    scale = std::min(static_cast<double>(width()) / frame.cols,
+                     static_cast<double>(height()) / frame.rows);
+    cv::Size target(std::max(1, cvRound(frame.cols * scale)),
+                    std::max(1, cvRound(frame.rows * scale)));
+    frameSize = frame.size();
+
+    // Reallocate only when the preview geometry changes
+    if (previewBuffer.size() != target || previewBuffer.type() != CV_8UC3)
+    {
+        previewBuffer.create(target, CV_8UC3);
+        previewImage = QImage(previewBuffer.data, target.width, target.height,
+                              static_cast<int>(previewBuffer.step), QImage::Format_BGR888);
+    }
+
+    // Area interpolation averages whole source pixels when shrinking
+    int interpolation = scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR;
+    if (frame.depth() == CV_16U)
+    {
+        // Deep NIR frames are reduced to 8 bits here, after shrinking, at the display boundary
+        cv::resize(frame, deepScratch, target, 0, 0, interpolation);
+        deepScratch.convertTo(grayScratch, CV_8U, 1.0 / 257.0);
+        cv::cvtColor(grayScratch, previewBuffer, cv::COLOR_GRAY2BGR);
+    }
+    else if (frame.channels() == 1)
+    {
+        cv::resize(frame, grayScratch, target, 0, 0, interpolation);
+        cv::cvtColor(grayScratch, previewBuffer, cv::COLOR_GRAY2BGR);
+    }
+    else
+    {
+        cv::resize(frame, previewBuffer, target, 0, 0, interpolation);
+    }
+
+    update();
+}
+
+DetectionOverlay &PreviewWidget::overlay()
+{
+    return detectionOverlay;
+}
+
+void PreviewWidget::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (previewImage.isNull())
+        return;
+
+    QPoint origin = imageOrigin();
+    painter.drawImage(origin, previewImage);
+
+    detectionOverlay.paint(painter, QRectF(origin, previewImage.size()), scale);
+}
+
+void PreviewWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || previewImage.isNull())
+        return;
+    dragStart = event->position().toPoint();
+    rubberBand->setGeometry(QRect(dragStart, QSize()));
+    rubberBand->show();
+}
+
+void PreviewWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (rubberBand->isVisible())
+        rubberBand->setGeometry(QRect(dragStart, event->position().toPoint()).normalized());
+}
+
+void PreviewWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !rubberBand->isVisible())
+        return;
+    rubberBand->hide();
+
+    // Back from preview pixels to frame pixels; a click without a drag is ignored
+    QRect dragged = QRect(dragStart, event->position().toPoint()).normalized().translated(-imageOrigin());
+    cv::Rect region(cvFloor(dragged.x() / scale), cvFloor(dragged.y() / scale),
+                    cvCeil(dragged.width() / scale), cvCeil(dragged.height() / scale));
+    region &= cv::Rect(cv::Point(), frameSize);
+    if (region.width >= 16 && region.height >= 16)
+        emit regionDrawn(region);
+}
+
+QPoint PreviewWidget::imageOrigin() const
+{
+    // Centered, same placement as a KeepAspectRatio pixmap
+    return QPoint((width() - previewImage.width()) / 2, (height() - previewImage.height()) / 2);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QWidget>
+#include <QImage>
+#include <QRubberBand>
+#include <opencv2/opencv.hpp>
+#include "DetectionOverlay.h"
+
+// Preview surface that downsamples camera frames to its own size before display.
+// The BGR buffer and the QImage wrapping it are reused between frames, so showing a
+// frame costs a single resize and no per-frame allocation. Detections are painted
+// on top by the overlay, never into the buffer. Dragging over the preview draws
+// a region of the frame, reported by regionDrawn().
+class PreviewWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewWidget(QWidget *parent = nullptr);
+
+    // Downscale the frame into the preview buffer and schedule a repaint
+    void setFrame(const cv::Mat &frame);
+
+    // Markers painted over the frame, in source frame coordinates
+    DetectionOverlay &overlay();
+
+signals:
+    // A region dragged out over the preview, in coordinates of the frame shown
+    void regionDrawn(const cv::Rect &region);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    // Top left corner of the centred preview image in the widget
+    QPoint imageOrigin() const;
+
+    cv::Mat previewBuffer; // BGR, shared with previewImage
+    cv::Mat grayScratch;   // Downscaled single channel frames before expansion
+    cv::Mat deepScratch;   // Downscaled 16-bit frames before reduction to 8 bits
+    QImage previewImage;
+    DetectionOverlay detectionOverlay;
+    double scale;
+    cv::Size frameSize; // Size of the last frame, before downscaling
+    QRubberBand *rubberBand;
+    QPoint dragStart;
+};
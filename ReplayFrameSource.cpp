@@ -0,0 +1,272 @@
+#include "ReplayFrameSource.h"
+#include "PipelineMetrics.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace RecordingFormat;
+
+namespace
+{
+constexpr int STEP_WAIT_MS = 100;                             // Stepped mode gives up after this so closing is noticed
+constexpr auto MAX_PACING_GAP = std::chrono::milliseconds(1000); // Longer gaps in a recording are not waited out
+
+// The frame of a frame record whose header and payload are inside the mapping;
+// false if its geometry does not fit the payload
+bool recordedFrame(const uint8_t *recordStart, RawFrame &raw)
+{
+    RecordHeader record;
+    FrameInfo info;
+    memcpy(&record, recordStart, sizeof(record));
+    memcpy(&info, recordStart + sizeof(RecordHeader), sizeof(info));
+    if (info.width > INT_MAX || info.height > INT_MAX || info.bytesPerLine > INT_MAX)
+        return false;
+
+    raw.pixelFormat = info.pixelFormat;
+    raw.width = static_cast<int>(info.width);
+    raw.height = static_cast<int>(info.height);
+    raw.bytesPerLine = static_cast<int>(info.bytesPerLine);
+    raw.timestampNs = info.timestampNs;
+    raw.sequence = info.sequence;
+    raw.data = recordStart + sizeof(RecordHeader) + sizeof(FrameInfo);
+    raw.size = record.size - sizeof(FrameInfo);
+    return rawFrameFits(raw);
+}
+}
+
+ReplayFrameSource::ReplayFrameSource(const QString &path, Mode mode, bool loop)
+    : filePath(path), replayMode(mode), loop(loop), fd(-1), mapping(nullptr), fileSize(0), dataStart(0),
+      nextFrame(0), firstTimestampNs(0), pendingSteps(0)
+{
+}
+
+ReplayFrameSource::~ReplayFrameSource()
+{
+    close();
+}
+
+bool ReplayFrameSource::open()
+{
+    close();
+
+    fd = ::open(filePath.toStdString().c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader))
+    {
+        qWarning() << "Failed to open recording" << filePath;
+        close();
+        return false;
+    }
+    fileSize = static_cast<size_t>(info.st_size);
+
+    void *address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        qWarning() << "Failed to map recording" << filePath;
+        close();
+        return false;
+    }
+    mapping = static_cast<const uint8_t *>(address);
+
+    FileHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+        header.headerSize < sizeof(FileHeader) || header.headerSize > fileSize)
+    {
+        qWarning() << filePath << "is not a supported recording";
+        close();
+        return false;
+    }
+    dataStart = alignedSize(header.headerSize);
+
+    if (!loadIndex() || frames.empty())
+    {
+        qWarning() << "Recording" << filePath << "contains no frames";
+        close();
+        return false;
+    }
+
+    nextFrame = 0;
+    pendingSteps = 0;
+    resetTag();
+    qInfo() << "Replaying" << frames.size() << "frames recorded from" << QString::fromUtf8(header.source, strnlen(header.source, sizeof(header.source)))
+            << "in" << filePath;
+    return true;
+}
+
+bool ReplayFrameSource::loadIndex()
+{
+    frames.clear();
+
+    // A cleanly closed file ends with a trailer pointing at the index record
+    if (fileSize >= dataStart + sizeof(Trailer))
+    {
+        Trailer trailer;
+        memcpy(&trailer, mapping + fileSize - sizeof(Trailer), sizeof(trailer));
+        if (memcmp(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+            trailer.indexOffset >= dataStart && trailer.indexOffset <= fileSize - sizeof(RecordHeader))
+        {
+            RecordHeader record;
+            memcpy(&record, mapping + trailer.indexOffset, sizeof(record));
+            size_t entriesStart = trailer.indexOffset + sizeof(RecordHeader);
+            if (record.type == IndexRecord && entriesStart + record.size <= fileSize)
+            {
+                frames.resize(record.size / sizeof(IndexEntry));
+                memcpy(frames.data(), mapping + entriesStart, frames.size() * sizeof(IndexEntry));
+                bool valid = true;
+                for (const IndexEntry &entry : frames)
+                    valid = valid && isFrameRecord(entry.offset);
+                if (valid)
+                    return true;
+                qWarning() << "Recording" << filePath << "has a corrupt index";
+                frames.clear();
+            }
+        }
+    }
+
+    // Otherwise the recording was cut short: walk the records up to the unwritten tail
+    size_t offset = dataStart;
+    int unfit = 0;
+    while (offset + sizeof(RecordHeader) <= fileSize)
+    {
+        RecordHeader record;
+        memcpy(&record, mapping + offset, sizeof(record));
+        size_t total = sizeof(RecordHeader) + alignedSize(record.size);
+        if (record.type == 0 || offset + total > fileSize)
+            break;
+        if (isFrameRecord(offset))
+        {
+            FrameInfo frameInfo;
+            memcpy(&frameInfo, mapping + offset + sizeof(RecordHeader), sizeof(frameInfo));
+            frames.push_back({offset, frameInfo.timestampNs});
+        }
+        else if (record.type == FrameRecord)
+        {
+            unfit++;
+        }
+        offset += total;
+    }
+    if (unfit > 0)
+        qWarning() << "Skipped" << unfit << "frame records in" << filePath << "whose frames do not fit them";
+    qInfo() << "Recording" << filePath << "has no index, found" << frames.size() << "frames by scanning";
+    return true;
+}
+
+bool ReplayFrameSource::isFrameRecord(uint64_t offset) const
+{
+    if (offset < dataStart || offset > fileSize || fileSize - offset < sizeof(RecordHeader))
+        return false;
+    RecordHeader record;
+    memcpy(&record, mapping + offset, sizeof(record));
+    RawFrame raw;
+    return record.type == FrameRecord && record.size >= sizeof(FrameInfo) &&
+           alignedSize(record.size) <= fileSize - offset - sizeof(RecordHeader) &&
+           recordedFrame(mapping + offset, raw);
+}
+
+void ReplayFrameSource::close()
+{
+    if (mapping)
+    {
+        munmap(const_cast<uint8_t *>(mapping), fileSize);
+        mapping = nullptr;
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    frames.clear();
+    stepCondition.wakeAll();
+}
+
+bool ReplayFrameSource::isOpened() const
+{
+    return mapping != nullptr;
+}
+
+bool ReplayFrameSource::readFrame(cv::Mat &frame)
+{
+    if (!mapping)
+        return false;
+
+    if (nextFrame >= static_cast<int>(frames.size()))
+    {
+        if (!loop)
+            return false;
+        nextFrame = 0;
+    }
+
+    if (replayMode == Stepped)
+    {
+        QMutexLocker lock(&stepMutex);
+        if (pendingSteps == 0)
+            stepCondition.wait(&stepMutex, STEP_WAIT_MS);
+        if (pendingSteps == 0)
+            return false;
+        pendingSteps--;
+    }
+
+    // Every indexed record was checked to hold its frame when the file was opened
+    RawFrame raw;
+    recordedFrame(mapping + frames[nextFrame].offset, raw);
+
+    if (replayMode == RealTime)
+    {
+        // Keep the recorded spacing, restarting the clock on the first frame and after long gaps
+        auto now = std::chrono::steady_clock::now();
+        auto target = playbackStart + std::chrono::nanoseconds(raw.timestampNs - firstTimestampNs);
+        if (nextFrame == 0 || raw.timestampNs < firstTimestampNs || target > now + MAX_PACING_GAP ||
+            target < now - MAX_PACING_GAP)
+        {
+            playbackStart = now;
+            firstTimestampNs = raw.timestampNs;
+        }
+        else
+        {
+            std::this_thread::sleep_until(target);
+        }
+    }
+
+    nextFrame++;
+
+    StageTimer timer(metrics, PipelineStage::Capture);
+    if (!convertRawFrame(raw, frame))
+    {
+        skipFrames(1);
+        return false;
+    }
+    // Recorded timestamps are on an old timeline; latency is measured from the moment of replay
+    tagFrame(monotonicNowNs(), raw.sequence);
+    return true;
+}
+
+void ReplayFrameSource::interrupt()
+{
+    QMutexLocker lock(&stepMutex);
+    stepCondition.wakeAll();
+}
+
+QString ReplayFrameSource::name() const
+{
+    return QString("replay %1").arg(QFileInfo(filePath).fileName());
+}
+
+void ReplayFrameSource::step(int count)
+{
+    QMutexLocker lock(&stepMutex);
+    pendingSteps += count;
+    stepCondition.wakeAll();
+}
+
+ReplayFrameSource::Mode ReplayFrameSource::mode() const
+{
+    return replayMode;
+}
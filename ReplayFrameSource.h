@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <chrono>
+#include <vector>
+#include "FrameSource.h"
+#include "FrameRecorder.h"
+
+// Replays a .veinrec file through the normal capture path
+class ReplayFrameSource : public FrameSource
+{
+public:
+    enum Mode
+    {
+        RealTime, // Frames are spaced as they were recorded
+        Fast,     // As fast as the pipeline takes them
+        Stepped   // One frame per step() call
+    };
+
+    ReplayFrameSource(const QString &path, Mode mode, bool loop = true);
+    ~ReplayFrameSource() override;
+
+    bool open() override;
+    void close() override;
+    bool isOpened() const override;
+    void interrupt() override;
+    QString name() const override;
+
+    // Release the next frames in Stepped mode; safe from any thread
+    void step(int frames = 1);
+
+    Mode mode() const;
+
+protected:
+    bool readFrame(cv::Mat &frame) override;
+
+private:
+    bool loadIndex();
+    // Whether a whole frame record starts at offset, with a frame that fits its data
+    bool isFrameRecord(uint64_t offset) const;
+
+    QString filePath;
+    Mode replayMode;
+    bool loop;
+
+    int fd;
+    const uint8_t *mapping;
+    size_t fileSize;
+    size_t dataStart;
+    std::vector<RecordingFormat::IndexEntry> frames;
+
+    int nextFrame;
+
+    // Real-time pacing: recorded timestamps are replayed relative to this start
+    std::chrono::steady_clock::time_point playbackStart;
+    uint64_t firstTimestampNs;
+
+    QMutex stepMutex;
+    QWaitCondition stepCondition;
+    int pendingSteps;
+};
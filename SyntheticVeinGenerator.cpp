@@ -0,0 +1,156 @@
+#include "SyntheticVeinGenerator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr float SKIN_LEVEL = 175.0f;   // Mean gray level of lit skin
+constexpr int NOISE_BANK_SIZE = 16;    // Noise frames cycled pseudo-randomly
+constexpr float BRANCH_CHANCE = 0.06f; // Per step chance of a side branch
+}
+
+SyntheticVeinGenerator::SyntheticVeinGenerator(const SyntheticVeinConfig &initialConfig)
+    : config(initialConfig)
+{
+    config.width = std::max(16, config.width);
+    config.height = std::max(16, config.height);
+    margin = static_cast<int>(std::ceil(std::abs(config.motionAmplitude))) + 1;
+    cv::Size canvas(config.width + 2 * margin, config.height + 2 * margin);
+    cv::RNG rng(config.seed);
+
+    // Vessel trees run roughly along the forearm, left to right
+    cv::Mat absorption = cv::Mat::zeros(canvas, CV_32FC1);
+    vesselLayer = cv::Mat::zeros(canvas, CV_8UC1);
+    float scale = config.width / 640.0f;
+    for (int i = 0; i < config.vesselTrees; i++)
+    {
+        float y = canvas.height * (i + 0.5f) / config.vesselTrees + rng.uniform(-0.1f, 0.1f) * canvas.height;
+        y = std::clamp(y, 0.0f, canvas.height - 1.0f);
+        float angle = rng.uniform(-0.25f, 0.25f);
+        float width = rng.uniform(5.0f, 10.0f) * scale;
+        float contrast = static_cast<float>(config.vesselContrast) * rng.uniform(0.6f, 1.0f);
+        cv::Rect bounds;
+        growVessel(rng, cv::Point2f(0.0f, y), angle, width, contrast, config.branchDepth, absorption, bounds);
+        treeBounds.push_back(bounds & cv::Rect(0, 0, canvas.width, canvas.height));
+    }
+    // Tissue scattering softens vessel edges
+    cv::GaussianBlur(absorption, absorption, cv::Size(), std::max(1.0f, 1.5f * scale));
+
+    // Skin: slow variations in thickness plus fine texture
+    cv::Mat coarse(std::max(2, canvas.height / 48), std::max(2, canvas.width / 48), CV_32FC1);
+    rng.fill(coarse, cv::RNG::UNIFORM, -0.08, 0.08);
+    cv::Mat skin;
+    cv::resize(coarse, skin, canvas, 0, 0, cv::INTER_CUBIC);
+    cv::Mat fine(canvas, CV_32FC1);
+    rng.fill(fine, cv::RNG::NORMAL, 0.0, 0.03);
+    cv::GaussianBlur(fine, fine, cv::Size(), 1.2);
+    skin += fine + 1.0;
+
+    cv::Mat transmission = 1.0 - absorption;
+    cv::multiply(skin, transmission, skin, SKIN_LEVEL);
+    skin.convertTo(forearm, CV_8U);
+
+    // Vignetting is fixed to the sensor, so it does not move with the arm
+    vignette.create(config.height, config.width, CV_8UC1);
+    cv::Point2f center(config.width * 0.5f, config.height * 0.5f);
+    float radiusSquared = center.dot(center);
+    for (int y = 0; y < config.height; y++)
+    {
+        uchar *row = vignette.ptr<uchar>(y);
+        for (int x = 0; x < config.width; x++)
+        {
+            float dx = x - center.x;
+            float dy = y - center.y;
+            float falloff = static_cast<float>(config.vignetting) * (dx * dx + dy * dy) / radiusSquared;
+            row[x] = cv::saturate_cast<uchar>(255.0f * (1.0f - falloff));
+        }
+    }
+
+    // Generating fresh Gaussian noise per frame costs more than the rest of the
+    // frame, so a bank is rendered once and picked from per frame
+    if (config.noiseSigma > 0.0)
+    {
+        for (int i = 0; i < NOISE_BANK_SIZE; i++)
+        {
+            cv::Mat noise(config.height, config.width, CV_8SC1);
+            rng.fill(noise, cv::RNG::NORMAL, 0.0, config.noiseSigma);
+            noiseBank.push_back(noise);
+        }
+    }
+}
+
+const SyntheticVeinConfig &SyntheticVeinGenerator::getConfig() const
+{
+    return config;
+}
+
+void SyntheticVeinGenerator::growVessel(cv::RNG &rng, cv::Point2f position, float angle, float width, float contrast,
+                                        int depth, cv::Mat &absorption, cv::Rect &bounds)
+{
+    const float step = std::max(4.0f, absorption.cols / 80.0f);
+    const float baseAngle = angle;
+    const cv::Rect canvas(0, 0, absorption.cols, absorption.rows);
+    // Main vessels cross the whole canvas, branches are shorter
+    int steps = depth == config.branchDepth ? absorption.cols * 2 / static_cast<int>(step)
+                                            : rng.uniform(8, 24);
+
+    for (int i = 0; i < steps && width >= 1.0f; i++)
+    {
+        // Wander, with a pull back towards the initial direction
+        angle += static_cast<float>(rng.gaussian(0.08)) + (baseAngle - angle) * 0.05f;
+        cv::Point2f next = position + step * cv::Point2f(std::cos(angle), std::sin(angle));
+        if (!canvas.contains(cv::Point(next)))
+            break;
+
+        int thickness = std::max(1, cvRound(width));
+        cv::line(absorption, position, next, cv::Scalar(contrast), thickness);
+        cv::line(vesselLayer, position, next, cv::Scalar(255), thickness);
+        cv::Rect segment(cv::Point(position), cv::Point(next));
+        bounds |= cv::Rect(segment.x - thickness, segment.y - thickness,
+                           segment.width + 2 * thickness, segment.height + 2 * thickness);
+
+        if (depth > 0 && rng.uniform(0.0f, 1.0f) < BRANCH_CHANCE)
+        {
+            float side = rng.uniform(0, 2) ? 1.0f : -1.0f;
+            growVessel(rng, next, angle + side * rng.uniform(0.35f, 0.8f), width * rng.uniform(0.5f, 0.75f),
+                       contrast * 0.85f, depth - 1, absorption, bounds);
+        }
+
+        position = next;
+        width *= 0.997f; // Slight taper
+    }
+}
+
+cv::Point SyntheticVeinGenerator::motionOffset(int frameIndex) const
+{
+    // Slow sway, taken at the configured frame rate so motion per frame is realistic
+    double t = frameIndex / (config.fps > 0.0 ? config.fps : 30.0);
+    double x = config.motionAmplitude * std::sin(2.0 * CV_PI * 0.25 * t);
+    double y = 0.5 * config.motionAmplitude * std::sin(2.0 * CV_PI * 0.4 * t + 1.0);
+    return cv::Point(cvRound(x), cvRound(y));
+}
+
+void SyntheticVeinGenerator::render(int frameIndex, SyntheticFrame &frame) const
+{
+    cv::Point offset = motionOffset(frameIndex);
+    cv::Rect window(margin + offset.x, margin + offset.y, config.width, config.height);
+
+    cv::multiply(forearm(window), vignette, frame.image, 1.0 / 255.0);
+    if (!noiseBank.empty())
+    {
+        cv::RNG rng(config.seed * 0x9E3779B97F4A7C15ULL + static_cast<uint64_t>(frameIndex));
+        const cv::Mat &noise = noiseBank[rng.uniform(0, static_cast<int>(noiseBank.size()))];
+        cv::add(frame.image, noise, frame.image, cv::noArray(), CV_8U);
+    }
+
+    frame.vesselMask = vesselLayer(window);
+    frame.vesselBoxes.clear();
+    cv::Rect frameRect(0, 0, config.width, config.height);
+    for (const cv::Rect &tree : treeBounds)
+    {
+        cv::Rect box = (tree - window.tl()) & frameRect;
+        if (box.area() > 0)
+            frame.vesselBoxes.push_back(box);
+    }
+    frame.frameIndex = frameIndex;
+}
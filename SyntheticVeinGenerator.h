@@ -0,0 +1,59 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+// Synthetic camera settings
+struct SyntheticVeinConfig
+{
+    int width = 1280;
+    int height = 720;
+    double fps = 30.0;            // Pacing of the virtual camera, 0 for as fast as possible
+    uint64_t seed = 1;            // Same seed gives the same forearm and the same frames
+    int vesselTrees = 4;          // Main vessels crossing the forearm
+    int branchDepth = 2;          // Levels of branching below each main vessel
+    double vesselContrast = 0.35; // Fraction of light absorbed at the center of a main vessel
+    double noiseSigma = 4.0;      // Sensor noise in gray levels
+    double vignetting = 0.45;     // Brightness lost in the corners
+    double motionAmplitude = 8.0; // Arm sway in pixels
+};
+
+// One rendered frame with its ground truth
+struct SyntheticFrame
+{
+    cv::Mat image;                     // CV_8UC1 NIR intensity
+    cv::Mat vesselMask;                // CV_8UC1, 255 on vessels; view into generator memory
+    std::vector<cv::Rect> vesselBoxes; // One box per vessel tree visible in the frame
+    int frameIndex = 0;
+};
+
+// Deterministic renderer of 850 nm forearm images.
+// The forearm (skin texture and branching vessel trees of varying width and
+// contrast, blurred by tissue scattering) is rendered once on a canvas slightly
+// larger than the frame. Each frame is a whole-pixel shifted window into that
+// canvas with fixed vignetting and sensor noise applied, so rendering costs a few
+// passes over the frame and many virtual cameras can run on one machine.
+class SyntheticVeinGenerator
+{
+public:
+    explicit SyntheticVeinGenerator(const SyntheticVeinConfig &config = SyntheticVeinConfig());
+
+    const SyntheticVeinConfig &getConfig() const;
+
+    // Render frame frameIndex; the same index always gives the same frame
+    void render(int frameIndex, SyntheticFrame &frame) const;
+
+private:
+    void growVessel(cv::RNG &rng, cv::Point2f position, float angle, float width, float contrast,
+                    int depth, cv::Mat &absorption, cv::Rect &bounds);
+    cv::Point motionOffset(int frameIndex) const;
+
+    SyntheticVeinConfig config;
+    int margin;                       // Canvas border that motion may reveal
+    cv::Mat forearm;                  // CV_8UC1 canvas, skin with vessels
+    cv::Mat vesselLayer;              // CV_8UC1 canvas, ground truth mask
+    cv::Mat vignette;                 // CV_8UC1 frame, 255 = no falloff
+    std::vector<cv::Mat> noiseBank;   // CV_8SC1 frames of precomputed sensor noise
+    std::vector<cv::Rect> treeBounds; // Canvas coordinates
+};
@@ -0,0 +1,97 @@
+#include "TemporalDenoiser.h"
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace
+{
+using namespace cv;
+
+// Blend one row of new pixels into the 8.4 fixed point estimate and write the result.
+// weight = minWeight + min(|cur - estimate| * slope, 256 - minWeight), out of 256.
+void filterRow(const uchar *src, ushort *est, uchar *dst, int width, int minWeight, int slope)
+{
+    int x = 0;
+#if CV_SIMD
+    const v_uint16 vMinWeight = vx_setall_u16(static_cast<ushort>(minWeight));
+    const v_uint16 vRange = vx_setall_u16(static_cast<ushort>(256 - minWeight));
+    const v_uint16 vSlope = vx_setall_u16(static_cast<ushort>(slope));
+    const v_uint16 vFull = vx_setall_u16(256);
+    const v_uint32 vRound = vx_setall_u32(128);
+
+    auto blend = [&](const v_uint16 &cur, const v_uint16 &estimate)
+    {
+        v_uint16 diff = v_absdiff(cur, v_shr<4>(estimate));
+        v_uint16 weight = v_add_wrap(vMinWeight, v_min(v_mul_wrap(diff, vSlope), vRange));
+        v_uint16 keep = v_sub_wrap(vFull, weight);
+        v_uint32 old0, old1, new0, new1;
+        v_mul_expand(estimate, keep, old0, old1);
+        v_mul_expand(v_shl<4>(cur), weight, new0, new1);
+        return v_pack(v_shr<8>(old0 + new0 + vRound), v_shr<8>(old1 + new1 + vRound));
+    };
+
+    for (; x <= width - v_uint8::nlanes; x += v_uint8::nlanes)
+    {
+        v_uint16 cur0, cur1;
+        v_expand(vx_load(src + x), cur0, cur1);
+        v_uint16 est0 = blend(cur0, vx_load(est + x));
+        v_uint16 est1 = blend(cur1, vx_load(est + x + v_uint16::nlanes));
+        v_store(est + x, est0);
+        v_store(est + x + v_uint16::nlanes, est1);
+        v_store(dst + x, v_rshr_pack<4>(est0, est1));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+    {
+        int cur = src[x];
+        int estimate = est[x];
+        int diff = std::abs(cur - (estimate >> 4));
+        int weight = minWeight + std::min(diff * slope, 256 - minWeight);
+        estimate = (estimate * (256 - weight) + (cur << 4) * weight + 128) >> 8;
+        est[x] = static_cast<ushort>(estimate);
+        dst[x] = static_cast<uchar>((estimate + 8) >> 4);
+    }
+}
+}
+
+TemporalDenoiser::TemporalDenoiser()
+    : minWeight(64), weightSlope(8)
+{
+}
+
+void TemporalDenoiser::setParameters(int strength, int motionThreshold)
+{
+    minWeight = std::max(1, std::min(255, strength));
+    motionThreshold = std::max(1, std::min(255, motionThreshold));
+    // Reach full weight (no history) at the motion threshold
+    weightSlope = (256 - minWeight + motionThreshold - 1) / motionThreshold;
+}
+
+void TemporalDenoiser::reset()
+{
+    estimate.release();
+}
+
+void TemporalDenoiser::apply(const cv::Mat &src, cv::Mat &dst)
+{
+    CV_Assert(src.type() == CV_8UC1);
+
+    // Seed the estimate from the first frame of a new size
+    if (estimate.size() != src.size())
+    {
+        src.convertTo(estimate, CV_16U, 16);
+        if (dst.data != src.data)
+            src.copyTo(dst);
+        return;
+    }
+
+    dst.create(src.size(), CV_8UC1);
+    const int width = src.cols;
+    const int weight = minWeight;
+    const int slope = weightSlope;
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &rows)
+                      {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            filterRow(src.ptr<uchar>(y), estimate.ptr<ushort>(y), dst.ptr<uchar>(y), width, weight, slope);
+        } });
+}
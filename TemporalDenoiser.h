@@ -0,0 +1,29 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+// Motion-adaptive recursive temporal filter for 8-bit gray frames.
+// Each pixel is blended into a running estimate kept in 8.4 fixed point. The
+// blend weight grows with the difference between the new pixel and the estimate,
+// so static regions average over many frames while moving edges follow the new
+// frame immediately instead of ghosting. One pass per frame, integer SIMD.
+class TemporalDenoiser
+{
+public:
+    TemporalDenoiser();
+
+    // strength: 1..255, lower keeps more history (weight of a static pixel, out of 256)
+    // motionThreshold: difference in gray levels at which a pixel is fully replaced
+    void setParameters(int strength, int motionThreshold);
+
+    // Filter one frame; dst may alias src
+    void apply(const cv::Mat &src, cv::Mat &dst);
+
+    // Forget the running estimate, e.g. after a camera or resolution change
+    void reset();
+
+private:
+    cv::Mat estimate; // CV_16UC1, gray level << 4
+    int minWeight;
+    int weightSlope;
+};
@@ -0,0 +1,560 @@
+#include "VeinKernels.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using namespace cv;
+
+// Clip a tile histogram at limit and spread the excess evenly, as OpenCV does
+void clipHistogram(int *hist, int bins, int limit)
+{
+    int clipped = 0;
+    for (int i = 0; i < bins; i++)
+    {
+        if (hist[i] > limit)
+        {
+            clipped += hist[i] - limit;
+            hist[i] = limit;
+        }
+    }
+
+    int batch = clipped / bins;
+    int residual = clipped - batch * bins;
+    for (int i = 0; i < bins; i++)
+        hist[i] += batch;
+    if (residual > 0)
+    {
+        int step = std::max(bins / residual, 1);
+        for (int i = 0; i < bins && residual > 0; i += step, residual--)
+            hist[i]++;
+    }
+}
+
+// What one output row interpolates between
+struct ClaheRow
+{
+    const float *lut1; // LUTs of the tile row above
+    const float *lut2; // LUTs of the tile row below
+    const int *ind1;   // Left tile offset per column
+    const int *ind2;   // Right tile offset per column
+    const float *xa;   // Weight of the right tile per column
+    float ya;          // Weight of the row below
+};
+
+#if CV_SIMD
+// Map a vector of pixels at column offset through the four surrounding tile LUTs
+template <int SHIFT>
+inline v_int32 blendLanes(const v_uint32 &value, const ClaheRow &row, int offset)
+{
+    const v_float32 one = vx_setall_f32(1.0f);
+    const v_float32 ya = vx_setall_f32(row.ya);
+    v_int32 bin = v_reinterpret_as_s32(value);
+    if constexpr (SHIFT > 0)
+        bin = v_reinterpret_as_s32(v_shr<SHIFT>(value));
+    v_int32 i1 = vx_load(row.ind1 + offset) + bin;
+    v_int32 i2 = vx_load(row.ind2 + offset) + bin;
+    v_float32 right = vx_load(row.xa + offset);
+    v_float32 left = one - right;
+    v_float32 top = v_lut(row.lut1, i1) * left + v_lut(row.lut1, i2) * right;
+    v_float32 bottom = v_lut(row.lut2, i1) * left + v_lut(row.lut2, i2) * right;
+    return v_round(top * (one - ya) + bottom * ya);
+}
+#endif
+
+template <typename T>
+inline T blendPixel(T value, const ClaheRow &row, int x, int shift)
+{
+    int bin = value >> shift;
+    float right = row.xa[x];
+    float top = row.lut1[row.ind1[x] + bin] * (1.0f - right) + row.lut1[row.ind2[x] + bin] * right;
+    float bottom = row.lut2[row.ind1[x] + bin] * (1.0f - right) + row.lut2[row.ind2[x] + bin] * right;
+    return saturate_cast<T>(top * (1.0f - row.ya) + bottom * row.ya);
+}
+
+void interpolateRow(const uchar *src, uchar *dst, int width, const ClaheRow &row)
+{
+    int x = 0;
+#if CV_SIMD
+    const int n = v_uint32::nlanes;
+    for (; x <= width - v_uint8::nlanes; x += v_uint8::nlanes)
+    {
+        v_uint16 w0, w1;
+        v_expand(vx_load(src + x), w0, w1);
+        v_uint32 q0, q1, q2, q3;
+        v_expand(w0, q0, q1);
+        v_expand(w1, q2, q3);
+        v_uint16 lo = v_pack_u(blendLanes<0>(q0, row, x), blendLanes<0>(q1, row, x + n));
+        v_uint16 hi = v_pack_u(blendLanes<0>(q2, row, x + 2 * n), blendLanes<0>(q3, row, x + 3 * n));
+        v_store(dst + x, v_pack(lo, hi));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = blendPixel(src[x], row, x, 0);
+}
+
+void interpolateRow(const ushort *src, ushort *dst, int width, const ClaheRow &row)
+{
+    int x = 0;
+#if CV_SIMD
+    for (; x <= width - v_uint16::nlanes; x += v_uint16::nlanes)
+    {
+        v_uint32 lo, hi;
+        v_expand(vx_load(src + x), lo, hi);
+        v_store(dst + x, v_pack_u(blendLanes<FrameStatistics::DEEP_SHIFT>(lo, row, x),
+                                  blendLanes<FrameStatistics::DEEP_SHIFT>(hi, row, x + v_uint32::nlanes)));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = blendPixel(src[x], row, x, FrameStatistics::DEEP_SHIFT);
+}
+
+void contrastRow(const ushort *src, ushort *dst, int width, float alpha, float beta)
+{
+    int x = 0;
+#if CV_SIMD
+    const v_float32 vAlpha = vx_setall_f32(alpha);
+    const v_float32 vBeta = vx_setall_f32(beta);
+    for (; x <= width - v_uint16::nlanes; x += v_uint16::nlanes)
+    {
+        v_uint32 lo, hi;
+        v_expand(vx_load(src + x), lo, hi);
+        v_int32 scaledLo = v_round(v_muladd(v_cvt_f32(v_reinterpret_as_s32(lo)), vAlpha, vBeta));
+        v_int32 scaledHi = v_round(v_muladd(v_cvt_f32(v_reinterpret_as_s32(hi)), vAlpha, vBeta));
+        v_store(dst + x, v_pack_u(scaledLo, scaledHi));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = saturate_cast<ushort>(src[x] * alpha + beta);
+}
+
+// 255 where src + delta <= mean. With unsigned saturating subtraction that is
+// mean - src >= delta for a positive delta and src - mean <= -delta otherwise.
+void thresholdRow(const uchar *src, const uchar *mean, uchar *dst, int width, int delta)
+{
+    int x = 0;
+#if CV_SIMD
+    const v_uint8 vDelta = vx_setall_u8(static_cast<uchar>(std::min(std::abs(delta), 255)));
+    for (; x <= width - v_uint8::nlanes; x += v_uint8::nlanes)
+    {
+        v_uint8 value = vx_load(src + x);
+        v_uint8 local = vx_load(mean + x);
+        v_store(dst + x, delta > 0 ? (local - value) >= vDelta : (value - local) <= vDelta);
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = src[x] + delta <= mean[x] ? 255 : 0;
+}
+
+void thresholdRow(const ushort *src, const ushort *mean, uchar *dst, int width, int delta)
+{
+    int x = 0;
+#if CV_SIMD
+    const v_uint16 vDelta = vx_setall_u16(static_cast<ushort>(std::min(std::abs(delta), 65535)));
+    auto below = [&](const v_uint16 &value, const v_uint16 &local)
+    {
+        return delta > 0 ? (local - value) >= vDelta : (value - local) <= vDelta;
+    };
+    for (; x <= width - v_uint8::nlanes; x += v_uint8::nlanes)
+    {
+        v_uint16 mask0 = below(vx_load(src + x), vx_load(mean + x));
+        v_uint16 mask1 = below(vx_load(src + x + v_uint16::nlanes), vx_load(mean + x + v_uint16::nlanes));
+        v_store(dst + x, v_pack(mask0, mask1));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = src[x] + delta <= mean[x] ? 255 : 0;
+}
+
+// Working rows of one fused strip are kept within this, about an L2 cache
+constexpr size_t FUSED_CACHE_BYTES = 256 * 1024;
+constexpr int MIN_FUSED_ROWS = 8;
+
+#if CV_SIMD
+// 8 or 16-bit pixels as 16-bit lanes, and back with saturation
+inline v_uint16 loadWide(const uchar *src)
+{
+    return vx_load_expand(src);
+}
+
+inline v_uint16 loadWide(const ushort *src)
+{
+    return vx_load(src);
+}
+
+inline void storeNarrow(uchar *dst, const v_uint16 &value)
+{
+    v_pack_store(dst, value);
+}
+
+inline void storeNarrow(ushort *dst, const v_uint16 &value)
+{
+    v_store(dst, value);
+}
+#endif
+
+// 8-bit contrast through a table convertTo filled, so it matches contrast<uchar>
+void contrastRow(const uchar *src, uchar *dst, int width, const uchar *lut)
+{
+    for (int x = 0; x < width; x++)
+        dst[x] = lut[src[x]];
+}
+
+// veinEnhancement() at one pixel: cv::Laplacian's 3x3 aperture saturated to T,
+// inverted and blended into the pixel as addWeighted does
+template <typename T>
+inline T enhancePixel(const T *up, const T *mid, const T *down, int left, int x, int right, float alpha, float beta)
+{
+    int laplacian = 2 * (up[left] + up[right] + down[left] + down[right]) - 8 * mid[x];
+    int inverted = PixelDepth<T>::maxValue - std::clamp(laplacian, 0, PixelDepth<T>::maxValue);
+    return saturate_cast<T>(mid[x] * alpha + inverted * beta);
+}
+
+// veinEnhancement() of the row mid between its neighbours up and down. Columns
+// reflect at the edges, as the Laplacian's default border does.
+template <typename T>
+void enhanceRow(const T *up, const T *mid, const T *down, T *dst, int width, float alpha, float beta)
+{
+    const int inner = width > 1 ? 1 : 0;
+    dst[0] = enhancePixel(up, mid, down, inner, 0, inner, alpha, beta);
+    int x = 1;
+#if CV_SIMD
+    const v_int32 maxValue = vx_setall_s32(PixelDepth<T>::maxValue);
+    const v_int32 zero = vx_setzero_s32();
+    const v_float32 vAlpha = vx_setall_f32(alpha);
+    const v_float32 vBeta = vx_setall_f32(beta);
+    auto blend = [&](const v_uint32 &corners, const v_uint32 &centre)
+    {
+        v_int32 laplacian = v_reinterpret_as_s32(v_shl<1>(corners)) - v_reinterpret_as_s32(v_shl<3>(centre));
+        v_int32 inverted = maxValue - v_min(v_max(laplacian, zero), maxValue);
+        return v_round(v_muladd(v_cvt_f32(v_reinterpret_as_s32(centre)), vAlpha, v_cvt_f32(inverted) * vBeta));
+    };
+    for (; x <= width - 1 - v_uint16::nlanes; x += v_uint16::nlanes)
+    {
+        v_uint32 a0, a1, b0, b1, c0, c1, d0, d1, m0, m1;
+        v_expand(loadWide(up + x - 1), a0, a1);
+        v_expand(loadWide(up + x + 1), b0, b1);
+        v_expand(loadWide(down + x - 1), c0, c1);
+        v_expand(loadWide(down + x + 1), d0, d1);
+        v_expand(loadWide(mid + x), m0, m1);
+        storeNarrow(dst + x, v_pack_u(blend(a0 + b0 + c0 + d0, m0), blend(a1 + b1 + c1 + d1, m1)));
+    }
+    vx_cleanup();
+#endif
+    for (; x < width - 1; x++)
+        dst[x] = enhancePixel(up, mid, down, x - 1, x, x + 1, alpha, beta);
+    if (width > 1)
+        dst[width - 1] = enhancePixel(up, mid, down, width - 2, width - 1, width - 2, alpha, beta);
+}
+
+// 255 where src is above level, as cv::compare with CMP_GT
+template <typename T>
+void aboveRow(const T *src, uchar *dst, int width, int level)
+{
+    int x = 0;
+#if CV_SIMD
+    const v_uint16 vLevel = vx_setall_u16(static_cast<ushort>(level));
+    for (; x <= width - v_uint16::nlanes; x += v_uint16::nlanes)
+        v_pack_store(dst + x, loadWide(src + x) > vLevel);
+    vx_cleanup();
+#endif
+    for (; x < width; x++)
+        dst[x] = src[x] > level ? 255 : 0;
+}
+
+// One fused kernel per depth and combination of stages. Each strip computes the
+// rows its threshold reads around it: the Gaussian mean needs blockSize / 2 rows
+// above and below, and the Laplacian one more. Halo rows are recomputed by both
+// strips they border instead of shared.
+template <typename T, int STAGES>
+void fusedPass(const cv::Mat &src, cv::Mat &dst, const VeinKernels::FusedParams &params)
+{
+    constexpr bool CONTRAST = (STAGES & VeinKernels::FUSE_CONTRAST) != 0;
+    constexpr bool ENHANCE = (STAGES & VeinKernels::FUSE_ENHANCE) != 0;
+    constexpr bool ADAPTIVE = (STAGES & VeinKernels::FUSE_ADAPTIVE) != 0;
+    CV_Assert(src.type() == PixelDepth<T>::type);
+    dst.create(src.size(), CV_8UC1);
+    if (src.empty())
+        return;
+
+    const int width = src.cols;
+    const int height = src.rows;
+    const int blockSize = params.blockSize | 1;
+    const int halo = ADAPTIVE ? blockSize / 2 : 0;
+    const double grayLevel = PixelDepth<T>::grayLevel;
+
+    // Same arithmetic as contrast<T>: a convertTo table for 8 bits, float for 16
+    Mat lut;
+    if constexpr (CONTRAST && std::is_same<T, uchar>::value)
+    {
+        Mat ramp(1, 256, CV_8UC1);
+        for (int i = 0; i < 256; i++)
+            ramp.at<uchar>(i) = static_cast<uchar>(i);
+        ramp.convertTo(lut, -1, params.alpha, params.beta);
+    }
+    const float gain = static_cast<float>(params.alpha);
+    const float offset = static_cast<float>(params.beta * grayLevel);
+    const float enhanceAlpha = static_cast<float>(params.enhanceAlpha);
+    const float enhanceBeta = static_cast<float>(params.enhanceBeta);
+    const int delta = cvFloor(params.delta * grayLevel);
+    const int level = static_cast<int>(128 * grayLevel);
+
+    // Strips are as tall as keeps their source, stage and mean rows in cache. Where a
+    // frame is too wide for that to threshold at least twice the rows recomputed around
+    // them, each thread takes one tall strip instead, which costs what the stages do apart
+    const size_t rowBytes = static_cast<size_t>(width) * sizeof(T);
+    const int haloRows = 2 * halo + (ENHANCE ? 2 : 0);
+    const int cachedRows = static_cast<int>(FUSED_CACHE_BYTES / (rowBytes * (2 + CONTRAST + ENHANCE))) - haloRows;
+    const int minRows = std::max(MIN_FUSED_ROWS, 2 * haloRows);
+    const int threads = std::max(1, getNumThreads());
+    const int threadRows = (height + threads - 1) / threads;
+    const int stripRows = std::min(height, std::max(cachedRows >= minRows ? cachedRows : threadRows, minRows));
+    const int strips = (height + stripRows - 1) / stripRows;
+
+    parallel_for_(Range(0, strips), [&](const Range &range)
+                  {
+        Mat contrasted, enhanced, staged, mean;
+        for (int strip = range.start; strip < range.end; strip++)
+        {
+            // Rows thresholded, rows their mean reads and rows the Laplacian reads around those
+            const int y0 = strip * stripRows;
+            const int y1 = std::min(height, y0 + stripRows);
+            const int e0 = std::max(0, y0 - halo);
+            const int e1 = std::min(height, y1 + halo);
+            const int c0 = ENHANCE ? std::max(0, e0 - 1) : e0;
+            const int c1 = ENHANCE ? std::min(height, e1 + 1) : e1;
+
+            if constexpr (CONTRAST)
+            {
+                contrasted.create(c1 - c0, width, PixelDepth<T>::type);
+                for (int y = c0; y < c1; y++)
+                {
+                    if constexpr (std::is_same<T, uchar>::value)
+                        contrastRow(src.ptr<uchar>(y), contrasted.ptr<uchar>(y - c0), width, lut.ptr<uchar>());
+                    else
+                        contrastRow(src.ptr<ushort>(y), contrasted.ptr<ushort>(y - c0), width, gain, offset);
+                }
+            }
+            auto contrastedRow = [&](int y) -> const T *
+            {
+                if constexpr (CONTRAST)
+                    return contrasted.ptr<T>(y - c0);
+                else
+                    return src.ptr<T>(y);
+            };
+
+            if constexpr (ENHANCE)
+            {
+                // Rows reflect at the frame edges, as the Laplacian's default border does
+                enhanced.create(e1 - e0, width, PixelDepth<T>::type);
+                for (int y = e0; y < e1; y++)
+                {
+                    int up = y > 0 ? y - 1 : std::min(1, height - 1);
+                    int down = y < height - 1 ? y + 1 : std::max(height - 2, 0);
+                    enhanceRow(contrastedRow(up), contrastedRow(y), contrastedRow(down), enhanced.ptr<T>(y - e0),
+                               width, enhanceAlpha, enhanceBeta);
+                }
+            }
+            auto stagedRow = [&](int y) -> const T *
+            {
+                if constexpr (ENHANCE)
+                    return enhanced.ptr<T>(y - e0);
+                else
+                    return contrastedRow(y);
+            };
+
+            if constexpr (ADAPTIVE)
+            {
+                // The strip is a window into rows e0 to e1, so the Gaussian reads the
+                // halo from them and replicates only past the frame edges
+                Mat window;
+                if constexpr (ENHANCE)
+                    window = enhanced;
+                else if constexpr (CONTRAST)
+                    window = contrasted;
+                else
+                {
+                    src.rowRange(e0, e1).copyTo(staged);
+                    window = staged;
+                }
+                GaussianBlur(window.rowRange(y0 - e0, y1 - e0), mean, Size(blockSize, blockSize), 0, 0, BORDER_REPLICATE);
+                for (int y = y0; y < y1; y++)
+                    thresholdRow(stagedRow(y), mean.ptr<T>(y - y0), dst.ptr<uchar>(y), width, delta);
+            }
+            else
+            {
+                for (int y = y0; y < y1; y++)
+                    aboveRow(stagedRow(y), dst.ptr<uchar>(y), width, level);
+            }
+        } });
+}
+
+using FusedKernel = void (*)(const Mat &, Mat &, const VeinKernels::FusedParams &);
+
+// Kernels for every combination of stages, indexed by their flags
+template <typename T, int... STAGES>
+constexpr std::array<FusedKernel, sizeof...(STAGES)> fusedKernels(std::integer_sequence<int, STAGES...>)
+{
+    return {fusedPass<T, STAGES>...};
+}
+}
+
+double grayLevelScale(int depth)
+{
+    return depth == CV_16U ? PixelDepth<ushort>::grayLevel : PixelDepth<uchar>::grayLevel;
+}
+
+namespace VeinKernels
+{
+template <typename T>
+void clahe(const cv::Mat &src, const FrameStatistics &stats, cv::Mat &dst, double clipLimit)
+{
+    CV_Assert(src.type() == PixelDepth<T>::type && stats.depth == src.depth() && stats.size == src.size());
+    const cv::Size tiles = stats.tiles;
+    const cv::Size tileSize = stats.tileSize;
+    const int bins = stats.bins;
+    const int tilePixels = tileSize.area();
+    const int limit = clipLimit > 0.0 ? std::max(1, static_cast<int>(clipLimit * tilePixels / bins)) : 0;
+    const float lutScale = static_cast<float>(PixelDepth<T>::maxValue) / tilePixels;
+
+    // One float LUT per tile, rows in tile order, so a tile row is contiguous
+    cv::Mat luts(tiles.area(), bins, CV_32F);
+    cv::parallel_for_(cv::Range(0, tiles.area()), [&](const cv::Range &range)
+                      {
+        std::vector<int> hist(bins);
+        for (int tile = range.start; tile < range.end; tile++)
+        {
+            std::copy(stats.tileHistogram(tile), stats.tileHistogram(tile) + bins, hist.begin());
+            if (limit > 0)
+                clipHistogram(hist.data(), bins, limit);
+
+            float *lut = luts.ptr<float>(tile);
+            int sum = 0;
+            for (int i = 0; i < bins; i++)
+            {
+                sum += hist[i];
+                lut[i] = std::min(static_cast<float>(PixelDepth<T>::maxValue), sum * lutScale);
+            }
+        } });
+
+    // Per column tile offsets and weights, shared by every row
+    std::vector<int> ind1(src.cols), ind2(src.cols);
+    std::vector<float> xa(src.cols);
+    const float invTileWidth = 1.0f / tileSize.width;
+    for (int x = 0; x < src.cols; x++)
+    {
+        float txf = x * invTileWidth - 0.5f;
+        int tx1 = cvFloor(txf);
+        int tx2 = tx1 + 1;
+        xa[x] = txf - tx1;
+        ind1[x] = std::max(tx1, 0) * bins;
+        ind2[x] = std::min(tx2, tiles.width - 1) * bins;
+    }
+
+    dst.create(src.size(), PixelDepth<T>::type);
+    const float invTileHeight = 1.0f / tileSize.height;
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &rows)
+                      {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            float tyf = y * invTileHeight - 0.5f;
+            int ty1 = cvFloor(tyf);
+            int ty2 = ty1 + 1;
+            ClaheRow row;
+            row.ya = tyf - ty1;
+            row.lut1 = luts.ptr<float>(std::max(ty1, 0) * tiles.width);
+            row.lut2 = luts.ptr<float>(std::min(ty2, tiles.height - 1) * tiles.width);
+            row.ind1 = ind1.data();
+            row.ind2 = ind2.data();
+            row.xa = xa.data();
+            interpolateRow(src.ptr<T>(y), dst.ptr<T>(y), src.cols, row);
+        } });
+}
+
+template <typename T>
+void clahe(const cv::Mat &src, cv::Mat &dst, double clipLimit, cv::Size tiles)
+{
+    FrameStatistics stats;
+    stats.compute(src, tiles);
+    clahe<T>(src, stats, dst, clipLimit);
+}
+
+template <>
+void contrast<uchar>(const cv::Mat &src, cv::Mat &dst, double alpha, double beta)
+{
+    src.convertTo(dst, -1, alpha, beta);
+}
+
+template <>
+void contrast<ushort>(const cv::Mat &src, cv::Mat &dst, double alpha, double beta)
+{
+    CV_Assert(src.type() == CV_16UC1);
+    dst.create(src.size(), CV_16UC1);
+    const float gain = static_cast<float>(alpha);
+    const float offset = static_cast<float>(beta * PixelDepth<ushort>::grayLevel);
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &rows)
+                      {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            contrastRow(src.ptr<ushort>(y), dst.ptr<ushort>(y), src.cols, gain, offset);
+        } });
+}
+
+template <typename T>
+void adaptiveThreshold(const cv::Mat &src, cv::Mat &dst, int blockSize, double delta)
+{
+    CV_Assert(src.type() == PixelDepth<T>::type);
+
+    // Same neighbourhood mean and rounding of delta as cv::adaptiveThreshold
+    cv::Mat mean;
+    cv::GaussianBlur(src, mean, cv::Size(blockSize, blockSize), 0, 0, cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+    const int scaledDelta = cvFloor(delta * PixelDepth<T>::grayLevel);
+
+    dst.create(src.size(), CV_8UC1);
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &rows)
+                      {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            thresholdRow(src.ptr<T>(y), mean.ptr<T>(y), dst.ptr<uchar>(y), src.cols, scaledDelta);
+        } });
+}
+
+template <typename T>
+void veinEnhancement(const cv::Mat &src, cv::Mat &dst, double alpha, double beta)
+{
+    // Simple edge detection as a fallback for Frangi filter
+    cv::Mat laplacian;
+    cv::Laplacian(src, laplacian, src.depth(), 3);
+
+    // Invert to highlight veins (veins appear as dark lines in NIR)
+    cv::Mat inverted;
+    cv::subtract(cv::Scalar::all(PixelDepth<T>::maxValue), laplacian, inverted);
+
+    cv::addWeighted(src, alpha, inverted, beta, 0, dst);
+}
+
+void fusedBinary(const cv::Mat &src, cv::Mat &dst, int stages, const FusedParams &params)
+{
+    static constexpr auto narrow = fusedKernels<uchar>(std::make_integer_sequence<int, FUSE_ALL + 1>());
+    static constexpr auto deep = fusedKernels<ushort>(std::make_integer_sequence<int, FUSE_ALL + 1>());
+    (src.depth() == CV_16U ? deep : narrow)[stages & FUSE_ALL](src, dst, params);
+}
+
+template void clahe<uchar>(const cv::Mat &, const FrameStatistics &, cv::Mat &, double);
+template void clahe<ushort>(const cv::Mat &, const FrameStatistics &, cv::Mat &, double);
+template void clahe<uchar>(const cv::Mat &, cv::Mat &, double, cv::Size);
+template void clahe<ushort>(const cv::Mat &, cv::Mat &, double, cv::Size);
+template void adaptiveThreshold<uchar>(const cv::Mat &, cv::Mat &, int, double);
+template void adaptiveThreshold<ushort>(const cv::Mat &, cv::Mat &, int, double);
+template void veinEnhancement<uchar>(const cv::Mat &, cv::Mat &, double, double);
+template void veinEnhancement<ushort>(const cv::Mat &, cv::Mat &, double, double);
+}
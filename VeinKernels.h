@@ -0,0 +1,85 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "FrameStatistics.h"
+
+// Pixel types the vein chain runs on. Intensity settings such as contrastBeta and
+// adaptiveCValue are given in 8-bit gray levels; grayLevel scales them to the type.
+template <typename T>
+struct PixelDepth;
+
+template <>
+struct PixelDepth<uchar>
+{
+    static constexpr int type = CV_8UC1;
+    static constexpr int maxValue = 255;
+    static constexpr double grayLevel = 1.0;
+};
+
+template <>
+struct PixelDepth<ushort>
+{
+    static constexpr int type = CV_16UC1;
+    static constexpr int maxValue = 65535;
+    static constexpr double grayLevel = 257.0;
+};
+
+// One 8-bit gray level in units of a CV_8U or CV_16U frame
+double grayLevelScale(int depth);
+
+// Vein chain kernels for single channel 8 and 16-bit frames. The 8-bit
+// instantiations keep OpenCV's kernels where those are already the fast path;
+// the 16-bit ones are written for deep NIR frames with universal intrinsics.
+namespace VeinKernels
+{
+// Contrast limited adaptive histogram equalisation over the tile histograms stats
+// gathered from src. 16-bit tiles are histogrammed at 12-bit resolution, so the
+// clip limit behaves as it does for 8-bit frames
+template <typename T>
+void clahe(const cv::Mat &src, const FrameStatistics &stats, cv::Mat &dst, double clipLimit);
+
+// As above, gathering the tile histograms itself
+template <typename T>
+void clahe(const cv::Mat &src, cv::Mat &dst, double clipLimit, cv::Size tiles);
+
+// dst = saturate(src * alpha + beta), beta in 8-bit gray levels
+template <typename T>
+void contrast(const cv::Mat &src, cv::Mat &dst, double alpha, double beta);
+
+// CV_8UC1 mask, 255 where src lies at least delta gray levels below its
+// Gaussian-weighted blockSize neighbourhood; matches cv::adaptiveThreshold
+// with ADAPTIVE_THRESH_GAUSSIAN_C and THRESH_BINARY_INV
+template <typename T>
+void adaptiveThreshold(const cv::Mat &src, cv::Mat &dst, int blockSize, double delta);
+
+// Inverted Laplacian blended into the frame, so dark vein lines stand out
+template <typename T>
+void veinEnhancement(const cv::Mat &src, cv::Mat &dst, double alpha, double beta);
+
+// Stages fusedBinary() runs, combined as flags
+constexpr int FUSE_CONTRAST = 1; // contrast() with alpha and beta
+constexpr int FUSE_ENHANCE = 2;  // veinEnhancement() with enhanceAlpha and enhanceBeta
+constexpr int FUSE_ADAPTIVE = 4; // adaptiveThreshold(), otherwise a fixed threshold at mid gray
+constexpr int FUSE_ALL = FUSE_CONTRAST | FUSE_ENHANCE | FUSE_ADAPTIVE;
+
+struct FusedParams
+{
+    double alpha = 1.0;
+    double beta = 0.0;
+    double enhanceAlpha = 1.0;
+    double enhanceBeta = 0.0;
+    int blockSize = 11;
+    double delta = 2.0;
+};
+
+// Contrast, vein enhancement and thresholding of a CV_8UC1 or CV_16UC1 frame to a
+// CV_8UC1 mask in one pass over strips of rows sized to stay in cache, without
+// full-frame intermediates. Each combination of stages is compiled as its own
+// kernel and picked here; the mask matches running the stages one by one.
+void fusedBinary(const cv::Mat &src, cv::Mat &dst, int stages, const FusedParams &params);
+
+template <>
+void contrast<uchar>(const cv::Mat &src, cv::Mat &dst, double alpha, double beta);
+template <>
+void contrast<ushort>(const cv::Mat &src, cv::Mat &dst, double alpha, double beta);
+}
@@ -0,0 +1,575 @@
+#include "VeinProcessor.h"
+#include "VeinKernels.h"
+#include <QDebug>
+#include <algorithm>
+
+VeinProcessor::VeinProcessor(const VeinProcessingConfig &initialConfig)
+    : config(initialConfig), metrics(nullptr)
+{
+}
+
+void VeinProcessor::setMetrics(PipelineMetrics *stageMetrics)
+{
+    metrics = stageMetrics;
+}
+
+void VeinProcessor::setConfig(const VeinProcessingConfig &newConfig)
+{
+    config = newConfig;
+}
+
+const VeinProcessingConfig &VeinProcessor::getConfig() const
+{
+    return config;
+}
+
+// Vein processing methods based on Python VeinProcessor
+cv::Mat VeinProcessor::processVeinFrame(const cv::Mat &inputFrame)
+{
+    if (inputFrame.empty())
+    {
+        qWarning() << "Empty frame provided to vein processor";
+        return inputFrame;
+    }
+
+    try
+    {
+        cv::Mat processed = inputFrame.clone();
+        cv::Mat gray;
+
+        // Convert to grayscale if needed
+        if (processed.channels() == 3)
+        {
+            cv::cvtColor(processed, gray, cv::COLOR_BGR2GRAY);
+        }
+        else
+        {
+            gray = processed.clone();
+        }
+
+        // Apply filters based on configuration
+        gray = applyDenoise(gray);
+
+        // One statistics pass serves CLAHE, auto-contrast and statistics() readers
+        computeStatistics(gray);
+
+        if (config.claheEnabled)
+        {
+            gray = equalise(gray);
+        }
+
+        if (config.contrastEnabled)
+        {
+            gray = stretchContrast(gray, config.claheEnabled ? nullptr : &frameStats);
+        }
+
+        // Apply vein enhancement (simple edge detection as fallback for Frangi filter)
+        cv::Mat enhanced = config.veinEnhancementEnabled ? applyVeinEnhancement(gray, gray) : gray;
+
+        // Apply adaptive thresholding if enabled
+        cv::Mat binary;
+        if (config.adaptiveThresholdEnabled)
+        {
+            binary = applyAdaptiveThreshold(enhanced);
+
+            if (config.morphologyEnabled)
+            {
+                binary = applyMorphology(binary);
+            }
+        }
+
+        // Create colored visualization with veins highlighted
+        if (processed.channels() == 3)
+        {
+            cv::Mat result = processed.clone();
+
+            if (!binary.empty())
+            {
+                // Create blue mask for veins
+                cv::Mat blueMask = cv::Mat::zeros(result.size(), result.type());
+                std::vector<cv::Mat> channels(3);
+                cv::split(blueMask, channels);
+                channels[0] = binary; // Blue channel
+                cv::merge(channels, blueMask);
+
+                // Blend with original
+                cv::addWeighted(result, 1.0, blueMask, config.enhancementAlpha, 0, result);
+            }
+            else
+            {
+                // Use enhanced grayscale for all channels with blue emphasis
+                std::vector<cv::Mat> channels(3);
+                cv::split(result, channels);
+                cv::addWeighted(channels[0], 0.5, enhanced, 0.5, 0, channels[0]); // Blue
+                cv::addWeighted(channels[1], 0.7, enhanced, 0.3, 0, channels[1]); // Green
+                cv::addWeighted(channels[2], 0.9, enhanced, 0.1, 0, channels[2]); // Red
+                cv::merge(channels, result);
+            }
+
+            return result;
+        }
+        else
+        {
+            return enhanced;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        qWarning() << "Error in vein processing:" << e.what();
+        return inputFrame;
+    }
+}
+
+cv::Mat VeinProcessor::getVeinBinaryFrame(const cv::Mat &inputFrame)
+{
+    if (inputFrame.empty())
+    {
+        qWarning() << "Empty frame provided to vein binary processor";
+        return cv::Mat();
+    }
+
+    try
+    {
+        cv::Mat gray;
+
+        // Convert to grayscale if needed
+        if (inputFrame.channels() == 3)
+        {
+            cv::cvtColor(inputFrame, gray, cv::COLOR_BGR2GRAY);
+        }
+        else
+        {
+            gray = inputFrame.clone();
+        }
+
+        // Apply filters based on configuration
+        gray = applyDenoise(gray);
+
+        // One statistics pass serves CLAHE, auto-contrast and statistics() readers
+        computeStatistics(gray);
+
+        if (config.claheEnabled)
+        {
+            gray = equalise(gray);
+        }
+
+        const FrameStatistics *contrastStats = config.claheEnabled ? nullptr : &frameStats;
+        cv::Mat binary;
+        if (config.fuseStages)
+        {
+            // Contrast, enhancement and thresholding without intermediate frames
+            binary = fuseStages(gray, contrastStats);
+        }
+        else
+        {
+            if (config.contrastEnabled)
+            {
+                gray = stretchContrast(gray, contrastStats);
+            }
+
+            // Apply vein enhancement (simple edge detection as fallback for Frangi filter)
+            cv::Mat enhanced = config.veinEnhancementEnabled ? applyVeinEnhancement(gray, gray) : gray;
+
+            // Apply adaptive thresholding to get binary image
+            if (config.adaptiveThresholdEnabled)
+            {
+                binary = applyAdaptiveThreshold(enhanced);
+            }
+            else
+            {
+                // Simple threshold at mid gray as fallback, at any depth
+                cv::compare(enhanced, 128 * grayLevelScale(enhanced.depth()), binary, cv::CMP_GT);
+            }
+        }
+
+        if (config.adaptiveThresholdEnabled && config.morphologyEnabled)
+        {
+            binary = applyMorphology(binary);
+        }
+
+        return binary;
+    }
+    catch (const std::exception &e)
+    {
+        qWarning() << "Error in vein binary processing:" << e.what();
+        return cv::Mat();
+    }
+}
+
+cv::Mat VeinProcessor::applyMedianFilter(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::MedianFilter);
+    cv::Mat result;
+    int kernelSize = config.medianKernelSize;
+    // Ensure kernel size is odd
+    if (kernelSize % 2 == 0)
+        kernelSize++;
+    // OpenCV filters 16-bit frames with apertures up to 5 only
+    if (frame.depth() == CV_16U)
+        kernelSize = std::min(kernelSize, 5);
+    cv::medianBlur(frame, result, kernelSize);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyGaussianFilter(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::GaussianFilter);
+    cv::Mat result;
+    int kernelSize = config.gaussianKernelSize;
+    // Ensure kernel size is odd
+    if (kernelSize % 2 == 0)
+        kernelSize++;
+    cv::GaussianBlur(frame, result, cv::Size(kernelSize, kernelSize), config.gaussianSigma);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyBilateralFilter(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::BilateralFilter);
+    cv::Mat result;
+    if (frame.depth() == CV_16U)
+    {
+        // OpenCV's bilateral filter takes 8-bit or float frames
+        cv::Mat deep, filtered;
+        frame.convertTo(deep, CV_32F);
+        cv::bilateralFilter(deep, filtered, config.bilateralDiameter,
+                            config.bilateralSigmaColor * PixelDepth<ushort>::grayLevel, config.bilateralSigmaSpace);
+        filtered.convertTo(result, CV_16U);
+        return result;
+    }
+    cv::bilateralFilter(frame, result, config.bilateralDiameter,
+                        config.bilateralSigmaColor, config.bilateralSigmaSpace);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyTemporalDenoise(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::TemporalDenoise);
+    cv::Mat result;
+    temporalDenoiser.setParameters(config.temporalStrength, config.temporalMotionThreshold);
+    temporalDenoiser.apply(frame, result);
+    return result;
+}
+
+void VeinProcessor::updateTemporalDenoise(const cv::Mat &inputFrame)
+{
+    if (!config.temporalDenoiseEnabled || inputFrame.empty())
+        return;
+
+    cv::Mat gray = inputFrame;
+    if (inputFrame.channels() == 3)
+        cv::cvtColor(inputFrame, gray, cv::COLOR_BGR2GRAY);
+    if (gray.depth() == CV_8U)
+        applyTemporalDenoise(gray);
+}
+
+cv::Mat VeinProcessor::applyDenoise(const cv::Mat &gray)
+{
+    // The temporal filter keeps an 8-bit estimate; deep frames use the spatial stack
+    if (config.temporalDenoiseEnabled && gray.depth() == CV_8U)
+    {
+        return applyTemporalDenoise(gray);
+    }
+
+    // Drop the running estimate so re-enabling does not blend in stale frames
+    temporalDenoiser.reset();
+
+    cv::Mat result = gray;
+    if (config.medianFilterEnabled)
+    {
+        result = applyMedianFilter(result);
+    }
+
+    if (config.gaussianFilterEnabled)
+    {
+        result = applyGaussianFilter(result);
+    }
+
+    if (config.bilateralFilterEnabled)
+    {
+        result = applyBilateralFilter(result);
+    }
+    return result;
+}
+
+cv::Mat VeinProcessor::applyCLAHE(const cv::Mat &frame)
+{
+    computeStatistics(frame);
+    return equalise(frame);
+}
+
+cv::Mat VeinProcessor::applyContrastEnhancement(const cv::Mat &frame)
+{
+    if (!config.autoContrast)
+        return stretchContrast(frame, nullptr);
+    computeStatistics(frame);
+    return stretchContrast(frame, &frameStats);
+}
+
+const FrameStatistics &VeinProcessor::statistics() const
+{
+    return frameStats;
+}
+
+void VeinProcessor::computeStatistics(const cv::Mat &gray)
+{
+    StageTimer timer(metrics, PipelineStage::Statistics);
+    frameStats.compute(gray, cv::Size(config.claheTileGridSizeX, config.claheTileGridSizeY));
+}
+
+cv::Mat VeinProcessor::equalise(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::Clahe);
+    cv::Mat result;
+    if (frame.depth() == CV_16U)
+        VeinKernels::clahe<ushort>(frame, frameStats, result, config.claheClipLimit);
+    else
+        VeinKernels::clahe<uchar>(frame, frameStats, result, config.claheClipLimit);
+    return result;
+}
+
+void VeinProcessor::contrastGain(const cv::Mat &frame, const FrameStatistics *stats, double &alpha, double &beta) const
+{
+    alpha = config.contrastAlpha;
+    beta = config.contrastBeta;
+    if (config.autoContrast && stats)
+    {
+        // Map the clip percentiles to black and white; a nearly flat frame keeps the fixed gain
+        double clip = std::clamp(config.autoContrastClipPercent, 0.0, 49.0) / 100.0;
+        double low = stats->percentile(clip);
+        double high = stats->percentile(1.0 - clip);
+        double grayLevel = grayLevelScale(frame.depth());
+        if (high - low >= 4.0 * grayLevel)
+        {
+            alpha = (frame.depth() == CV_16U ? PixelDepth<ushort>::maxValue : PixelDepth<uchar>::maxValue) / (high - low);
+            beta = -low * alpha / grayLevel;
+        }
+    }
+}
+
+cv::Mat VeinProcessor::stretchContrast(const cv::Mat &frame, const FrameStatistics *stats)
+{
+    StageTimer timer(metrics, PipelineStage::Contrast);
+    double alpha, beta;
+    contrastGain(frame, stats, alpha, beta);
+
+    cv::Mat result;
+    if (frame.depth() == CV_16U)
+        VeinKernels::contrast<ushort>(frame, result, alpha, beta);
+    else
+        VeinKernels::contrast<uchar>(frame, result, alpha, beta);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyFusedStages(const cv::Mat &frame)
+{
+    if (!config.contrastEnabled || !config.autoContrast || config.claheEnabled)
+        return fuseStages(frame, nullptr);
+    computeStatistics(frame);
+    return fuseStages(frame, &frameStats);
+}
+
+cv::Mat VeinProcessor::fuseStages(const cv::Mat &frame, const FrameStatistics *stats)
+{
+    StageTimer timer(metrics, PipelineStage::FusedStages);
+    VeinKernels::FusedParams params;
+    int stages = 0;
+    if (config.contrastEnabled)
+    {
+        stages |= VeinKernels::FUSE_CONTRAST;
+        contrastGain(frame, stats, params.alpha, params.beta);
+    }
+    if (config.veinEnhancementEnabled)
+    {
+        stages |= VeinKernels::FUSE_ENHANCE;
+        params.enhanceAlpha = config.enhancementAlpha;
+        params.enhanceBeta = config.enhancementBeta;
+    }
+    if (config.adaptiveThresholdEnabled)
+    {
+        stages |= VeinKernels::FUSE_ADAPTIVE;
+        params.blockSize = config.adaptiveBlockSize | 1;
+        params.delta = config.adaptiveCValue;
+    }
+
+    cv::Mat result;
+    VeinKernels::fusedBinary(frame, result, stages, params);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyAdaptiveThreshold(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::AdaptiveThreshold);
+    cv::Mat result;
+    int blockSize = config.adaptiveBlockSize;
+    // Ensure block size is odd
+    if (blockSize % 2 == 0)
+        blockSize++;
+
+    if (frame.depth() == CV_16U)
+        VeinKernels::adaptiveThreshold<ushort>(frame, result, blockSize, config.adaptiveCValue);
+    else
+        VeinKernels::adaptiveThreshold<uchar>(frame, result, blockSize, config.adaptiveCValue);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyMorphology(const cv::Mat &frame)
+{
+    StageTimer timer(metrics, PipelineStage::Morphology);
+    cv::Mat result;
+    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT,
+                                               cv::Size(config.morphologyKernelSize, config.morphologyKernelSize));
+    cv::morphologyEx(frame, result, config.morphologyOperation, kernel);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyVeinEnhancement(const cv::Mat &frame, const cv::Mat &enhanced)
+{
+    StageTimer timer(metrics, PipelineStage::VeinEnhancement);
+    cv::Mat result;
+    if (frame.depth() == CV_16U)
+        VeinKernels::veinEnhancement<ushort>(frame, result, config.enhancementAlpha, config.enhancementBeta);
+    else
+        VeinKernels::veinEnhancement<uchar>(frame, result, config.enhancementAlpha, config.enhancementBeta);
+    return result;
+}
+
+cv::Mat VeinProcessor::applyVeinEnhancementForDetection(const cv::Mat &frame)
+{
+    // Vein enhancement preprocessing similar to Python approach
+    cv::Mat enhanced_frame;
+
+    // Convert to grayscale
+    cv::Mat gray;
+    if (frame.channels() == 3)
+    {
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    }
+    else
+    {
+        gray = frame.clone();
+    }
+
+    // Apply CLAHE for contrast enhancement
+    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(3.0, cv::Size(8, 8));
+    cv::Mat gray_enhanced;
+    clahe->apply(gray, gray_enhanced);
+
+    // Convert back to BGR for YOLO detection
+    cv::cvtColor(gray_enhanced, enhanced_frame, cv::COLOR_GRAY2BGR);
+
+    return enhanced_frame;
+}
+
+std::vector<Detection> VeinProcessor::findVeinRegions(const cv::Mat &binaryFrame, float confidenceThreshold)
+{
+    StageTimer timer(metrics, PipelineStage::VeinRegions);
+    std::vector<Detection> detections;
+
+    if (binaryFrame.empty())
+        return detections;
+
+    try
+    {
+        // Label and measure the regions in one pass, without tracing contours
+        const int MIN_AREA = 100; // Min and max area for vein regions
+        const int MAX_AREA = 10000;
+        const size_t MAX_DETECTIONS = 10; // Limit the number of detections to prevent clutter
+        for (const Component &component : labeller.label(binaryFrame, MIN_AREA + 1))
+        {
+            if (component.area >= MAX_AREA)
+                continue;
+
+            // Filter by aspect ratio (veins are typically elongated)
+            double aspectRatio = static_cast<double>(component.bounds.width) / component.bounds.height;
+            if (aspectRatio > 0.2 && aspectRatio < 5.0) // Allow some variation in aspect ratio
+            {
+                Detection detection;
+                detection.boundingBox = component.bounds;
+                detection.confidence = static_cast<float>(component.area / 1000.0); // Confidence based on area
+                detection.confidence = std::min(detection.confidence, 1.0f);
+                detection.classId = 0;
+                detection.className = "vein_region";
+
+                // Only add if confidence is above threshold
+                if (detection.confidence > confidenceThreshold)
+                {
+                    detections.push_back(detection);
+                }
+            }
+        }
+
+        // Keep the most confident, highest first; only those need ordering
+        auto moreConfident = [](const Detection &a, const Detection &b)
+        {
+            return a.confidence > b.confidence;
+        };
+        if (detections.size() > MAX_DETECTIONS)
+        {
+            std::nth_element(detections.begin(), detections.begin() + MAX_DETECTIONS, detections.end(), moreConfident);
+            detections.resize(MAX_DETECTIONS);
+        }
+        std::sort(detections.begin(), detections.end(), moreConfident);
+    }
+    catch (const std::exception &e)
+    {
+        qWarning() << "Error finding vein regions:" << e.what();
+    }
+
+    return detections;
+}
+
+void VeinProcessor::extractVeinGraph(const cv::Mat &binaryFrame, VeinGraph &graph)
+{
+    StageTimer timer(metrics, PipelineStage::Skeleton);
+    graph.clear();
+
+    if (binaryFrame.empty())
+        return;
+
+    try
+    {
+        skeletoniser.extract(binaryFrame, graph);
+    }
+    catch (const std::exception &e)
+    {
+        qWarning() << "Error extracting vein centrelines:" << e.what();
+        graph.clear();
+    }
+}
+
+cv::Rect VeinProcessor::findArmRegion(const cv::Mat &frame, double margin)
+{
+    if (frame.empty())
+        return cv::Rect();
+
+    // A thumbnail is plenty to find something as large as an arm
+    const int THUMBNAIL_WIDTH = 160;
+    double scale = std::min(1.0, static_cast<double>(THUMBNAIL_WIDTH) / frame.cols);
+    cv::Mat thumbnail, gray, mask;
+    cv::resize(frame, thumbnail, cv::Size(), scale, scale, cv::INTER_AREA);
+    if (thumbnail.channels() == 3)
+        cv::cvtColor(thumbnail, thumbnail, cv::COLOR_BGR2GRAY);
+    thumbnail.convertTo(gray, CV_8U, 1.0 / grayLevelScale(thumbnail.depth()));
+
+    // Skin scatters NIR light back, so the arm is brighter than the background
+    cv::threshold(gray, mask, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+    cv::Mat labels, stats, centroids;
+    int count = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+    int largest = 0;
+    for (int label = 1; label < count; label++)
+    {
+        if (largest == 0 || stats.at<int>(label, cv::CC_STAT_AREA) > stats.at<int>(largest, cv::CC_STAT_AREA))
+            largest = label;
+    }
+    if (largest == 0 || static_cast<size_t>(stats.at<int>(largest, cv::CC_STAT_AREA)) < mask.total() / 20)
+        return cv::Rect();
+
+    cv::Rect box(stats.at<int>(largest, cv::CC_STAT_LEFT), stats.at<int>(largest, cv::CC_STAT_TOP),
+                 stats.at<int>(largest, cv::CC_STAT_WIDTH), stats.at<int>(largest, cv::CC_STAT_HEIGHT));
+    int padX = cvRound(frame.cols * margin);
+    int padY = cvRound(frame.rows * margin);
+    cv::Rect region(cvFloor(box.x / scale) - padX, cvFloor(box.y / scale) - padY,
+                    cvCeil(box.width / scale) + 2 * padX, cvCeil(box.height / scale) + 2 * padY);
+    return region & cv::Rect(0, 0, frame.cols, frame.rows);
+}
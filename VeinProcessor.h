@@ -0,0 +1,143 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "TemporalDenoiser.h"
+#include "PipelineMetrics.h"
+#include "FrameStatistics.h"
+#include "ComponentLabeller.h"
+#include "VeinSkeleton.h"
+
+// Detection result structure
+struct Detection
+{
+    cv::Rect boundingBox;
+    float confidence;
+    int classId;
+    std::string className;
+    int trackId = -1; // Stable id assigned by VeinTracker, -1 when untracked
+};
+
+// Vein processing configuration based on Python VeinProcessor.
+// Intensity settings are in 8-bit gray levels and scaled for 16-bit frames.
+struct VeinProcessingConfig
+{
+    // Filter settings
+    bool medianFilterEnabled = true;
+    int medianKernelSize = 5;
+
+    bool gaussianFilterEnabled = true;
+    int gaussianKernelSize = 5;
+    double gaussianSigma = 1.2;
+
+    bool bilateralFilterEnabled = true;
+    int bilateralDiameter = 9;
+    double bilateralSigmaColor = 75.0;
+    double bilateralSigmaSpace = 75.0;
+
+    // Temporal denoising, replaces the median/Gaussian/bilateral stack when enabled
+    bool temporalDenoiseEnabled = false;
+    int temporalStrength = 64;        // Weight of a static pixel out of 256, lower averages more frames
+    int temporalMotionThreshold = 24; // Gray level change treated as motion
+
+    // CLAHE settings
+    bool claheEnabled = true;
+    double claheClipLimit = 3.0;
+    int claheTileGridSizeX = 8;
+    int claheTileGridSizeY = 8;
+
+    // Contrast enhancement
+    bool contrastEnabled = true;
+    double contrastAlpha = 1.8;
+    int contrastBeta = 10;
+    // Stretch each frame between its own percentiles instead of alpha/beta. Applies
+    // when CLAHE is off; CLAHE output already spans the full range.
+    bool autoContrast = false;
+    double autoContrastClipPercent = 1.0; // Pixels saturated at each end
+
+    // Adaptive thresholding
+    bool adaptiveThresholdEnabled = true;
+    int adaptiveBlockSize = 11;
+    int adaptiveCValue = 2;
+
+    // Morphological operations
+    bool morphologyEnabled = true;
+    int morphologyKernelSize = 3;
+    int morphologyOperation = cv::MORPH_CLOSE;
+
+    // Vein enhancement
+    bool veinEnhancementEnabled = true;
+    double enhancementAlpha = 0.7;
+    double enhancementBeta = 0.3;
+
+    // Run contrast, enhancement and thresholding of getVeinBinaryFrame() as one
+    // pass over the frame instead of a pass and an intermediate frame each
+    bool fuseStages = true;
+};
+
+// Vein processing chain (based on Python VeinProcessor).
+// Holds no UI state, so it can run on the capture thread with its own config copy.
+// Takes 8-bit BGR or gray frames and 16-bit gray NIR frames; a 16-bit frame keeps
+// its depth through every stage up to the 8-bit binary mask.
+class VeinProcessor
+{
+public:
+    explicit VeinProcessor(const VeinProcessingConfig &initialConfig = VeinProcessingConfig());
+
+    void setConfig(const VeinProcessingConfig &newConfig);
+    const VeinProcessingConfig &getConfig() const;
+
+    // Record per-stage latency into metrics; pass nullptr to disable
+    void setMetrics(PipelineMetrics *stageMetrics);
+
+    cv::Mat processVeinFrame(const cv::Mat &inputFrame);
+    cv::Mat getVeinBinaryFrame(const cv::Mat &inputFrame);
+    cv::Mat applyMedianFilter(const cv::Mat &frame);
+    cv::Mat applyGaussianFilter(const cv::Mat &frame);
+    cv::Mat applyBilateralFilter(const cv::Mat &frame);
+    cv::Mat applyTemporalDenoise(const cv::Mat &frame);
+    // Advance the temporal denoiser by a frame the rest of the chain skips, e.g. while
+    // tracks are predicted, so its average runs over consecutive frames
+    void updateTemporalDenoise(const cv::Mat &inputFrame);
+    cv::Mat applyCLAHE(const cv::Mat &frame);
+    cv::Mat applyContrastEnhancement(const cv::Mat &frame);
+    cv::Mat applyAdaptiveThreshold(const cv::Mat &frame);
+    cv::Mat applyMorphology(const cv::Mat &frame);
+    cv::Mat applyVeinEnhancement(const cv::Mat &frame, const cv::Mat &enhanced);
+    cv::Mat applyVeinEnhancementForDetection(const cv::Mat &frame);
+    // Contrast, vein enhancement and thresholding as enabled, fused into one pass;
+    // the mask before morphology
+    cv::Mat applyFusedStages(const cv::Mat &frame);
+    std::vector<Detection> findVeinRegions(const cv::Mat &binaryFrame, float confidenceThreshold);
+    // Vein centrelines and branch points of a frame from getVeinBinaryFrame()
+    void extractVeinGraph(const cv::Mat &binaryFrame, VeinGraph &graph);
+
+    // Histograms and moments of the gray frame the last processVeinFrame() or
+    // getVeinBinaryFrame() call worked on, after denoising; for exposure and load
+    // decisions that would otherwise scan the frame again
+    const FrameStatistics &statistics() const;
+
+    // Bounding box of the arm, the largest bright area under NIR light, padded by
+    // margin of the frame size on each side; empty when nothing stands out
+    cv::Rect findArmRegion(const cv::Mat &frame, double margin = 0.05);
+
+private:
+    // Noise reduction ahead of CLAHE: temporal filter or the spatial filter stack
+    cv::Mat applyDenoise(const cv::Mat &gray);
+    // Gather frameStats for gray over the CLAHE tile grid
+    void computeStatistics(const cv::Mat &gray);
+    // CLAHE and contrast stages reusing frameStats, which must be of frame;
+    // contrast without statistics uses the fixed alpha/beta
+    cv::Mat equalise(const cv::Mat &frame);
+    cv::Mat stretchContrast(const cv::Mat &frame, const FrameStatistics *stats);
+    void contrastGain(const cv::Mat &frame, const FrameStatistics *stats, double &alpha, double &beta) const;
+    cv::Mat fuseStages(const cv::Mat &frame, const FrameStatistics *stats);
+
+    VeinProcessingConfig config;
+    TemporalDenoiser temporalDenoiser;
+    FrameStatistics frameStats;
+    ComponentLabeller labeller; // Buffers reused by findVeinRegions()
+    VeinSkeletoniser skeletoniser;
+    PipelineMetrics *metrics;
+};
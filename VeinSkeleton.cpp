@@ -0,0 +1,297 @@
+#include "VeinSkeleton.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+using namespace cv;
+
+const double DIAGONAL_STEP = std::sqrt(2.0);
+
+// Neighbourhood codes have bit i set when neighbour i is, clockwise from north:
+// Zhang and Suen's P2 to P9
+inline int neighbourhood(const uchar *p, int step)
+{
+    return p[-step] | (p[-step + 1] << 1) | (p[1] << 2) | (p[step + 1] << 3) |
+           (p[step] << 4) | (p[step - 1] << 5) | (p[-1] << 6) | (p[-step - 1] << 7);
+}
+
+struct Tables
+{
+    uchar remove[2][256]; // Removed by the first and second sub-iteration
+    uchar links[256];     // Neighbours a centreline pixel is joined to
+    uchar degree[256];
+};
+
+const Tables &tables()
+{
+    static const Tables built = []()
+    {
+        Tables t{};
+        for (int code = 0; code < 256; code++)
+        {
+            auto p = [code](int i)
+            { return (code >> (i & 7)) & 1; };
+            int count = 0;
+            int transitions = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                count += p(i);
+                transitions += !p(i) && p(i + 1);
+            }
+            // A boundary pixel that is neither an end nor holding the shape together
+            bool candidate = count >= 2 && count <= 6 && transitions == 1;
+            t.remove[0][code] = candidate && !(p(0) && p(2) && p(4)) && !(p(2) && p(4) && p(6));
+            t.remove[1][code] = candidate && !(p(0) && p(2) && p(6)) && !(p(0) && p(4) && p(6));
+
+            // A diagonal neighbour is only joined directly when no edge neighbour
+            // joins the two, so a staircase does not read as a branch
+            int links = code & 0x55;
+            for (int d = 1; d < 8; d += 2)
+            {
+                if (p(d) && !p(d - 1) && !p(d + 1))
+                    links |= 1 << d;
+            }
+            t.links[code] = static_cast<uchar>(links);
+            for (int d = 0; d < 8; d++)
+                t.degree[code] += (links >> d) & 1;
+        }
+        return t;
+    }();
+    return built;
+}
+
+// Offset of the first non-zero byte of row at or after x, or width when there is none
+inline int skipBackground(const uchar *row, int x, int width)
+{
+#if CV_SIMD
+    const v_uint8 zero = vx_setzero_u8();
+    while (x <= width - v_uint8::nlanes && v_check_all(vx_load(row + x) == zero))
+        x += v_uint8::nlanes;
+    vx_cleanup();
+#endif
+    while (x < width && row[x] == 0)
+        x++;
+    return x;
+}
+}
+
+void VeinSkeletoniser::thinPass(int subIteration)
+{
+    const uchar *remove = tables().remove[subIteration];
+    const int step = static_cast<int>(image.step);
+    const int end = image.cols - 1;
+    std::vector<uchar> &todo = dirty[subIteration];
+    cv::parallel_for_(cv::Range(1, image.rows - 1), [&](const cv::Range &rows)
+                      {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            changed[y] = 0;
+            if (!todo[y])
+                continue;
+            todo[y] = 0;
+
+            const uchar *src = image.ptr<uchar>(y);
+            uchar *dst = next.ptr<uchar>(y);
+            int x = 1;
+            while (x < end)
+            {
+                int foreground = skipBackground(src, x, end);
+                std::memset(dst + x, 0, foreground - x);
+                for (x = foreground; x < end && src[x]; x++)
+                {
+                    dst[x] = !remove[neighbourhood(src + x, step)];
+                    changed[y] |= !dst[x];
+                }
+            }
+        } });
+
+    // Removals land once every row has been decided, and wake the rows next to them
+    for (int y = 1; y < image.rows - 1; y++)
+    {
+        if (!changed[y])
+            continue;
+        std::memcpy(image.ptr<uchar>(y) + 1, next.ptr<uchar>(y) + 1, image.cols - 2);
+        for (std::vector<uchar> &rows : dirty)
+        {
+            rows[y - 1] = rows[y] = rows[y + 1] = 1;
+        }
+    }
+    for (std::vector<uchar> &rows : dirty)
+        rows.front() = rows.back() = 0;
+}
+
+cv::Mat VeinSkeletoniser::thin(const cv::Mat &binary)
+{
+    CV_Assert(binary.type() == CV_8UC1);
+    cv::copyMakeBorder(binary, image, 1, 1, 1, 1, cv::BORDER_CONSTANT, 0);
+    cv::min(image, 1, image);
+    next.create(image.size(), CV_8UC1);
+    for (std::vector<uchar> &rows : dirty)
+    {
+        rows.assign(image.rows, 1);
+        rows.front() = rows.back() = 0;
+    }
+    changed.assign(image.rows, 0);
+
+    // Alternate the sub-iterations until neither has a row left to revisit
+    auto pending = [](const std::vector<uchar> &rows)
+    { return std::find(rows.begin(), rows.end(), 1) != rows.end(); };
+    for (int subIteration = 0; pending(dirty[0]) || pending(dirty[1]); subIteration ^= 1)
+        thinPass(subIteration);
+
+    return image(cv::Rect(1, 1, binary.cols, binary.rows));
+}
+
+void VeinSkeletoniser::extract(const cv::Mat &binary, VeinGraph &graph, double minBranchLength)
+{
+    graph.clear();
+    if (binary.empty())
+        return;
+    thin(binary);
+    cv::distanceTransform(binary, distance, cv::DIST_L2, cv::DIST_MASK_3);
+
+    // Image was allocated by copyMakeBorder, so it and the buffers sized to it are
+    // continuous and one offset addresses a pixel in all of them
+    const Tables &t = tables();
+    const int step = image.cols;
+    const uchar *base = image.ptr<uchar>();
+    pixels.clear();
+    for (int y = 1; y < image.rows - 1; y++)
+    {
+        const uchar *row = image.ptr<uchar>(y);
+        for (int x = skipBackground(row, 1, step - 1); x < step - 1; x = skipBackground(row, x + 1, step - 1))
+            pixels.push_back(y * step + x);
+    }
+    if (junctionIds.size() != image.size())
+    {
+        junctionIds = cv::Mat(image.size(), CV_32SC1, cv::Scalar(-1));
+        visited = cv::Mat::zeros(image.size(), CV_8UC1);
+    }
+    int *junction = junctionIds.ptr<int>();
+    uchar *seen = visited.ptr<uchar>();
+
+    const int offsets[8] = {-step, -step + 1, 1, step + 1, step, step - 1, -1, -step - 1};
+    auto links = [&](int i)
+    { return t.links[neighbourhood(base + i, step)]; };
+    auto degree = [&](int i)
+    { return t.degree[neighbourhood(base + i, step)]; };
+    auto point = [step](int i)
+    { return cv::Point(i % step - 1, i / step - 1); };
+    // Vein width across a centreline pixel from its distance to the background
+    auto width = [&](int i)
+    { return std::max(1.0, 2.0 * distance.at<float>(point(i)) - 1.0); };
+
+    // Pixels with three or more links, and those joined to them, make one junction
+    for (int i : pixels)
+    {
+        if (junction[i] >= 0 || degree(i) < 3)
+            continue;
+        const int id = static_cast<int>(graph.junctions.size());
+        cv::Point2f sum;
+        cluster.assign(1, i);
+        junction[i] = id;
+        for (size_t c = 0; c < cluster.size(); c++)
+        {
+            sum += cv::Point2f(point(cluster[c]));
+            int joined = links(cluster[c]);
+            for (int d = 0; d < 8; d++)
+            {
+                int j = cluster[c] + offsets[d];
+                if ((joined >> d & 1) && junction[j] < 0 && degree(j) >= 3)
+                {
+                    junction[j] = id;
+                    cluster.push_back(j);
+                }
+            }
+        }
+        VeinJunction found;
+        found.position = sum / static_cast<float>(cluster.size());
+        graph.junctions.push_back(found);
+    }
+
+    // Walk from start through first until a junction, a free end or back at start
+    auto trace = [&](int start, int first)
+    {
+        VeinSegment segment;
+        segment.startJunction = junction[start];
+        segment.points.push_back(point(start));
+        double widthSum = width(start);
+        int previous = start;
+        int current = first;
+        for (;;)
+        {
+            int delta = std::abs(current - previous);
+            segment.length += delta == 1 || delta == step ? 1.0 : DIAGONAL_STEP;
+            segment.points.push_back(point(current));
+            widthSum += width(current);
+            if (junction[current] >= 0)
+            {
+                segment.endJunction = junction[current];
+                break;
+            }
+            if (seen[current])
+                break;
+            seen[current] = 1;
+            int code = neighbourhood(base + current, step);
+            if (t.degree[code] != 2)
+                break;
+            int joined = t.links[code];
+            int following = -1;
+            for (int d = 0; d < 8 && following < 0; d++)
+            {
+                if ((joined >> d & 1) && current + offsets[d] != previous)
+                    following = current + offsets[d];
+            }
+            previous = current;
+            current = following;
+        }
+        segment.meanWidth = widthSum / segment.points.size();
+
+        bool closed = segment.startJunction >= 0 && segment.startJunction == segment.endJunction;
+        bool open = segment.startJunction < 0 || segment.endJunction < 0;
+        if ((open || closed) && segment.length < minBranchLength)
+            return;
+        if (segment.startJunction >= 0)
+            graph.junctions[segment.startJunction].degree++;
+        if (segment.endJunction >= 0)
+            graph.junctions[segment.endJunction].degree++;
+        graph.segments.push_back(std::move(segment));
+    };
+
+    // Branches leaving junctions, then chains between free ends, then loops
+    for (int i : pixels)
+    {
+        if (junction[i] < 0)
+            continue;
+        int joined = links(i);
+        for (int d = 0; d < 8; d++)
+        {
+            int j = i + offsets[d];
+            if ((joined >> d & 1) && junction[j] < 0 && !seen[j])
+                trace(i, j);
+        }
+    }
+    for (int pass = 1; pass <= 2; pass++)
+    {
+        for (int i : pixels)
+        {
+            if (junction[i] >= 0 || seen[i] || degree(i) != pass)
+                continue;
+            seen[i] = 1;
+            int joined = links(i);
+            int d = 0;
+            while (!(joined >> d & 1))
+                d++;
+            trace(i, i + offsets[d]);
+        }
+    }
+
+    for (int i : pixels)
+    {
+        junction[i] = -1;
+        seen[i] = 0;
+    }
+}
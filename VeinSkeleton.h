@@ -0,0 +1,67 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Point where vein centrelines meet
+struct VeinJunction
+{
+    cv::Point2f position;
+    int degree = 0; // Segments ending here, a loop through it counting twice
+};
+
+// Centreline between two junctions or free ends, or a closed loop
+struct VeinSegment
+{
+    std::vector<cv::Point> points; // In order along the centreline, neighbouring pixels
+    int startJunction = -1;        // Index into VeinGraph::junctions, -1 for a free end
+    int endJunction = -1;
+    double length = 0.0;    // Pixels, diagonal steps counting sqrt(2)
+    double meanWidth = 0.0; // Pixels across the vein
+};
+
+// Vein centrelines and branch points of one binary frame, in its pixel coordinates
+struct VeinGraph
+{
+    std::vector<VeinSegment> segments;
+    std::vector<VeinJunction> junctions;
+
+    void clear()
+    {
+        segments.clear();
+        junctions.clear();
+    }
+    bool empty() const { return segments.empty(); }
+};
+
+// Thins binary vein masks to one pixel wide centrelines and walks them into a
+// VeinGraph. Thinning is Zhang-Suen with both sub-iterations decided by lookup
+// tables over a pixel's 8-neighbourhood. Rows are thinned in parallel, and a row
+// is only revisited once something in or next to it was removed. Buffers are
+// kept between frames.
+class VeinSkeletoniser
+{
+public:
+    // Centrelines of a CV_8UC1 mask, 1 on a centreline and 0 elsewhere; valid until
+    // the next call
+    cv::Mat thin(const cv::Mat &binary);
+
+    // Thin binary and build its graph. Branches with a free end shorter than
+    // minBranchLength pixels are dropped as thinning spurs, as are loops that short.
+    void extract(const cv::Mat &binary, VeinGraph &graph, double minBranchLength = 8.0);
+
+private:
+    // One Zhang-Suen sub-iteration over the rows marked dirty for it
+    void thinPass(int subIteration);
+
+    cv::Mat image; // CV_8UC1, 0 or 1 with a background border of one pixel
+    cv::Mat next;  // Rows of image after the current pass
+    std::vector<uchar> dirty[2]; // Rows each sub-iteration still has to visit
+    std::vector<uchar> changed;  // Rows the current pass removed pixels from
+
+    cv::Mat distance;    // CV_32FC1 distance of each mask pixel to the background
+    cv::Mat junctionIds; // CV_32SC1 over image, -1 off junctions
+    cv::Mat visited;     // CV_8UC1 over image
+    std::vector<int> pixels;  // Centreline pixels, as offsets into image
+    std::vector<int> cluster; // Scratch for grouping junction pixels
+};
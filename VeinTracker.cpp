@@ -0,0 +1,265 @@
+#include "VeinTracker.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+// State: center x/y, width, height and their per-frame velocities
+constexpr int STATE_SIZE = 8;
+constexpr int MEASUREMENT_SIZE = 4;
+
+cv::Rect boxFromState(const cv::Mat &state)
+{
+    float cx = state.at<float>(0);
+    float cy = state.at<float>(1);
+    float w = std::max(1.0f, state.at<float>(2));
+    float h = std::max(1.0f, state.at<float>(3));
+    return cv::Rect(cvRound(cx - w * 0.5f), cvRound(cy - h * 0.5f), cvRound(w), cvRound(h));
+}
+
+cv::Mat measurementFromBox(const cv::Rect &box)
+{
+    return (cv::Mat_<float>(MEASUREMENT_SIZE, 1) << box.x + box.width * 0.5f,
+            box.y + box.height * 0.5f,
+            static_cast<float>(box.width),
+            static_cast<float>(box.height));
+}
+}
+
+VeinTracker::VeinTracker(const TrackerConfig &initialConfig)
+    : config(initialConfig), nextTrackId(1), framesSinceDetection(0)
+{
+}
+
+void VeinTracker::setConfig(const TrackerConfig &newConfig)
+{
+    config = newConfig;
+}
+
+const TrackerConfig &VeinTracker::getConfig() const
+{
+    return config;
+}
+
+bool VeinTracker::needsDetection(bool sceneIdle) const
+{
+    if ((tracks.empty() && !sceneIdle) || framesSinceDetection + 1 >= std::max(1, config.detectionInterval))
+        return true;
+
+    // Re-detect early when any track is losing confidence
+    for (const Track &track : tracks)
+    {
+        if (track.confidence < config.minTrackConfidence)
+            return true;
+    }
+    return false;
+}
+
+void VeinTracker::reset()
+{
+    tracks.clear();
+    framesSinceDetection = 0;
+}
+
+void VeinTracker::initTrack(Track &track, const Detection &detection)
+{
+    track.id = nextTrackId++;
+    track.box = detection.boundingBox;
+    track.confidence = detection.confidence;
+    track.classId = detection.classId;
+    track.className = detection.className;
+    track.misses = 0;
+
+    // Constant velocity model, one step per frame
+    track.filter.init(STATE_SIZE, MEASUREMENT_SIZE, 0, CV_32F);
+    cv::setIdentity(track.filter.transitionMatrix);
+    for (int i = 0; i < MEASUREMENT_SIZE; i++)
+    {
+        track.filter.transitionMatrix.at<float>(i, i + MEASUREMENT_SIZE) = 1.0f;
+    }
+    cv::setIdentity(track.filter.measurementMatrix);
+    cv::setIdentity(track.filter.processNoiseCov, cv::Scalar::all(1e-2));
+    cv::setIdentity(track.filter.measurementNoiseCov, cv::Scalar::all(1e-1));
+    cv::setIdentity(track.filter.errorCovPost, cv::Scalar::all(1.0));
+
+    track.filter.statePost.setTo(0);
+    measurementFromBox(detection.boundingBox).copyTo(track.filter.statePost.rowRange(0, MEASUREMENT_SIZE));
+}
+
+void VeinTracker::predictTracks()
+{
+    for (Track &track : tracks)
+    {
+        track.box = boxFromState(track.filter.predict());
+    }
+}
+
+void VeinTracker::update(const std::vector<Detection> &detections, std::vector<Detection> &tracked)
+{
+    predictTracks();
+    framesSinceDetection = 0;
+
+    int trackCount = static_cast<int>(tracks.size());
+    int detectionCount = static_cast<int>(detections.size());
+    int size = std::max(trackCount, detectionCount);
+
+    // Square IoU cost matrix; padded cells cost as much as no overlap
+    costMatrix.assign(static_cast<size_t>(size) * size, 1.0);
+    for (int t = 0; t < trackCount; t++)
+    {
+        for (int d = 0; d < detectionCount; d++)
+        {
+            costMatrix[t * size + d] = 1.0 - iou(tracks[t].box, detections[d].boundingBox);
+        }
+    }
+
+    solveAssignment(costMatrix, size, assignment);
+    detectionMatched.assign(detectionCount, false);
+
+    for (int t = 0; t < trackCount; t++)
+    {
+        Track &track = tracks[t];
+        int d = assignment[t];
+        if (d >= 0 && d < detectionCount && 1.0 - costMatrix[t * size + d] >= config.minIoU)
+        {
+            const Detection &detection = detections[d];
+            track.box = boxFromState(track.filter.correct(measurementFromBox(detection.boundingBox)));
+            track.confidence = 0.3f * track.confidence + 0.7f * detection.confidence;
+            track.classId = detection.classId;
+            track.className = detection.className;
+            track.misses = 0;
+            detectionMatched[d] = true;
+        }
+        else
+        {
+            track.misses++;
+            track.confidence *= config.predictionDecay * config.predictionDecay;
+        }
+    }
+
+    // Drop tracks the detector has not confirmed for too long
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                [this](const Track &track)
+                                { return track.misses > config.maxMisses; }),
+                 tracks.end());
+
+    // Unmatched detections start new tracks
+    for (int d = 0; d < detectionCount; d++)
+    {
+        if (!detectionMatched[d])
+        {
+            tracks.emplace_back();
+            initTrack(tracks.back(), detections[d]);
+        }
+    }
+
+    exportTracks(tracked);
+}
+
+void VeinTracker::predict(std::vector<Detection> &tracked)
+{
+    predictTracks();
+    framesSinceDetection++;
+
+    for (Track &track : tracks)
+    {
+        track.confidence *= config.predictionDecay;
+    }
+
+    exportTracks(tracked);
+}
+
+void VeinTracker::exportTracks(std::vector<Detection> &tracked) const
+{
+    tracked.clear();
+    for (const Track &track : tracks)
+    {
+        Detection detection;
+        detection.boundingBox = track.box;
+        detection.confidence = track.confidence;
+        detection.classId = track.classId;
+        detection.className = track.className;
+        detection.trackId = track.id;
+        tracked.push_back(detection);
+    }
+}
+
+double VeinTracker::iou(const cv::Rect &a, const cv::Rect &b)
+{
+    int intersection = (a & b).area();
+    int unionArea = a.area() + b.area() - intersection;
+    return unionArea > 0 ? static_cast<double>(intersection) / unionArea : 0.0;
+}
+
+// Hungarian method with potentials on a square row-major cost matrix.
+// assignment[row] receives the column assigned to each row.
+void VeinTracker::solveAssignment(const std::vector<double> &cost, int size, std::vector<int> &assignment)
+{
+    const double INF = std::numeric_limits<double>::max();
+    rowPotential.assign(size + 1, 0.0);
+    columnPotential.assign(size + 1, 0.0);
+    minValue.assign(size + 1, INF);
+    rowForColumn.assign(size + 1, 0);
+    way.assign(size + 1, 0);
+    used.assign(size + 1, 0);
+
+    for (int row = 1; row <= size; row++)
+    {
+        rowForColumn[0] = row;
+        int column = 0;
+        std::fill(minValue.begin(), minValue.end(), INF);
+        std::fill(used.begin(), used.end(), 0);
+
+        do
+        {
+            used[column] = 1;
+            int currentRow = rowForColumn[column];
+            double delta = INF;
+            int nextColumn = 0;
+            for (int j = 1; j <= size; j++)
+            {
+                if (used[j])
+                    continue;
+                double reduced = cost[(currentRow - 1) * size + (j - 1)] - rowPotential[currentRow] - columnPotential[j];
+                if (reduced < minValue[j])
+                {
+                    minValue[j] = reduced;
+                    way[j] = column;
+                }
+                if (minValue[j] < delta)
+                {
+                    delta = minValue[j];
+                    nextColumn = j;
+                }
+            }
+            for (int j = 0; j <= size; j++)
+            {
+                if (used[j])
+                {
+                    rowPotential[rowForColumn[j]] += delta;
+                    columnPotential[j] -= delta;
+                }
+                else
+                {
+                    minValue[j] -= delta;
+                }
+            }
+            column = nextColumn;
+        } while (rowForColumn[column] != 0);
+
+        // Augment along the alternating path
+        do
+        {
+            int previous = way[column];
+            rowForColumn[column] = rowForColumn[previous];
+            column = previous;
+        } while (column != 0);
+    }
+
+    assignment.assign(size, -1);
+    for (int j = 1; j <= size; j++)
+    {
+        if (rowForColumn[j] != 0)
+            assignment[rowForColumn[j] - 1] = j - 1;
+    }
+}
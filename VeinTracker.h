@@ -0,0 +1,78 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "VeinProcessor.h"
+
+// Tracking settings
+struct TrackerConfig
+{
+    bool enabled = true;
+    int detectionInterval = 3;          // Run the detector every N frames
+    float minTrackConfidence = 0.4f;    // Run the detector early when a track drops below this
+    float minIoU = 0.3f;                // Minimum overlap to associate a detection with a track
+    int maxMisses = 5;                  // Detector runs a track may go unmatched before removal
+    float predictionDecay = 0.95f;      // Confidence decay per predicted-only frame
+};
+
+// Multi-object tracker for vein detections.
+// Each track carries a constant-velocity Kalman filter over box center and size.
+// Detections are associated to predicted boxes with an IoU cost solved by the
+// Hungarian method, which gives detections stable ids and lets the detector run
+// only every few frames while tracks are predicted in between.
+class VeinTracker
+{
+public:
+    explicit VeinTracker(const TrackerConfig &config = TrackerConfig());
+
+    void setConfig(const TrackerConfig &newConfig);
+    const TrackerConfig &getConfig() const;
+
+    // True when the detector should run on the coming frame. Without tracks it runs
+    // every frame, unless the scene is idle and only an arriving arm is waited for
+    bool needsDetection(bool sceneIdle = false) const;
+
+    // Advance one frame using fresh detector output
+    void update(const std::vector<Detection> &detections, std::vector<Detection> &tracked);
+
+    // Advance one frame on prediction only
+    void predict(std::vector<Detection> &tracked);
+
+    void reset();
+
+private:
+    struct Track
+    {
+        int id;
+        cv::KalmanFilter filter;
+        cv::Rect box;
+        float confidence;
+        int classId;
+        std::string className;
+        int misses;
+    };
+
+    void initTrack(Track &track, const Detection &detection);
+    void predictTracks();
+    void exportTracks(std::vector<Detection> &tracked) const;
+
+    static double iou(const cv::Rect &a, const cv::Rect &b);
+    void solveAssignment(const std::vector<double> &cost, int size, std::vector<int> &assignment);
+
+    TrackerConfig config;
+    std::vector<Track> tracks;
+    int nextTrackId;
+    int framesSinceDetection;
+
+    // Scratch reused between detector runs
+    std::vector<double> costMatrix;
+    std::vector<int> assignment;
+    std::vector<bool> detectionMatched;
+    // Hungarian method potentials, path and visited columns, one-based
+    std::vector<double> rowPotential;
+    std::vector<double> columnPotential;
+    std::vector<double> minValue;
+    std::vector<int> rowForColumn;
+    std::vector<int> way;
+    std::vector<char> used;
+};
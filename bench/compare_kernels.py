@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Compare two kernelbench JSON reports.
+
+Benchmarks are matched by name. Exits with status 1 when any kernel got slower
+than the threshold, so it can gate a change:
+
+    python3 bench/compare_kernels.py baseline.json contender.json --threshold 5
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_times(path):
+    with open(path) as f:
+        report = json.load(f)
+    return {b["name"]: b["real_time"] for b in report.get("benchmarks", [])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two kernelbench reports")
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="Percent slowdown reported as a regression")
+    args = parser.parse_args()
+
+    baseline = load_times(args.baseline)
+    contender = load_times(args.contender)
+
+    regressions = 0
+    print(f"{'benchmark':<48} {'baseline us':>12} {'contender us':>12} {'change':>8}")
+    for name in sorted(baseline.keys() & contender.keys()):
+        before, after = baseline[name], contender[name]
+        change = (after - before) / before * 100.0 if before > 0 else 0.0
+        marker = ""
+        if change > args.threshold:
+            marker = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            marker = "  faster"
+        print(f"{name:<48} {before:>12.1f} {after:>12.1f} {change:>+7.1f}%{marker}")
+
+    for name in sorted(baseline.keys() - contender.keys()):
+        print(f"{name:<48} missing from contender")
+    for name in sorted(contender.keys() - baseline.keys()):
+        print(f"{name:<48} new in contender")
+
+    if regressions:
+        print(f"{regressions} benchmark(s) slower by more than {args.threshold}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,501 @@
+// Micro-benchmarks for the individual vein processing kernels.
+//
+// Every kernel runs on a synthetic forearm frame for each combination of
+// resolution, bit depth (where the kernel supports it) and OpenCV thread count.
+// Each case is repeated until --min-time has passed and reported as the median
+// of --repetitions runs. Results use Google Benchmark's JSON layout, so its
+// tools and bench/compare_kernels.py can diff two runs.
+//
+//   kernelbench --sizes vga,720p --threads 1,4 -o baseline.json
+//   kernelbench --filter clahe --depths 8,16
+//   kernelbench --verify --threads 1,4
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QSysInfo>
+#include <QThread>
+#include <QDebug>
+#include <linux/videodev2.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <time.h>
+#include <opencv2/opencv.hpp>
+#include "VeinProcessor.h"
+#include "DetectionOverlay.h"
+#include "PreviewWidget.h"
+#include "FrameSource.h"
+#include "FlatField.h"
+#include "SyntheticVeinGenerator.h"
+
+namespace
+{
+// Inputs shared by every kernel at one resolution and depth
+struct KernelInput
+{
+    cv::Mat bgr;    // CV_8UC3 camera frame
+    cv::Mat gray;   // CV_8UC1, or CV_16UC1 for 16-bit cases
+    cv::Mat binary; // Thresholded vein mask
+    cv::Mat yuyv;   // Raw YUYV buffer of the same frame
+    std::vector<Detection> detections;
+};
+
+using KernelRun = std::function<void()>;
+
+struct Kernel
+{
+    QString name;
+    QList<int> depths; // Bit depths the kernel accepts
+    std::function<KernelRun(const KernelInput &)> prepare;
+};
+
+struct NamedSize
+{
+    QString name;
+    cv::Size size;
+};
+
+const QList<NamedSize> KNOWN_SIZES = {
+    {"vga", cv::Size(640, 480)},
+    {"720p", cv::Size(1280, 720)},
+    {"1080p", cv::Size(1920, 1080)},
+    {"5mp", cv::Size(2592, 1944)},
+};
+
+// Each kernel gets its own processor so stateful stages do not interfere
+std::vector<Kernel> kernels()
+{
+    auto stage = [](cv::Mat (VeinProcessor::*apply)(const cv::Mat &))
+    {
+        return [apply](const KernelInput &input) -> KernelRun
+        {
+            auto processor = std::make_shared<VeinProcessor>();
+            return [processor, apply, &input]()
+            { cv::Mat result = ((*processor).*apply)(input.gray); };
+        };
+    };
+
+    std::vector<Kernel> list;
+    list.push_back({"median", {8, 16}, stage(&VeinProcessor::applyMedianFilter)});
+    list.push_back({"gaussian", {8, 16}, stage(&VeinProcessor::applyGaussianFilter)});
+    list.push_back({"bilateral", {8, 16}, stage(&VeinProcessor::applyBilateralFilter)});
+    list.push_back({"temporal", {8}, stage(&VeinProcessor::applyTemporalDenoise)});
+    list.push_back({"statistics", {8, 16}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto stats = std::make_shared<FrameStatistics>();
+                        return [stats, &input]()
+                        { stats->compute(input.gray, cv::Size(8, 8)); };
+                    }});
+    list.push_back({"clahe", {8, 16}, stage(&VeinProcessor::applyCLAHE)});
+    list.push_back({"contrast", {8, 16}, stage(&VeinProcessor::applyContrastEnhancement)});
+    list.push_back({"threshold", {8, 16}, stage(&VeinProcessor::applyAdaptiveThreshold)});
+    list.push_back({"morphology", {8, 16}, stage(&VeinProcessor::applyMorphology)});
+    // Contrast, enhancement and threshold in one pass, against the three cases above
+    list.push_back({"fused", {8, 16}, stage(&VeinProcessor::applyFusedStages)});
+
+    list.push_back({"enhancement", {8, 16}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto processor = std::make_shared<VeinProcessor>();
+                        return [processor, &input]()
+                        { cv::Mat result = processor->applyVeinEnhancement(input.gray, input.gray); };
+                    }});
+
+    // Labelling and measuring alone, as findVeinRegions runs it
+    list.push_back({"components", {8}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto labeller = std::make_shared<ComponentLabeller>();
+                        return [labeller, &input]()
+                        { labeller->label(input.binary); };
+                    }});
+
+    list.push_back({"regions", {8}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto processor = std::make_shared<VeinProcessor>();
+                        return [processor, &input]()
+                        { std::vector<Detection> regions = processor->findVeinRegions(input.binary, 0.5f); };
+                    }});
+
+    // Thinning and graph walking of the binary frame into centrelines
+    list.push_back({"skeleton", {8}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto processor = std::make_shared<VeinProcessor>();
+                        auto graph = std::make_shared<VeinGraph>();
+                        return [processor, graph, &input]()
+                        { processor->extractVeinGraph(input.binary, *graph); };
+                    }});
+
+    // 16-bit frames enter the chain as a Y16 camera delivers them, single channel
+    list.push_back({"binary_chain", {8, 16}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto processor = std::make_shared<VeinProcessor>();
+                        const cv::Mat *frame = input.gray.depth() == CV_16U ? &input.gray : &input.bgr;
+                        return [processor, frame]()
+                        { cv::Mat result = processor->getVeinBinaryFrame(*frame); };
+                    }});
+    list.push_back({"binary_chain_unfused", {8, 16}, [](const KernelInput &input) -> KernelRun
+                    {
+                        VeinProcessingConfig config;
+                        config.fuseStages = false;
+                        auto processor = std::make_shared<VeinProcessor>(config);
+                        const cv::Mat *frame = input.gray.depth() == CV_16U ? &input.gray : &input.bgr;
+                        return [processor, frame]()
+                        { cv::Mat result = processor->getVeinBinaryFrame(*frame); };
+                    }});
+
+    // Capture conversion of a raw YUYV buffer to the BGR frame the pipeline sees
+    list.push_back({"yuyv_to_bgr", {8}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto output = std::make_shared<cv::Mat>();
+                        RawFrame raw;
+                        raw.pixelFormat = V4L2_PIX_FMT_YUYV;
+                        raw.width = input.bgr.cols;
+                        raw.height = input.bgr.rows;
+                        raw.bytesPerLine = static_cast<int>(input.yuyv.step);
+                        raw.data = input.yuyv.data;
+                        raw.size = input.yuyv.total() * input.yuyv.elemSize();
+                        return [output, raw]()
+                        { convertRawFrame(raw, *output); };
+                    }});
+
+    // Corrected luma extraction at ingest, from a BGR or Y16 frame, against a radial falloff
+    list.push_back({"flatfield", {8, 16}, [](const KernelInput &input) -> KernelRun
+                    {
+                        cv::Mat flat(input.gray.size(), CV_32FC1);
+                        cv::Point2f center(flat.cols * 0.5f, flat.rows * 0.5f);
+                        float radius = std::hypot(center.x, center.y);
+                        for (int y = 0; y < flat.rows; y++)
+                        {
+                            for (int x = 0; x < flat.cols; x++)
+                            {
+                                float r = std::hypot(x - center.x, y - center.y) / radius;
+                                flat.at<float>(y, x) = 60000.0f * (1.0f - 0.6f * r * r);
+                            }
+                        }
+                        auto correction = std::make_shared<FlatFieldCorrection>();
+                        correction->setReferences(cv::Mat::zeros(flat.size(), CV_32FC1), flat);
+                        auto output = std::make_shared<cv::Mat>();
+                        const cv::Mat *frame = input.gray.depth() == CV_16U ? &input.gray : &input.bgr;
+                        return [correction, output, frame]()
+                        { correction->apply(*frame, cv::Rect(), *output); };
+                    }});
+
+    // Preview scaling done for every presented frame
+    list.push_back({"preview", {8, 16}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto preview = std::make_shared<PreviewWidget>();
+                        preview->resize(320, 240);
+                        const cv::Mat *frame = input.gray.depth() == CV_16U ? &input.gray : &input.bgr;
+                        return [preview, frame]()
+                        { preview->setFrame(*frame); };
+                    }});
+
+    // Marker building and painting, as drawDetections and the preview paint event do
+    list.push_back({"draw_detections", {8}, [](const KernelInput &input) -> KernelRun
+                    {
+                        auto overlay = std::make_shared<DetectionOverlay>();
+                        auto canvas = std::make_shared<QImage>(320, 240, QImage::Format_RGB32);
+                        double scale = std::min(320.0 / input.bgr.cols, 240.0 / input.bgr.rows);
+                        return [overlay, canvas, scale, &input]()
+                        {
+                            overlay->clear();
+                            for (size_t i = 0; i < input.detections.size(); i++)
+                            {
+                                const Detection &detection = input.detections[i];
+                                QPointF center(detection.boundingBox.x + detection.boundingBox.width * 0.5,
+                                               detection.boundingBox.y + detection.boundingBox.height * 0.5);
+                                overlay->addMarker(center, i == 0, detection.classId, detection.className, detection.confidence);
+                            }
+                            QPainter painter(canvas.get());
+                            overlay->paint(painter, QRectF(0, 0, input.bgr.cols * scale, input.bgr.rows * scale), scale);
+                        };
+                    }});
+
+    return list;
+}
+
+KernelInput makeInput(cv::Size size, int depth)
+{
+    SyntheticVeinConfig config;
+    config.width = size.width;
+    config.height = size.height;
+    SyntheticVeinGenerator generator(config);
+    SyntheticFrame frame;
+    generator.render(0, frame);
+
+    KernelInput input;
+    cv::cvtColor(frame.image, input.bgr, cv::COLOR_GRAY2BGR);
+    if (depth == 16)
+        frame.image.convertTo(input.gray, CV_16U, 257.0);
+    else
+        input.gray = frame.image.clone();
+
+    VeinProcessor processor;
+    input.binary = processor.getVeinBinaryFrame(input.bgr);
+    input.detections = processor.findVeinRegions(input.binary, 0.0f);
+
+    // Pack the gray frame as YUYV with neutral chroma
+    input.yuyv.create(size.height, size.width, CV_8UC2);
+    for (int y = 0; y < size.height; y++)
+    {
+        const uchar *luma = frame.image.ptr<uchar>(y);
+        uchar *packed = input.yuyv.ptr<uchar>(y);
+        for (int x = 0; x < size.width; x++)
+        {
+            packed[2 * x] = luma[x];
+            packed[2 * x + 1] = 128;
+        }
+    }
+    return input;
+}
+
+// CPU time of every thread in the process, so OpenCV's workers are counted too
+double processCpuNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+struct KernelTiming
+{
+    double realNs = 0.0; // Mean wall-clock time per iteration
+    double cpuNs = 0.0;  // Mean process CPU time per iteration
+    qint64 iterations = 0;
+};
+
+// Run until minTime has passed
+KernelTiming timeKernel(const KernelRun &run, double minTime)
+{
+    using Clock = std::chrono::steady_clock;
+    run(); // Warm caches and lazily allocated buffers
+
+    KernelTiming timing;
+    qint64 batch = 1;
+    Clock::duration elapsed{};
+    double cpuNs = 0.0;
+    while (std::chrono::duration<double>(elapsed).count() < minTime)
+    {
+        auto start = Clock::now();
+        double cpuStart = processCpuNs();
+        for (qint64 i = 0; i < batch; i++)
+            run();
+        cpuNs += processCpuNs() - cpuStart;
+        elapsed += Clock::now() - start;
+        timing.iterations += batch;
+        batch = std::min<qint64>(batch * 2, 1 << 16);
+    }
+    timing.realNs = std::chrono::duration<double, std::nano>(elapsed).count() / timing.iterations;
+    timing.cpuNs = cpuNs / timing.iterations;
+    return timing;
+}
+
+QList<int> parseInts(const QString &value)
+{
+    QList<int> values;
+    for (const QString &item : value.split(',', Qt::SkipEmptyParts))
+        values.append(item.toInt());
+    return values;
+}
+
+// Compare getVeinBinaryFrame() with fuseStages on and off for every combination of
+// the stages fusion covers, with fixed and statistics-driven contrast; returns the
+// number of cases whose masks differ
+int verifyFusion(const QList<NamedSize> &sizes, const QList<int> &depths, const QList<int> &threadCounts)
+{
+    int failures = 0;
+    for (const NamedSize &size : sizes)
+    {
+        for (int depth : depths)
+        {
+            KernelInput input = makeInput(size.size, depth);
+            const cv::Mat &frame = depth == 16 ? input.gray : input.bgr;
+            for (int threads : threadCounts)
+            {
+                cv::setNumThreads(threads);
+                for (int stages = 0; stages < 16; stages++)
+                {
+                    VeinProcessingConfig config;
+                    config.contrastEnabled = stages & 1;
+                    config.veinEnhancementEnabled = stages & 2;
+                    config.adaptiveThresholdEnabled = stages & 4;
+                    config.claheEnabled = !(stages & 8);
+                    config.autoContrast = stages & 8;
+                    config.fuseStages = false;
+                    cv::Mat expected = VeinProcessor(config).getVeinBinaryFrame(frame);
+                    config.fuseStages = true;
+                    cv::Mat fused = VeinProcessor(config).getVeinBinaryFrame(frame);
+
+                    QString name = QString("%1/%2bit/threads:%3/contrast:%4/enhance:%5/adaptive:%6/auto:%7")
+                                       .arg(size.name)
+                                       .arg(depth)
+                                       .arg(threads)
+                                       .arg(stages & 1)
+                                       .arg(stages >> 1 & 1)
+                                       .arg(stages >> 2 & 1)
+                                       .arg(stages >> 3 & 1);
+                    if (expected.size() != fused.size() || expected.type() != fused.type())
+                    {
+                        qWarning().noquote() << name << "fused mask has a different size or type";
+                        failures++;
+                    }
+                    else if (int differing = cv::countNonZero(expected != fused))
+                    {
+                        qWarning().noquote() << name << differing << "pixels differ";
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    return failures;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // Widgets and painting are benchmarked without a display
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("kernelbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Micro-benchmarks for the vein processing kernels");
+    parser.addHelpOption();
+    parser.addOption({{"f", "filter"}, "Only run benchmarks whose name matches this regex.", "regex", "."});
+    parser.addOption({{"s", "sizes"}, "Comma separated: vga, 720p, 1080p, 5mp or WxH.", "list", "vga,720p,1080p,5mp"});
+    parser.addOption({{"d", "depths"}, "Comma separated bit depths: 8, 16.", "list", "8,16"});
+    parser.addOption({{"t", "threads"}, "Comma separated OpenCV thread counts.", "list", "1"});
+    parser.addOption({"min-time", "Seconds each repetition runs for.", "seconds", "0.3"});
+    parser.addOption({"repetitions", "Repetitions per case; the median is reported.", "n", "3"});
+    parser.addOption({{"o", "output"}, "Write JSON here instead of stdout.", "file"});
+    parser.addOption({"verify", "Check the fused vein chain against the stage-by-stage one instead of timing."});
+    parser.process(app);
+
+    QRegularExpression filter(parser.value("filter"));
+    QList<int> depths = parseInts(parser.value("depths"));
+    QList<int> threadCounts = parseInts(parser.value("threads"));
+    double minTime = std::max(0.01, parser.value("min-time").toDouble());
+    int repetitions = std::max(1, parser.value("repetitions").toInt());
+
+    QList<NamedSize> sizes;
+    for (const QString &item : parser.value("sizes").split(',', Qt::SkipEmptyParts))
+    {
+        auto known = std::find_if(KNOWN_SIZES.begin(), KNOWN_SIZES.end(), [&](const NamedSize &size)
+                                  { return size.name == item; });
+        QStringList parts = item.split('x');
+        if (known != KNOWN_SIZES.end())
+            sizes.append(*known);
+        else if (parts.size() == 2)
+            sizes.append({item, cv::Size(parts[0].toInt(), parts[1].toInt())});
+        else
+            qWarning() << "Ignoring unknown size" << item;
+    }
+
+    if (parser.isSet("verify"))
+    {
+        int failures = verifyFusion(sizes, depths, threadCounts);
+        if (failures)
+            qWarning() << "Fused chain differs from the stage-by-stage one in" << failures << "cases";
+        else
+            qInfo() << "Fused chain matches the stage-by-stage one in every case";
+        return failures ? 1 : 0;
+    }
+
+    std::vector<Kernel> kernelList = kernels();
+    QJsonArray benchmarks;
+    for (const NamedSize &size : sizes)
+    {
+        for (int depth : depths)
+        {
+            KernelInput input = makeInput(size.size, depth);
+            for (const Kernel &kernel : kernelList)
+            {
+                if (!kernel.depths.contains(depth))
+                    continue;
+                for (int threads : threadCounts)
+                {
+                    // Stable names: kernel/size/depth/threads
+                    QString name = QString("%1/%2/%3bit/threads:%4").arg(kernel.name, size.name).arg(depth).arg(threads);
+                    if (!filter.match(name).hasMatch())
+                        continue;
+
+                    cv::setNumThreads(threads);
+                    KernelRun run = kernel.prepare(input);
+                    std::vector<double> samples;
+                    std::vector<double> cpuSamples;
+                    qint64 iterations = 0;
+                    for (int r = 0; r < repetitions; r++)
+                    {
+                        KernelTiming timing = timeKernel(run, minTime);
+                        samples.push_back(timing.realNs);
+                        cpuSamples.push_back(timing.cpuNs);
+                        iterations += timing.iterations;
+                    }
+                    std::sort(samples.begin(), samples.end());
+                    std::sort(cpuSamples.begin(), cpuSamples.end());
+                    double median = samples[samples.size() / 2];
+
+                    QJsonObject result;
+                    result["name"] = name;
+                    result["run_type"] = "aggregate";
+                    result["aggregate_name"] = "median";
+                    result["repetitions"] = repetitions;
+                    result["iterations"] = iterations;
+                    result["real_time"] = median / 1000.0;
+                    result["cpu_time"] = cpuSamples[cpuSamples.size() / 2] / 1000.0;
+                    result["min_time"] = samples.front() / 1000.0;
+                    result["max_time"] = samples.back() / 1000.0;
+                    result["time_unit"] = "us";
+                    result["items_per_second"] = 1e9 / median;
+                    result["pixels_per_second"] = 1e9 / median * size.size.area();
+                    benchmarks.append(result);
+
+                    qInfo().noquote() << QString("%1 %2 us").arg(name, -40).arg(median / 1000.0, 10, 'f', 1);
+                }
+            }
+        }
+    }
+
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    context["host_name"] = QSysInfo::machineHostName();
+    context["executable"] = QCoreApplication::applicationFilePath();
+    context["num_cpus"] = QThread::idealThreadCount();
+    context["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    context["opencv_version"] = CV_VERSION;
+    context["opencv_simd"] = QString::fromStdString(cv::getCPUFeaturesLine());
+#ifdef NDEBUG
+    context["library_build_type"] = "release";
+#else
+    context["library_build_type"] = "debug";
+#endif
+
+    QJsonObject report;
+    report["context"] = context;
+    report["benchmarks"] = benchmarks;
+
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet("output"))
+    {
+        QFile file(parser.value("output"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qCritical() << "Cannot write" << parser.value("output");
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return 0;
+}
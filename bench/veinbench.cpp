@@ -0,0 +1,494 @@
+// Headless benchmark for the vein processing pipeline.
+//
+// Runs VeinProcessor (binary frame + region search) and VeinTracker over frames
+// from an image directory, a video file, a raw .veinrec recording or
+// SyntheticVeinGenerator, sweeping configuration variants, resolutions and
+// OpenCV thread counts. Reports frames/s, per-stage latency and heap
+// allocations per frame as JSON, plus detection quality against ground truth
+// for synthetic input. With --alloc-budget it exits with status 2 when any
+// measured frame allocates more than the budget, so allocator churn in the
+// steady-state loop breaks the run.
+//
+//   veinbench --input synthetic --resolutions 640x480,1280x720 --threads 1,4
+//   veinbench --input /data/capture --configs default,temporal -o results.json
+//   veinbench --frames 100 --alloc-budget 0
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QThread>
+#include <QDebug>
+#include <chrono>
+#include <opencv2/opencv.hpp>
+#include "VeinProcessor.h"
+#include "VeinTracker.h"
+#include "PipelineMetrics.h"
+#include "AllocationTracker.h"
+#include "SyntheticVeinGenerator.h"
+#include "ReplayFrameSource.h"
+
+namespace
+{
+struct NamedConfig
+{
+    QString name;
+    VeinProcessingConfig config;
+};
+
+// Configuration variants selectable with --configs
+std::vector<NamedConfig> availableConfigs()
+{
+    std::vector<NamedConfig> configs;
+
+    configs.push_back({"default", VeinProcessingConfig()});
+
+    VeinProcessingConfig temporal;
+    temporal.temporalDenoiseEnabled = true;
+    configs.push_back({"temporal", temporal});
+
+    VeinProcessingConfig noBilateral;
+    noBilateral.bilateralFilterEnabled = false;
+    configs.push_back({"no-bilateral", noBilateral});
+
+    VeinProcessingConfig minimal;
+    minimal.medianFilterEnabled = false;
+    minimal.gaussianFilterEnabled = false;
+    minimal.bilateralFilterEnabled = false;
+    minimal.contrastEnabled = false;
+    minimal.veinEnhancementEnabled = false;
+    configs.push_back({"minimal", minimal});
+
+    return configs;
+}
+
+// One input frame, with ground truth when it was rendered synthetically
+struct BenchFrame
+{
+    cv::Mat image;
+    cv::Mat vesselMask;
+    std::vector<cv::Rect> vesselBoxes;
+};
+
+// Detection quality against synthetic ground truth, summed over detector frames
+struct QualityCounts
+{
+    uint64_t vesselPixels = 0;
+    uint64_t binaryPixels = 0;
+    uint64_t overlapPixels = 0;
+    uint64_t regions = 0;
+    uint64_t regionsOnVessel = 0;
+    uint64_t trees = 0;
+    uint64_t treesFound = 0;
+};
+
+std::vector<cv::Mat> loadRecordedFrames(const QString &input, int maxFrames)
+{
+    std::vector<cv::Mat> frames;
+
+    if (input.endsWith(".veinrec"))
+    {
+        // Raw recordings go through the same conversion as live capture
+        ReplayFrameSource replay(input, ReplayFrameSource::Fast, false);
+        cv::Mat frame;
+        if (replay.open())
+        {
+            while (static_cast<int>(frames.size()) < maxFrames && replay.read(frame))
+                frames.push_back(frame.clone());
+        }
+        return frames;
+    }
+
+    QDir dir(input);
+    if (dir.exists())
+    {
+        QStringList files = dir.entryList({"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tif", "*.tiff", "*.pgm"},
+                                          QDir::Files, QDir::Name);
+        for (const QString &file : files)
+        {
+            if (static_cast<int>(frames.size()) >= maxFrames)
+                break;
+            cv::Mat frame = cv::imread(dir.filePath(file).toStdString(), cv::IMREAD_COLOR);
+            if (!frame.empty())
+                frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    cv::VideoCapture video(input.toStdString());
+    cv::Mat frame;
+    while (static_cast<int>(frames.size()) < maxFrames && video.read(frame) && !frame.empty())
+    {
+        frames.push_back(frame.clone());
+    }
+    return frames;
+}
+
+// Frames at one resolution, prepared before timing so loading and resizing do not count.
+// Synthetic frames are rendered at the target size so the ground truth lines up.
+std::vector<BenchFrame> prepareFrames(const std::vector<cv::Mat> &recorded, bool synthetic, cv::Size size,
+                                      int frameCount, uint64_t seed, int depth)
+{
+    std::vector<BenchFrame> frames;
+
+    if (synthetic)
+    {
+        SyntheticVeinConfig config;
+        if (!size.empty())
+        {
+            config.width = size.width;
+            config.height = size.height;
+        }
+        config.seed = seed;
+        SyntheticVeinGenerator generator(config);
+        SyntheticFrame rendered;
+        for (int i = 0; i < frameCount; i++)
+        {
+            generator.render(i, rendered);
+            BenchFrame frame;
+            // 16-bit frames arrive as a Y16 NIR camera delivers them: one full range channel
+            if (depth == 16)
+                rendered.image.convertTo(frame.image, CV_16U, 257.0);
+            else
+                cv::cvtColor(rendered.image, frame.image, cv::COLOR_GRAY2BGR);
+            frame.vesselMask = rendered.vesselMask.clone();
+            frame.vesselBoxes = rendered.vesselBoxes;
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    for (const cv::Mat &image : recorded)
+    {
+        BenchFrame frame;
+        if (size.empty() || image.size() == size)
+            frame.image = image;
+        else
+            cv::resize(image, frame.image, size, 0, 0, cv::INTER_AREA);
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+void evaluateQuality(const BenchFrame &frame, const cv::Mat &binary, const std::vector<Detection> &detections,
+                     cv::Mat &overlap, QualityCounts &quality)
+{
+    if (frame.vesselMask.empty() || binary.size() != frame.vesselMask.size())
+        return;
+
+    cv::bitwise_and(binary, frame.vesselMask, overlap);
+    quality.vesselPixels += cv::countNonZero(frame.vesselMask);
+    quality.binaryPixels += cv::countNonZero(binary);
+    quality.overlapPixels += cv::countNonZero(overlap);
+
+    cv::Rect frameRect(0, 0, binary.cols, binary.rows);
+    for (const Detection &detection : detections)
+    {
+        cv::Rect box = detection.boundingBox & frameRect;
+        quality.regions++;
+        if (box.area() > 0 && cv::countNonZero(frame.vesselMask(box)) > 0)
+            quality.regionsOnVessel++;
+    }
+    for (const cv::Rect &tree : frame.vesselBoxes)
+    {
+        quality.trees++;
+        for (const Detection &detection : detections)
+        {
+            if ((tree & detection.boundingBox).area() > 0)
+            {
+                quality.treesFound++;
+                break;
+            }
+        }
+    }
+}
+
+double ratio(uint64_t numerator, uint64_t denominator)
+{
+    return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+QList<cv::Size> parseResolutions(const QString &value)
+{
+    QList<cv::Size> sizes;
+    for (const QString &item : value.split(',', Qt::SkipEmptyParts))
+    {
+        QStringList parts = item.split('x');
+        if (parts.size() == 2)
+            sizes.append(cv::Size(parts[0].toInt(), parts[1].toInt()));
+        else if (item == "native")
+            sizes.append(cv::Size());
+    }
+    return sizes;
+}
+
+QList<int> parseInts(const QString &value)
+{
+    QList<int> values;
+    for (const QString &item : value.split(',', Qt::SkipEmptyParts))
+        values.append(item.toInt());
+    return values;
+}
+
+QJsonObject runBenchmark(const NamedConfig &named, const std::vector<BenchFrame> &frames, int threads,
+                         int warmup, int detectEvery, float threshold, qint64 allocationBudget)
+{
+    cv::setNumThreads(threads);
+
+    PipelineMetrics metrics;
+    VeinProcessor processor(named.config);
+    processor.setMetrics(&metrics);
+
+    TrackerConfig trackerConfig;
+    trackerConfig.enabled = detectEvery > 1;
+    trackerConfig.detectionInterval = detectEvery;
+    VeinTracker tracker(trackerConfig);
+
+    cv::Mat binary;
+    std::vector<Detection> detections;
+    std::vector<Detection> tracked;
+
+    // Same detect/track split as the capture thread; returns true on detector frames
+    auto processFrame = [&](const cv::Mat &frame)
+    {
+        if (trackerConfig.enabled && !tracker.needsDetection())
+        {
+            StageTimer timer(&metrics, PipelineStage::Tracking);
+            tracker.predict(tracked);
+            return false;
+        }
+
+        {
+            StageTimer timer(&metrics, PipelineStage::Detection);
+            binary = processor.getVeinBinaryFrame(frame);
+            detections = processor.findVeinRegions(binary, threshold);
+        }
+        if (trackerConfig.enabled)
+        {
+            StageTimer timer(&metrics, PipelineStage::Tracking);
+            tracker.update(detections, tracked);
+        }
+        return true;
+    };
+
+    for (int i = 0; i < warmup && !frames.empty(); i++)
+        processFrame(frames[i % frames.size()].image);
+    metrics.reset();
+
+    // Only the pipeline is timed and counted; quality scoring runs between frames
+    std::chrono::steady_clock::duration elapsed{};
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t maxFrameAllocations = 0;
+    int framesOverBudget = 0;
+    uint64_t outputTotal = 0;
+    quint64 frameNumber = 0;
+    QualityCounts quality;
+    cv::Mat overlap;
+
+    for (const BenchFrame &frame : frames)
+    {
+        // Process-wide, so allocations on OpenCV worker threads count too
+        AllocationTracker::Counts allocationsBefore = AllocationTracker::processCounts();
+        auto start = std::chrono::steady_clock::now();
+        FrameTracer::setFrameId(frameNumber++);
+        bool detected = processFrame(frame.image);
+        elapsed += std::chrono::steady_clock::now() - start;
+        AllocationTracker::Counts frameAllocations = AllocationTracker::processCounts() - allocationsBefore;
+        metrics.frameAllocations().record(frameAllocations);
+        allocations += frameAllocations.allocations;
+        bytes += frameAllocations.bytes;
+        maxFrameAllocations = std::max(maxFrameAllocations, frameAllocations.allocations);
+        if (allocationBudget >= 0 && frameAllocations.allocations > static_cast<uint64_t>(allocationBudget))
+            framesOverBudget++;
+
+        outputTotal += trackerConfig.enabled ? tracked.size() : detections.size();
+        if (detected)
+            evaluateQuality(frame, binary, detections, overlap, quality);
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double frameCount = std::max<size_t>(1, frames.size());
+
+    QJsonObject run;
+    run["config"] = named.name;
+    run["width"] = frames.empty() ? 0 : frames.front().image.cols;
+    run["height"] = frames.empty() ? 0 : frames.front().image.rows;
+    run["threads"] = cv::getNumThreads();
+    run["frames"] = static_cast<int>(frames.size());
+    run["detect_every"] = detectEvery;
+    run["seconds"] = seconds;
+    run["fps"] = seconds > 0.0 ? frames.size() / seconds : 0.0;
+    run["ms_per_frame"] = seconds * 1000.0 / frameCount;
+    run["allocations_per_frame"] = allocations / frameCount;
+    run["allocated_bytes_per_frame"] = bytes / frameCount;
+    run["max_allocations_per_frame"] = static_cast<qint64>(maxFrameAllocations);
+    if (allocationBudget >= 0)
+    {
+        run["allocation_budget"] = allocationBudget;
+        run["frames_over_budget"] = framesOverBudget;
+    }
+    run["detections_per_frame"] = outputTotal / frameCount;
+    run["stages"] = metrics.toJson();
+
+    if (quality.trees > 0)
+    {
+        QJsonObject scores;
+        scores["pixel_precision"] = ratio(quality.overlapPixels, quality.binaryPixels);
+        scores["pixel_recall"] = ratio(quality.overlapPixels, quality.vesselPixels);
+        scores["region_precision"] = ratio(quality.regionsOnVessel, quality.regions);
+        scores["vessel_recall"] = ratio(quality.treesFound, quality.trees);
+        run["quality"] = scores;
+    }
+    return run;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    AllocationTracker::install();
+    AllocationTracker::setEnabled(true);
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("veinbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless benchmark for the vein processing pipeline");
+    parser.addHelpOption();
+    parser.addOption({{"i", "input"}, "Image directory, video file, .veinrec recording or 'synthetic'.", "source", "synthetic"});
+    parser.addOption({{"n", "frames"}, "Frames per run.", "count", "300"});
+    parser.addOption({"warmup", "Unmeasured frames before each run.", "count", "30"});
+    parser.addOption({{"r", "resolutions"}, "Comma separated WxH list, or 'native'.", "list", "native"});
+    parser.addOption({{"t", "threads"}, "Comma separated OpenCV thread counts.", "list", "1"});
+    parser.addOption({{"c", "configs"}, "Comma separated config variants (default, temporal, no-bilateral, minimal, all).", "list", "default"});
+    parser.addOption({"detect-every", "Run the detector every N frames and track in between.", "n", "1"});
+    parser.addOption({"threshold", "Region confidence threshold.", "value", "0.5"});
+    parser.addOption({"seed", "Seed for the synthetic generator.", "value", "1"});
+    parser.addOption({"depth", "Synthetic frame depth: 8 for BGR, 16 for Y16-style gray.", "bits", "8"});
+    parser.addOption({{"o", "output"}, "Write JSON here instead of stdout.", "file"});
+    parser.addOption({"trace", "Write a Chrome trace of the last frames of all runs here.", "file"});
+    parser.addOption({"alloc-budget", "Fail when a measured frame makes more heap allocations than this.", "count"});
+    parser.process(app);
+
+    int frameCount = std::max(1, parser.value("frames").toInt());
+    bool synthetic = parser.value("input") == "synthetic";
+    std::vector<cv::Mat> recorded;
+    if (!synthetic)
+    {
+        recorded = loadRecordedFrames(parser.value("input"), frameCount);
+        if (recorded.empty())
+        {
+            qCritical() << "No frames loaded from" << parser.value("input");
+            return 1;
+        }
+    }
+
+    QStringList configNames = parser.value("configs").split(',', Qt::SkipEmptyParts);
+    std::vector<NamedConfig> configs;
+    for (const NamedConfig &named : availableConfigs())
+    {
+        if (configNames.contains("all") || configNames.contains(named.name))
+            configs.push_back(named);
+    }
+    if (configs.empty())
+    {
+        qCritical() << "Unknown config variants:" << configNames;
+        return 1;
+    }
+
+    QList<cv::Size> resolutions = parseResolutions(parser.value("resolutions"));
+    if (resolutions.isEmpty())
+        resolutions.append(cv::Size());
+    QList<int> threadCounts = parseInts(parser.value("threads"));
+    if (threadCounts.isEmpty())
+        threadCounts.append(1);
+
+    int warmup = std::max(0, parser.value("warmup").toInt());
+    int detectEvery = std::max(1, parser.value("detect-every").toInt());
+    int depth = parser.value("depth").toInt() == 16 ? 16 : 8;
+    float threshold = parser.value("threshold").toFloat();
+    qint64 allocationBudget = parser.isSet("alloc-budget") ? std::max(0LL, parser.value("alloc-budget").toLongLong()) : -1;
+    int runsOverBudget = 0;
+
+    FrameTracer::setEnabled(parser.isSet("trace"));
+    FrameTracer::setThreadName("veinbench");
+
+    QJsonArray runs;
+    for (const cv::Size &size : resolutions)
+    {
+        std::vector<BenchFrame> frames = prepareFrames(recorded, synthetic, size, frameCount,
+                                                       parser.value("seed").toULongLong(), depth);
+        for (const NamedConfig &named : configs)
+        {
+            for (int threads : threadCounts)
+            {
+                QJsonObject run = runBenchmark(named, frames, threads, warmup, detectEvery, threshold, allocationBudget);
+                qInfo().noquote() << QString("%1 %2x%3 threads=%4: %5 fps, %6 allocations/frame")
+                                         .arg(named.name)
+                                         .arg(run["width"].toInt())
+                                         .arg(run["height"].toInt())
+                                         .arg(run["threads"].toInt())
+                                         .arg(run["fps"].toDouble(), 0, 'f', 1)
+                                         .arg(run["allocations_per_frame"].toDouble(), 0, 'f', 1);
+                if (run["frames_over_budget"].toInt() > 0)
+                {
+                    qCritical().noquote() << QString("%1 of %2 frames exceeded the allocation budget of %3 (max %4)")
+                                                 .arg(run["frames_over_budget"].toInt())
+                                                 .arg(run["frames"].toInt())
+                                                 .arg(allocationBudget)
+                                                 .arg(run["max_allocations_per_frame"].toInteger());
+                    runsOverBudget++;
+                }
+                runs.append(run);
+            }
+        }
+    }
+
+    if (parser.isSet("trace"))
+        FrameTracer::writeChromeTrace(parser.value("trace"));
+
+    QJsonObject build;
+    build["opencv"] = CV_VERSION;
+    build["qt"] = QT_VERSION_STR;
+    build["compiler"] = __VERSION__;
+#ifdef NDEBUG
+    build["type"] = "release";
+#else
+    build["type"] = "debug";
+#endif
+
+    QJsonObject machine;
+    machine["hostname"] = QSysInfo::machineHostName();
+    machine["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    machine["kernel"] = QSysInfo::kernelVersion();
+    machine["logical_cpus"] = QThread::idealThreadCount();
+    machine["opencv_simd"] = QString::fromStdString(cv::getCPUFeaturesLine());
+
+    QJsonObject report;
+    report["input"] = parser.value("input");
+    if (synthetic)
+        report["depth"] = depth;
+    report["build"] = build;
+    report["machine"] = machine;
+    report["runs"] = runs;
+
+    QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet("output"))
+    {
+        QFile file(parser.value("output"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qCritical() << "Cannot write" << parser.value("output");
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return runsOverBudget > 0 ? 2 : 0;
+}
@@ -1,12 +1,61 @@
 #include "mainwindow.h"
+#include "AllocationTracker.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
+    AllocationTracker::install();
     QApplication app(argc, argv);
 
-    MainWindow window;
+    // Virtual cameras let the pipeline be load tested without NIR hardware
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"virtual-cameras", "Add N synthetic NIR cameras.", "n", "0"});
+    parser.addOption({"virtual-size", "Synthetic frame size as WxH.", "size", "1280x720"});
+    parser.addOption({"virtual-fps", "Synthetic frame rate, 0 for unpaced.", "fps", "30"});
+    parser.addOption({"virtual-seed", "Seed of the first synthetic camera.", "seed", "1"});
+    parser.addOption({"replay", "Add a camera replaying a .veinrec recording; may be repeated.", "file"});
+    parser.addOption({"replay-mode", "realtime, fast or step.", "mode", "realtime"});
+    parser.addOption({"count-allocations", "Count heap allocations per stage from the start."});
+    parser.addOption({"capture-policy", "Camera mode choice: latency, fps, nir or current.", "policy", "current"});
+    parser.addOption({"capture-size", "Preferred camera frame size as WxH; default keeps the current size.", "size"});
+    parser.addOption({"capture-buffers", "Driver buffers per camera, 0 for the fewest that sustain the rate.", "n", "0"});
+    parser.process(app);
+    AllocationTracker::setEnabled(parser.isSet("count-allocations"));
+
+    VirtualCameraOptions virtualCameras;
+    virtualCameras.syntheticCameras = parser.value("virtual-cameras").toInt();
+    QStringList size = parser.value("virtual-size").split('x');
+    if (size.size() == 2)
+    {
+        virtualCameras.syntheticConfig.width = size[0].toInt();
+        virtualCameras.syntheticConfig.height = size[1].toInt();
+    }
+    virtualCameras.syntheticConfig.fps = parser.value("virtual-fps").toDouble();
+    virtualCameras.syntheticConfig.seed = parser.value("virtual-seed").toULongLong();
+
+    virtualCameras.replayFiles = parser.values("replay");
+    QString replayMode = parser.value("replay-mode");
+    if (replayMode == "fast")
+        virtualCameras.replayMode = ReplayFrameSource::Fast;
+    else if (replayMode == "step")
+        virtualCameras.replayMode = ReplayFrameSource::Stepped;
+
+    CaptureConfig capture;
+    if (!parseCapturePolicy(parser.value("capture-policy"), capture.policy))
+        qWarning() << "Unknown capture policy" << parser.value("capture-policy") << "- keeping the current mode";
+    QStringList captureSize = parser.value("capture-size").split('x');
+    if (captureSize.size() == 2)
+    {
+        capture.width = captureSize[0].toInt();
+        capture.height = captureSize[1].toInt();
+    }
+    capture.bufferCount = parser.value("capture-buffers").toInt();
+
+    MainWindow window(virtualCameras, capture);
     window.show();
 
     return app.exec();
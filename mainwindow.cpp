@@ -6,18 +6,44 @@
 #include <QDir>
 #include <QCoreApplication>
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
+MainWindow::MainWindow(const VirtualCameraOptions &virtualCameras, const CaptureConfig &capture, QWidget *parent)
+    : QMainWindow(parent)
 {
     tabWidget = new QTabWidget(this);
     setCentralWidget(tabWidget);
 
     // Use simple hardcoded values instead of ConfigLoader
     int camIndices[] = {0}; // Use camera 0
-    numCams = sizeof(camIndices) / sizeof(camIndices[0]);
+    int physicalCams = sizeof(camIndices) / sizeof(camIndices[0]);
+    int syntheticCams = std::max(0, virtualCameras.syntheticCameras);
+    numCams = physicalCams + syntheticCams + static_cast<int>(virtualCameras.replayFiles.size());
 
     for (int i = 0; i < numCams; ++i)
     {
-        cameras[i] = new ControlCamera(camIndices[i], this);
+        // Virtual cameras save their settings apart from real devices
+        int virtualIndex = i - physicalCams;
+        QString tabName;
+        if (i < physicalCams)
+        {
+            cameras.append(new ControlCamera(camIndices[i], std::make_unique<V4L2FrameSource>(camIndices[i], capture), this));
+            tabName = QString("Camera %1").arg(i + 1);
+        }
+        else if (virtualIndex < syntheticCams)
+        {
+            // Each synthetic camera renders its own forearm
+            SyntheticVeinConfig config = virtualCameras.syntheticConfig;
+            config.seed += virtualIndex;
+            cameras.append(new ControlCamera(VIRTUAL_CAMERA_INDEX_BASE + virtualIndex,
+                                             std::make_unique<SyntheticFrameSource>(config), this));
+            tabName = QString("Virtual %1").arg(virtualIndex + 1);
+        }
+        else
+        {
+            const QString &file = virtualCameras.replayFiles[virtualIndex - syntheticCams];
+            cameras.append(new ControlCamera(VIRTUAL_CAMERA_INDEX_BASE + virtualIndex,
+                                             std::make_unique<ReplayFrameSource>(file, virtualCameras.replayMode), this));
+            tabName = QString("Replay %1").arg(virtualIndex - syntheticCams + 1);
+        }
         if (!cameras[i]->openCamera())
         {
             cameras[i]->closeCamera();
@@ -40,7 +66,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
         connect(saveBtn, &QPushButton::clicked, this, [this, i]()
                 { onSaveButtonClicked(i); });
 
-        tabWidget->addTab(tabContainer, QString("Camera %1").arg(i + 1));
+        tabWidget->addTab(tabContainer, tabName);
     }
 
     QString manualFilePath = "/home/circuito/AMT/ControlCamera/ControlCamera/manual.html";
@@ -84,7 +110,7 @@ QString MainWindow::loadManualFromFile(const QString &filePath) const
 
 void MainWindow::onSaveButtonClicked(int cameraIndex)
 {
-    if (cameraIndex >= 0 && cameraIndex < 4 && cameras[cameraIndex])
+    if (cameraIndex >= 0 && cameraIndex < cameras.size() && cameras[cameraIndex])
     {
         cameras[cameraIndex]->saveConfiguration();
     }
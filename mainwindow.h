@@ -2,14 +2,27 @@
 
 #include <QMainWindow>
 #include <QTabWidget>
+#include <QVector>
+#include <QStringList>
 #include "ControlCamera.h"
+#include "ReplayFrameSource.h"
+
+// Cameras that are not /dev/video devices, added after the physical ones
+struct VirtualCameraOptions
+{
+    int syntheticCameras = 0;
+    SyntheticVeinConfig syntheticConfig;
+    QStringList replayFiles; // One camera per .veinrec file
+    ReplayFrameSource::Mode replayMode = ReplayFrameSource::RealTime;
+};
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    MainWindow(const VirtualCameraOptions &virtualCameras = VirtualCameraOptions(),
+               const CaptureConfig &capture = CaptureConfig(), QWidget *parent = nullptr);
     ~MainWindow();
     QString loadManualFromFile(const QString &filePath) const;
     void onSaveButtonClicked(int cameraIndex);
@@ -17,5 +30,8 @@ public:
 
 private:
     QTabWidget *tabWidget;
-    ControlCamera *cameras[1];
+    QVector<ControlCamera *> cameras;
+
+    // Virtual cameras save their settings under indices that no /dev/video node uses
+    static constexpr int VIRTUAL_CAMERA_INDEX_BASE = 100;
 };